@@ -37,25 +37,24 @@ void BTreeNode::save() {
 
 // Get the record and turn it into a block ID.
 BlockID BTreeNode::get_block_id(RecordID record_id) const {
-    Dbt *dbt = this->block->get(record_id);
-    BlockID block_id = *(BlockID *) dbt->get_data();
-    delete dbt;
-    return block_id;
+    uint16_t size;
+    const char *bytes = this->block->view(record_id, size);
+    return *(BlockID *) bytes;
 }
 
 // Get the record and turn it into a Handle.
 Handle BTreeNode::get_handle(RecordID record_id) const {
-    Dbt *dbt = this->block->get(record_id);
-    BlockID handle_block_id = *(BlockID *) dbt->get_data();
-    RecordID handle_record_id = *(RecordID *) ((char *) dbt->get_data() + sizeof(BlockID));
-    delete dbt;
+    uint16_t size;
+    const char *bytes = this->block->view(record_id, size);
+    BlockID handle_block_id = *(BlockID *) bytes;
+    RecordID handle_record_id = *(RecordID *) (bytes + sizeof(BlockID));
     return Handle(handle_block_id, handle_record_id);
 }
 
 // Get the record and turn it into a KeyValue.
 KeyValue *BTreeNode::get_key(RecordID record_id) const {
-    Dbt *dbt = this->block->get(record_id);
-    char *bytes = (char *) dbt->get_data();
+    uint16_t size;
+    const char *bytes = this->block->view(record_id, size);
     KeyValue *key_value = new KeyValue();
     Value value;
     uint offset = 0;
@@ -67,10 +66,7 @@ KeyValue *BTreeNode::get_key(RecordID record_id) const {
         } else if (data_type == ColumnAttribute::DataType::TEXT) {
             uint16_t size = *(uint16_t *) (bytes + offset);
             offset += sizeof(uint16_t);
-            char buffer[DbBlock::BLOCK_SZ];
-            memcpy(buffer, bytes + offset, size);
-            buffer[size] = '\0';
-            value.s = std::string(buffer);  // assume ascii for now
+            value.s = std::string(bytes + offset, size);  // assume ascii for now
             offset += size;
         } else if (data_type == ColumnAttribute::DataType::BOOLEAN) {
             value.n = *(uint8_t *) (bytes + offset);
@@ -80,7 +76,6 @@ KeyValue *BTreeNode::get_key(RecordID record_id) const {
         }
         key_value->push_back(value);
     }
-    delete dbt;
     return key_value;
 }
 
@@ -103,14 +98,15 @@ Dbt *BTreeNode::marshal_handle(Handle handle) {
 
 // Convert KeyValue into bytes.
 Dbt *BTreeNode::marshal_key(const KeyValue *key) {
-    char *bytes = new char[DbBlock::BLOCK_SZ]; // more than we need
+    const uint block_size = this->file.get_block_size();
+    char *bytes = new char[block_size]; // more than we need
     uint offset = 0;
     uint col_num = 0;
     for (auto const &data_type: this->key_profile) {
         Value value = (*key)[col_num];
 
         if (data_type == ColumnAttribute::DataType::INT) {
-            if (offset + 4 > DbBlock::BLOCK_SZ - 4)
+            if (offset + 4 > block_size - 4)
                 throw DbRelationError("index key too big to marshal");
 
             *(int32_t *) (bytes + offset) = value.n;
@@ -120,7 +116,7 @@ Dbt *BTreeNode::marshal_key(const KeyValue *key) {
             u_long size = (uint16_t) value.s.length();
             if (size > UINT16_MAX)
                 throw DbRelationError("text field too long to marshal");
-            if (offset + 2 + size > DbBlock::BLOCK_SZ)
+            if (offset + 2 + size > block_size)
                 throw DbRelationError("index key too big to marshal");
 
             *(uint16_t *) (bytes + offset) = (uint16_t) size;
@@ -129,7 +125,7 @@ Dbt *BTreeNode::marshal_key(const KeyValue *key) {
             offset += size;
 
         } else if (data_type == ColumnAttribute::DataType::BOOLEAN) {
-            if (offset + 1 > DbBlock::BLOCK_SZ - 1)
+            if (offset + 1 > block_size - 1)
                 throw DbRelationError("index key too big to marshal");
 
             *(uint8_t *) (bytes + offset) = (uint8_t) value.n;
@@ -385,6 +381,26 @@ Handle BTreeLeaf::find_eq(const KeyValue *key) const {
     return this->key_map.at(*key);
 }
 
+// Change the handle of a key from one handle to another (same size, so it always fits).
+bool BTreeLeaf::move(const KeyValue *key, Handle from, Handle to) {
+    auto it = this->key_map.find(*key);
+    if (it == this->key_map.end() || it->second != from)
+        return false;
+    it->second = to;
+    save();
+    return true;
+}
+
+// Remove a key (left in place, however few keys that leaves in the leaf; the boundaries above still work).
+bool BTreeLeaf::del(const KeyValue *key, Handle handle) {
+    auto it = this->key_map.find(*key);
+    if (it == this->key_map.end() || it->second != handle)
+        return false;
+    this->key_map.erase(it);
+    save();
+    return true;
+}
+
 // Save the key_map and next_leaf data in the correct order
 void BTreeLeaf::save() {
     Dbt *dbt;
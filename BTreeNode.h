@@ -30,7 +30,7 @@ public:
     BlockID get_id() const { return this->id; }
 
 protected:
-    SlottedPage *block;
+    DbBlock *block;
     HeapFile &file;
     BlockID id;
     const KeyProfile &key_profile;
@@ -105,6 +105,8 @@ public:
 
     Handle find_eq(const KeyValue *key) const;  // throws if not found
     Insertion insert(const KeyValue *key, Handle handle);
+    bool move(const KeyValue *key, Handle from, Handle to);  // false if key isn't there for from
+    bool del(const KeyValue *key, Handle handle);  // false if key isn't there for handle
 
     virtual void save();
 
@@ -0,0 +1,379 @@
+/**
+ * @file BufferPool.cpp - implementation of BufferPool
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "BufferPool.h"
+#include "HeapFile.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ * @param num_frames  number of blocks the pool can hold at once
+ */
+BufferPool::BufferPool(uint num_frames) : frames(num_frames), page_table(), file_ids(), hand(0), hits(0), misses(0),
+                                            writes(0) {
+    if (num_frames == 0)
+        throw DbRelationError("buffer pool needs at least one frame");
+    for (auto &frame: this->frames) {
+        frame.file = nullptr;
+        frame.key = 0;
+        frame.block_id = 0;
+        frame.pin_count = 0;
+        frame.referenced = false;
+        frame.dirty = false;
+        frame.mapped = false;
+    }
+    this->page_table.reserve(num_frames);
+}
+
+void AlignedBuffer::resize(size_t size) {
+    if (size == this->size)
+        return;
+    free(this->bytes);
+    this->bytes = nullptr;
+    this->size = 0;
+    void *memory;
+    if (size > 0 && posix_memalign(&memory, ALIGNMENT, size) != 0)
+        throw std::bad_alloc();
+    this->bytes = size > 0 ? (char *) memory : nullptr;
+    this->size = size;
+}
+
+uint BufferPool::file_id(const string &filename) {
+    auto it = this->file_ids.find(filename);
+    if (it != this->file_ids.end())
+        return it->second;
+    uint id = (uint) this->file_ids.size() + 1;
+    this->file_ids[filename] = id;
+    return id;
+}
+
+uint BufferPool::pin(HeapFile *file, BlockID block_id, bool read) {
+    uint64_t key = page_key(file->pool_file_id, block_id);
+    auto it = this->page_table.find(key);
+    if (it != this->page_table.end()) {
+        Frame &frame = this->frames[it->second];
+        frame.pin_count++;
+        frame.referenced = true;
+        this->hits++;
+        return it->second;
+    }
+
+    this->misses++;
+    uint frame_number = victim();
+    evict(frame_number);
+    Frame &frame = this->frames[frame_number];
+    frame.data.resize(file->get_block_size());
+    if (read) {
+        Dbt block;
+        file->read_block(block_id, block, frame.data.data());
+    }
+    frame.file = file;
+    frame.key = key;
+    frame.block_id = block_id;
+    frame.pin_count = 1;
+    frame.referenced = true;
+    frame.dirty = false;
+    frame.mapped = true;
+    this->page_table[key] = frame_number;
+    return frame_number;
+}
+
+bool BufferPool::contains(const HeapFile *file, BlockID block_id) const {
+    return this->page_table.find(page_key(file->pool_file_id, block_id)) != this->page_table.end();
+}
+
+void BufferPool::unpin(uint frame_number) {
+    Frame &frame = this->frames[frame_number];
+    if (frame.pin_count == 0)
+        throw DbRelationError("buffer pool frame unpinned more than pinned");
+    if (--frame.pin_count == 0 && !frame.mapped)
+        frame.file = nullptr;  // its file was closed while it was pinned
+}
+
+void BufferPool::mark_dirty(uint frame_number) {
+    this->frames[frame_number].dirty = true;
+}
+
+void BufferPool::flush(uint frame_number) {
+    Frame &frame = this->frames[frame_number];
+    if (!frame.dirty || frame.file == nullptr)
+        return;
+    frame.file->write_block(frame.block_id, frame.data.data());
+    frame.dirty = false;
+    this->writes++;
+}
+
+void BufferPool::checkpoint(HeapFile *file) {
+    vector<pair<uint64_t, uint>> dirty;  // page key and frame number
+    for (uint frame_number = 0; frame_number < this->frames.size(); frame_number++) {
+        const Frame &frame = this->frames[frame_number];
+        if (frame.dirty && frame.mapped && (file == nullptr || (frame.key >> 32) == file->pool_file_id))
+            dirty.push_back(make_pair(frame.key, frame_number));
+    }
+    sort(dirty.begin(), dirty.end());
+
+    // hand each file its run of blocks at once, so it can batch the writes
+    for (size_t i = 0; i < dirty.size();) {
+        HeapFile *owner = this->frames[dirty[i].second].file;
+        vector<pair<BlockID, const char *>> blocks;
+        size_t end = i;
+        for (; end < dirty.size() && this->frames[dirty[end].second].file == owner; end++) {
+            Frame &frame = this->frames[dirty[end].second];
+            blocks.push_back(make_pair(frame.block_id, (const char *) frame.data.data()));
+        }
+        owner->write_blocks(blocks);
+        for (; i < end; i++) {
+            this->frames[dirty[i].second].dirty = false;
+            this->writes++;
+        }
+    }
+}
+
+void BufferPool::discard(HeapFile *file) {
+    checkpoint(file);
+    for (uint frame_number = 0; frame_number < this->frames.size(); frame_number++) {
+        Frame &frame = this->frames[frame_number];
+        if (frame.file == nullptr || !frame.mapped || (frame.key >> 32) != file->pool_file_id)
+            continue;
+        this->page_table.erase(frame.key);
+        frame.mapped = false;
+        if (frame.pin_count == 0)
+            frame.file = nullptr;
+    }
+}
+
+void BufferPool::truncate(HeapFile *file, BlockID last) {
+    for (uint frame_number = 0; frame_number < this->frames.size(); frame_number++) {
+        Frame &frame = this->frames[frame_number];
+        if (frame.file == nullptr || !frame.mapped || (frame.key >> 32) != file->pool_file_id
+            || frame.block_id <= last)
+            continue;
+        this->page_table.erase(frame.key);
+        frame.mapped = false;
+        frame.dirty = false;
+        if (frame.pin_count == 0)
+            frame.file = nullptr;
+    }
+}
+
+/**
+ * Pick a frame to reuse with the CLOCK algorithm.
+ * @returns frame number (free, or holding an unpinned block)
+ * @throws  DbRelationError if every frame is pinned
+ */
+uint BufferPool::victim() {
+    uint n = (uint) this->frames.size();
+    for (uint sweep = 0; sweep < 2 * n; sweep++) {
+        uint frame_number = this->hand;
+        this->hand = (this->hand + 1) % n;
+        Frame &frame = this->frames[frame_number];
+        if (frame.file == nullptr)
+            return frame_number;
+        if (frame.pin_count > 0)
+            continue;
+        if (frame.referenced) {
+            frame.referenced = false;  // second chance
+            continue;
+        }
+        return frame_number;
+    }
+    throw DbRelationError("buffer pool has every frame pinned");
+}
+
+/**
+ * Take the block out of a frame, writing it back first if it's dirty.
+ * @param frame_number  frame to empty
+ */
+void BufferPool::evict(uint frame_number) {
+    Frame &frame = this->frames[frame_number];
+    if (frame.file == nullptr)
+        return;
+    flush(frame_number);
+    if (frame.mapped)
+        this->page_table.erase(frame.key);
+    frame.mapped = false;
+    frame.file = nullptr;
+}
+
+/**
+ * Test the buffer pool with a file whose blocks won't all fit in it.
+ * @param pool  pool of three frames that the file is using
+ * @return true if the tests all succeeded
+ */
+static bool test_buffer_pool_frames(BufferPool &pool) {
+    HeapFile file("_test_buffer_pool");
+    file.create();
+    char bytes[] = "hello";
+    Dbt data(bytes, sizeof(bytes));
+    for (BlockID block_id = 2; block_id <= 5; block_id++) {
+        DbBlock *block = file.get_new();
+        block->add(&data);
+        file.put(block);
+        delete block;
+    }
+    DbBlock *one = file.get(1);
+    ulong hits = pool.get_hits();
+    DbBlock *again = file.get(1);
+    if (one->get_data() != again->get_data() || pool.get_hits() != hits + 1)
+        return assertion_failure("pinning the same block twice");
+    delete again;
+
+    // with block 1 pinned, the other two frames have to take turns
+    for (int pass = 0; pass < 2; pass++)
+        for (BlockID block_id = 2; block_id <= 5; block_id++) {
+            DbBlock *block = file.get(block_id);
+            u_int16_t size;
+            const char *record = block->view(1, size);
+            if (record == nullptr || size != sizeof(bytes) || strcmp(record, bytes) != 0)
+                return assertion_failure("block read back in");
+            delete block;
+        }
+    if (one->get_data() != pool.get_data(one->get_frame()) || one->size() != 0)
+        return assertion_failure("pinned block evicted");
+    DbBlock *two = file.get(4);
+    DbBlock *three = file.get(5);
+    try {
+        DbBlock *four = file.get(2);
+        delete four;
+        return assertion_failure("no frame to spare");
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    delete two;
+    delete three;
+
+    // changes made in a frame are written back when the frame is reused
+    one->add(&data);
+    pool.mark_dirty(one->get_frame());
+    delete one;
+    for (int pass = 0; pass < 2; pass++)
+        for (BlockID block_id = 2; block_id <= 5; block_id++)
+            delete file.get(block_id);
+    ulong misses = pool.get_misses();
+    one = file.get(1);
+    if (pool.get_misses() != misses + 1 || one->size() != 1)
+        return assertion_failure("dirty block written back");
+
+    // and when the file is closed
+    one->add(&data);
+    pool.mark_dirty(one->get_frame());
+    delete one;
+    file.close();
+    HeapFile reopened("_test_buffer_pool");
+    misses = pool.get_misses();
+    reopened.open();
+    one = reopened.get(1);
+    if (pool.get_misses() != misses + 1 || one->size() != 2)
+        return assertion_failure("dirty block written at close");
+    delete one;
+    reopened.drop();
+    return true;
+}
+
+/**
+ * Test write-behind: puts of the same block cost one write, written at a checkpoint or when the frame is reused.
+ * @param pool  pool of three frames that the file is using
+ * @return true if the tests all succeeded
+ */
+static bool test_write_behind(BufferPool &pool) {
+    HeapFile file("_test_write_behind");
+    file.create();
+    char bytes[] = "hello";
+    Dbt data(bytes, sizeof(bytes));
+    pool.checkpoint();
+    ulong writes = pool.get_writes();
+    for (int i = 0; i < 10; i++) {
+        DbBlock *block = file.get(1);
+        block->add(&data);
+        file.put(block);
+        delete block;
+    }
+    if (pool.get_writes() != writes)
+        return assertion_failure("put wrote through", pool.get_writes() - writes);
+    pool.checkpoint(&file);
+    pool.checkpoint(&file);
+    if (pool.get_writes() != writes + 1)
+        return assertion_failure("checkpoint writes", pool.get_writes() - writes);
+
+    // new blocks' records are only in the pool until written, but are scanned all the same
+    for (BlockID block_id = 2; block_id <= 3; block_id++) {
+        DbBlock *block = file.get_new();
+        block->add(&data);
+        file.put(block);
+        delete block;
+    }
+    HeapFile::BlockScan *blocks = file.scan_blocks();
+    BlockID n = 0;
+    for (DbBlock *block = blocks->next(); block != nullptr; block = blocks->next()) {
+        if (block->get_block_id() != ++n || block->size() != (n == 1 ? 10 : 1))
+            return assertion_failure("scan of unwritten blocks", n);
+        delete block;
+    }
+    delete blocks;
+    if (n != 3)
+        return assertion_failure("scan of unwritten blocks count", n);
+
+    // four dirty blocks don't fit in three frames, so one has to be written out to make room
+    writes = pool.get_writes();
+    for (int i = 0; i < 2; i++) {
+        DbBlock *block = file.get_new();
+        block->add(&data);
+        file.put(block);
+        delete block;
+    }
+    if (pool.get_writes() == writes)
+        return assertion_failure("dirty block written when evicted");
+
+    // and the rest when write-behind is turned off, each of the four new blocks written just once
+    file.set_write_behind(false);
+    if (pool.get_writes() != writes + 4)
+        return assertion_failure("write-behind turned off", pool.get_writes() - writes);
+    DbBlock *block = file.get(1);
+    block->add(&data);
+    file.put(block);
+    delete block;
+    if (pool.get_writes() != writes + 5)
+        return assertion_failure("put without write-behind", pool.get_writes() - writes);
+
+    // a block written out in the middle of a scan is read again instead of taken from the scan's earlier copy
+    file.set_write_behind(true);
+    blocks = file.scan_blocks();
+    delete blocks->next();
+    block = file.get(5);
+    block->add(&data);
+    file.put(block);
+    delete block;
+    for (int pass = 0; pass < 2; pass++)
+        for (BlockID block_id = 1; block_id <= 4; block_id++)
+            delete file.get(block_id);
+    if (pool.contains(&file, 5))
+        return assertion_failure("changed block written out during scan");
+    for (block = blocks->next(); block != nullptr; block = blocks->next()) {
+        if (block->get_block_id() == 5 && block->size() != 2)
+            return assertion_failure("scan of block written out during scan", block->size());
+        delete block;
+    }
+    delete blocks;
+    file.drop();
+    return true;
+}
+
+/**
+ * Test the buffer pool on a small pool of its own (so as to see hits, misses, and evictions).
+ * @return true if the tests all succeeded
+ */
+bool test_buffer_pool() {
+    BufferPool *saved = _BUFFER_POOL;
+    BufferPool pool(3);
+    _BUFFER_POOL = &pool;
+    bool ok = test_buffer_pool_frames(pool) && test_write_behind(pool);
+    _BUFFER_POOL = saved;
+    return ok;
+}
@@ -0,0 +1,231 @@
+/**
+ * @file BufferPool.h - Buffer pool of block frames for HeapFile.
+ * BufferPool
+ *
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "storage_engine.h"
+
+class HeapFile;
+
+/**
+ * @class AlignedBuffer - memory for blocks, aligned so it can be read into and written from with O_DIRECT
+ */
+class AlignedBuffer {
+public:
+    /**
+     * Alignment of the memory (and what O_DIRECT transfers have to be a multiple of).
+     */
+    static const uint ALIGNMENT = DbBlock::BLOCK_SZ;
+
+    AlignedBuffer() : bytes(nullptr), size(0) {}
+
+    explicit AlignedBuffer(size_t size) : bytes(nullptr), size(0) { resize(size); }
+
+    ~AlignedBuffer() { free(bytes); }
+
+    AlignedBuffer(const AlignedBuffer &other) = delete;
+
+    AlignedBuffer(AlignedBuffer &&temp) : bytes(temp.bytes), size(temp.size) {
+        temp.bytes = nullptr;
+        temp.size = 0;
+    }
+
+    AlignedBuffer &operator=(const AlignedBuffer &other) = delete;
+
+    AlignedBuffer &operator=(AlignedBuffer &&temp) = delete;
+
+    /**
+     * Change the size (the contents are not kept unless the size stays the same).
+     * @param size  bytes wanted
+     */
+    void resize(size_t size);
+
+    char *data() { return bytes; }
+
+    size_t get_size() const { return size; }
+
+    /**
+     * Check if some memory is aligned well enough for O_DIRECT.
+     * @param bytes  the memory
+     * @returns      true if it is
+     */
+    static bool is_aligned(const void *bytes) { return ((uintptr_t) bytes % ALIGNMENT) == 0; }
+
+private:
+    char *bytes;
+    size_t size;
+};
+
+/**
+ * @class BufferPool - fixed array of frames holding recently used blocks, shared by all the HeapFiles.
+ *
+ *      A block is pinned into a frame while some DbBlock is using it, and unpinned when that DbBlock is deleted.
+        Blocks are found through a page table keyed by file and block id, so getting a block that is already in
+        a frame is a hash lookup; otherwise the block is read in by its file (from Berkeley DB, decompressing it
+        if need be) into a frame chosen by the CLOCK algorithm: the hand sweeps the frames, skipping pinned ones
+        and giving each recently used one a second chance, and takes the first one that is neither.
+        A frame that has been changed since it was read is marked dirty and is written back by its file before
+        the frame is reused, when it is flushed, at a checkpoint, or when its file is closed. Until then any
+        number of changes to the block cost one write.
+        Files are told apart by their Berkeley DB file name, so two HeapFile objects open on the same file share
+        its frames. Frames are aligned (AlignedBuffer) so files opened with O_DIRECT can read and write them.
+ */
+class BufferPool {
+public:
+    /**
+     * Number of frames in the pool made for the database environment.
+     */
+    static const uint DEFAULT_FRAMES = 1024;
+
+    explicit BufferPool(uint num_frames = DEFAULT_FRAMES);
+
+    virtual ~BufferPool() {}
+
+    BufferPool(const BufferPool &other) = delete;
+
+    BufferPool(BufferPool &&temp) = delete;
+
+    BufferPool &operator=(const BufferPool &other) = delete;
+
+    BufferPool &operator=(BufferPool &&temp) = delete;
+
+    /**
+     * Get the id the pool uses for a file (the same for every HeapFile open on the file).
+     * @param filename  Berkeley DB file name
+     * @returns         file id
+     */
+    virtual uint file_id(const std::string &filename);
+
+    /**
+     * Pin a block into a frame, reading it in if it isn't in one already.
+     * @param file      file the block is in
+     * @param block_id  which block
+     * @param read      false if the block is about to be overwritten, so there is no need to read it in
+     * @returns         frame number (unpinned with unpin)
+     * @throws          DbRelationError if every frame is pinned
+     */
+    virtual uint pin(HeapFile *file, BlockID block_id, bool read = true);
+
+    /**
+     * Check if a block is in the pool (without pinning it).
+     * @param file      file the block is in
+     * @param block_id  which block
+     * @returns         true if it is in a frame
+     */
+    virtual bool contains(const HeapFile *file, BlockID block_id) const;
+
+    /**
+     * Let go of a pin on a frame.
+     * @param frame  frame number from pin
+     */
+    virtual void unpin(uint frame);
+
+    /**
+     * Note that the block in a (pinned) frame has changed.
+     * @param frame  frame number from pin
+     */
+    virtual void mark_dirty(uint frame);
+
+    /**
+     * Write the block in a frame back to its file if it is dirty.
+     * @param frame  frame number from pin
+     */
+    virtual void flush(uint frame);
+
+    /**
+     * Write back dirty blocks, in order by file and block id (so Berkeley DB sees them in file order), each
+     * file's blocks in one batch (see HeapFile::write_blocks).
+     * @param file  only this file's blocks, or null for every file's
+     */
+    virtual void checkpoint(HeapFile *file = nullptr);
+
+    /**
+     * Write back all the dirty blocks of a file and take them all out of the pool (as when it is closed).
+     * Frames still pinned are let go of once they are unpinned.
+     * @param file  the file
+     */
+    virtual void discard(HeapFile *file);
+
+    /**
+     * Take a file's blocks after a given one out of the pool without writing them back, since the file is being
+     * cut short there. Frames still pinned are let go of once they are unpinned.
+     * @param file  the file
+     * @param last  last block of the file to keep
+     */
+    virtual void truncate(HeapFile *file, BlockID last);
+
+    /**
+     * Get the memory of a frame.
+     * @param frame  frame number from pin
+     * @returns      the block's bytes
+     */
+    virtual char *get_data(uint frame) { return this->frames[frame].data.data(); }
+
+    /**
+     * Get the number of frames in the pool (the most blocks that can be pinned at once).
+     * @returns  number of frames
+     */
+    virtual uint get_num_frames() const { return (uint) this->frames.size(); }
+
+    /**
+     * Get the number of pins satisfied without reading the block in.
+     * @returns  number of hits
+     */
+    virtual ulong get_hits() const { return this->hits; }
+
+    /**
+     * Get the number of pins that had to read the block in.
+     * @returns  number of misses
+     */
+    virtual ulong get_misses() const { return this->misses; }
+
+    /**
+     * Get the number of dirty blocks written back.
+     * @returns  number of writes
+     */
+    virtual ulong get_writes() const { return this->writes; }
+
+protected:
+    /**
+     * A frame of the pool and the block in it.
+     */
+    struct Frame {
+        HeapFile *file;  // file the block belongs to, or null if the frame is free
+        uint64_t key;    // page table key of the block
+        BlockID block_id;
+        uint pin_count;
+        bool referenced;  // second-chance bit for CLOCK
+        bool dirty;
+        bool mapped;     // in the page table (false once discarded while still pinned)
+        AlignedBuffer data;
+    };
+
+    std::vector<Frame> frames;
+    std::unordered_map<uint64_t, uint> page_table;  // page key -> frame number
+    std::unordered_map<std::string, uint> file_ids;
+    uint hand;
+    ulong hits;
+    ulong misses;
+    ulong writes;
+
+    static uint64_t page_key(uint file_id, BlockID block_id) { return ((uint64_t) file_id << 32) | block_id; }
+
+    virtual uint victim();
+
+    virtual void evict(uint frame);
+};
+
+/**
+ * Global buffer pool used by every HeapFile (set up along with _DB_ENV; if null, files read blocks directly).
+ */
+extern BufferPool *_BUFFER_POOL;
+
+bool test_buffer_pool();
@@ -93,11 +93,12 @@ ValueDicts *EvalPlan::evaluate() {
 
     EvalPipeline pipeline = this->relation->pipeline();
     DbRelation *temp_table = pipeline.first;
-    Handles *handles = pipeline.second;
-    if (this->type == ProjectAll)
-        ret = temp_table->project(handles);
-    else if (this->type == Project)
-        ret = temp_table->project(handles, this->projection);
+    DbHandleIterator *handles = pipeline.second;
+    ret = new ValueDicts();
+    Handle handle;
+    while (handles->next(handle))
+        ret->push_back(this->type == ProjectAll ? temp_table->project(handle)
+                                                : temp_table->project(handle, this->projection));
     delete handles;
     return ret;
 }
@@ -105,18 +106,15 @@ ValueDicts *EvalPlan::evaluate() {
 EvalPipeline EvalPlan::pipeline() {
     // base cases
     if (this->type == TableScan)
-        return EvalPipeline(&this->table, this->table.select());
+        return EvalPipeline(&this->table, this->table.scan());
     if (this->type == Select && this->relation->type == TableScan)
-        return EvalPipeline(&this->relation->table, this->relation->table.select(this->select_conjunction));
+        return EvalPipeline(&this->relation->table, this->relation->table.scan(this->select_conjunction));
 
     // recursive case
     if (this->type == Select) {
         EvalPipeline pipeline = this->relation->pipeline();
         DbRelation *temp_table = pipeline.first;
-        Handles *handles = pipeline.second;
-        EvalPipeline ret(temp_table, temp_table->select(handles, this->select_conjunction));
-        delete handles;
-        return ret;
+        return EvalPipeline(temp_table, temp_table->scan(pipeline.second, this->select_conjunction));
     }
 
     throw DbRelationError("Not implemented: pipeline other than Select or TableScan");
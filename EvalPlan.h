@@ -9,7 +9,7 @@
 #include "storage_engine.h"
 
 
-typedef std::pair<DbRelation *, Handles *> EvalPipeline;
+typedef std::pair<DbRelation *, DbHandleIterator *> EvalPipeline;  // iterator freed by whoever runs it
 
 class EvalPlan {
 public:
@@ -3,9 +3,12 @@
  * @author K Lundeen
  * @see Seattle University, CPSC5300
  */
+#include <algorithm>
 #include <cstring>
+#include <sys/stat.h>
 #include "db_cxx.h"
 #include "HeapFile.h"
+#include "LZCodec.h"
 
 using namespace std;
 typedef uint16_t u16;
@@ -13,9 +16,33 @@ typedef uint16_t u16;
 /**
  * Constructor
  * @param name
+ * @param block_size         size of blocks if the file gets created (an existing file keeps its own block size)
+ * @param layout             layout of blocks if the file gets created (an existing file keeps its own layout)
+ * @param column_attributes  columns of the records, needed for PAX blocks
+ * @param compressed         whether to compress the blocks, if the file gets created (an existing file keeps
+ *                           its own setting)
  */
-HeapFile::HeapFile(string name) : DbFile(name), dbfilename(""), last(0), closed(true), db(_DB_ENV, 0) {
+HeapFile::HeapFile(string name, uint block_size, BlockLayout layout, const ColumnAttributes &column_attributes,
+                   bool compressed)
+        : DbFile(name), dbfilename(""), block_size(block_size), layout(layout), column_attributes(column_attributes),
+          compressed(compressed), page_buffer(), last(0), closed(true), db(_DB_ENV, 0),
+          fsmfilename(""), free_map(), free_blocks(), queued(), fsm(_DB_ENV, 0),
+          pool(_BUFFER_POOL), pool_file_id(0), block_writes(0), written(), write_behind(true), reserved(0),
+          extent_first(EXTENT_FIRST), extent_most(EXTENT_MOST), next_extent(EXTENT_FIRST) {
+    if (block_size < DbBlock::BLOCK_SZ || block_size > DbBlock::MAX_BLOCK_SZ || (block_size & (block_size - 1)) != 0)
+        throw DbRelationError("block size must be a power of two from 4K to 32K");
+    if (layout == PAX && column_attributes.empty())
+        throw DbRelationError("PAX layout needs the columns of the records");
     this->dbfilename = this->name + ".db";
+    this->fsmfilename = this->name + ".fsm.db";
+}
+
+/**
+ * Destructor: let go of any of our blocks still in the buffer pool.
+ */
+HeapFile::~HeapFile() {
+    if (this->pool != nullptr && !this->closed)
+        this->pool->discard(this);
 }
 
 /**
@@ -23,7 +50,7 @@ HeapFile::HeapFile(string name) : DbFile(name), dbfilename(""), last(0), closed(
  */
 void HeapFile::create(void) {
     db_open(DB_CREATE | DB_EXCL);
-    SlottedPage *page = get_new(); // force one page to exist
+    DbBlock *page = get_new(); // force one page to exist
     delete page;
 }
 
@@ -34,6 +61,7 @@ void HeapFile::drop(void) {
     close();
     Db db(_DB_ENV, 0);
     db.remove(this->dbfilename.c_str(), nullptr, 0);
+    fsm_drop();
 }
 
 /**
@@ -47,7 +75,12 @@ void HeapFile::open(void) {
  * Close the physical file.
  */
 void HeapFile::close(void) {
+    if (this->closed)
+        return;
+    if (this->pool != nullptr)
+        this->pool->discard(this);
     this->db.close(0);
+    this->fsm.close(0);
     this->closed = true;
 }
 
@@ -55,32 +88,115 @@ void HeapFile::close(void) {
  * Allocate a new block for the database file.
  * @return the new empty DbBlock that is managing the records in this block and its block id.
  */
-SlottedPage *HeapFile::get_new(void) {
-    char block[DbBlock::BLOCK_SZ];
-    memset(block, 0, sizeof(block));
-    Dbt data(block, sizeof(block));
+DbBlock *HeapFile::get_new(void) {
+    if (this->reserved <= this->last)
+        reserve();
+    BlockID block_id = ++this->last;
+    DbBlock *block;
+    if (this->pool != nullptr) {
+        // the file already has it initialized, so just initialize a frame the same way instead of reading it
+        uint frame = this->pool->pin(this, block_id, false);
+        memset(this->pool->get_data(frame), 0, this->block_size);
+        Dbt data(this->pool->get_data(frame), this->block_size);
+        block = make_block(data, block_id, true);
+        block->set_frame(this->pool, frame);
+    } else {
+        block = get(block_id);
+    }
+    note_free_space(block_id, block->unused_bytes());
+    return block;
+}
 
-    int block_id = ++this->last;
-    Dbt key(&block_id, sizeof(block_id));
+void HeapFile::set_extents(uint first, uint most) {
+    if (first == 0 || most < first)
+        throw DbRelationError("extents have to be at least one block and grow");
+    this->extent_first = first;
+    this->extent_most = most;
+    this->next_extent = first;
+}
 
-    // write out an empty block and read it back in so Berkeley DB is managing the memory
-    SlottedPage *page = new SlottedPage(data, this->last, true);
-    this->db.put(nullptr, &key, &data, 0); // write it out with initialization done to it
-    delete page;
-    this->db.get(nullptr, &key, &data, 0);
-    return new SlottedPage(data, this->last);
+/**
+ * Reserve the next extent: write out its blocks, all initialized empty, in one batch. They aren't in use until
+ * get_new hands them out, and are marked FSM_RESERVED in the free-space map until then.
+ */
+void HeapFile::reserve() {
+    uint n = this->next_extent;
+    this->next_extent = min(this->next_extent * 2, this->extent_most);
+    AlignedBuffer image(this->block_size);  // aligned, in case the file does O_DIRECT
+    memset(image.data(), 0, this->block_size);
+    Dbt data(image.data(), this->block_size);
+    delete make_block(data, this->reserved + 1, true);
+    vector<pair<BlockID, const char *>> blocks;
+    for (uint i = 1; i <= n; i++)
+        blocks.push_back(make_pair(this->reserved + i, (const char *) image.data()));
+    write_blocks(blocks);
+
+    BlockID first = this->reserved + 1;
+    this->reserved += n;
+    if (this->free_map.size() < this->reserved)
+        this->free_map.resize(this->reserved, 0);
+    for (BlockID block_id = first; block_id <= this->reserved; block_id++)
+        this->free_map[block_id - 1] = FSM_RESERVED;
+    for (uint32_t fsm_page = (first - 1) / FSM_PAGE_SZ + 1; (fsm_page - 1) * FSM_PAGE_SZ < this->reserved; fsm_page++)
+        fsm_write(fsm_page);
+}
+
+BlockID HeapFile::truncate(BlockID block_id) {
+    if (block_id == 0 || block_id > this->last)
+        throw DbRelationError("can't truncate " + this->dbfilename + " to block " + to_string(block_id));
+    BlockID cut = this->last - block_id;
+    if (this->pool != nullptr)
+        this->pool->truncate(this, block_id);
+
+    // the blocks cut off are marked as such before they go, so if the file is reopened it still ends here
+    if (this->free_map.size() < this->reserved)
+        this->free_map.resize(this->reserved, 0);
+    for (BlockID cut_id = block_id + 1; cut_id <= this->reserved; cut_id++)
+        this->free_map[cut_id - 1] = FSM_CUT;
+    for (uint32_t fsm_page = block_id / FSM_PAGE_SZ + 1; (fsm_page - 1) * FSM_PAGE_SZ < this->reserved; fsm_page++)
+        fsm_write(fsm_page);
+    for (auto &blocks: this->free_blocks)
+        blocks.erase(remove_if(blocks.begin(), blocks.end(), [block_id](BlockID free) { return free > block_id; }),
+                     blocks.end());
+    if (this->queued.size() > block_id)
+        this->queued.resize(block_id);
+
+    cut_after(block_id);
+    this->last = this->reserved = block_id;
+    this->next_extent = this->extent_first;
+    return cut;
+}
+
+/**
+ * Remove the blocks after a given one (reserved ones too) from the file itself, and give back the room.
+ * @param block_id  last block to keep
+ */
+void HeapFile::cut_after(BlockID block_id) {
+    for (BlockID cut = this->reserved; cut > block_id; cut--) {
+        Dbt key(&cut, sizeof(cut));
+        this->db.del(nullptr, &key, 0);
+    }
+    DB_COMPACT c_data;
+    memset(&c_data, 0, sizeof(c_data));
+    this->db.compact(nullptr, nullptr, nullptr, &c_data, DB_FREE_SPACE, nullptr);
 }
 
 /**
  * Get a block from the database file.
  * @param block_id
- * @return          the given slotted page (freed by caller)
+ * @return          the given slotted page or PAX page (freed by caller, which unpins it from the buffer pool)
  */
-SlottedPage *HeapFile::get(BlockID block_id) {
-    Dbt key(&block_id, sizeof(block_id));
-    Dbt data;
-    this->db.get(nullptr, &key, &data, 0);
-    return new SlottedPage(data, block_id, false);
+DbBlock *HeapFile::get(BlockID block_id) {
+    if (this->pool == nullptr) {
+        Dbt data;
+        read_block(block_id, data, nullptr);
+        return make_block(data, block_id);
+    }
+    uint frame = this->pool->pin(this, block_id);
+    Dbt data(this->pool->get_data(frame), this->block_size);
+    DbBlock *block = make_block(data, block_id);
+    block->set_frame(this->pool, frame);
+    return block;
 }
 
 /**
@@ -88,9 +204,150 @@ SlottedPage *HeapFile::get(BlockID block_id) {
  * @param block
  */
 void HeapFile::put(DbBlock *block) {
-    int block_id = block->get_block_id();
+    BlockID block_id = block->get_block_id();
+    note_free_space(block_id, block->unused_bytes());
+    if (this->pool == nullptr) {
+        write_block(block_id, (const char *) block->get_data());
+        return;
+    }
+    if (block->get_pool() == this->pool) {
+        this->pool->mark_dirty(block->get_frame());
+        if (!this->write_behind)
+            this->pool->flush(block->get_frame());
+        return;
+    }
+    // a block that isn't in a frame (like a new one), so replace whatever is in the pool for it
+    uint frame = this->pool->pin(this, block_id, false);
+    memcpy(this->pool->get_data(frame), block->get_data(), this->block_size);
+    this->pool->mark_dirty(frame);
+    if (!this->write_behind)
+        this->pool->flush(frame);
+    this->pool->unpin(frame);
+}
+
+void HeapFile::set_write_behind(bool on) {
+    this->write_behind = on;
+    if (!on && this->pool != nullptr && !this->closed)
+        this->pool->checkpoint(this);
+}
+
+/**
+ * Read a block from Berkeley DB (decompressing it if need be).
+ * @param block_id
+ * @param block     set to the block's memory
+ * @param into      where to put the block, or null to leave it in Berkeley DB's memory (or in page_buffer if
+ *                  it had to be decompressed)
+ */
+void HeapFile::read_block(BlockID block_id, Dbt &block, char *into) {
+    Dbt key(&block_id, sizeof(block_id));
+    Dbt data;
+    this->db.get(nullptr, &key, &data, 0);
+    unpack(data, block, into);
+}
+
+/**
+ * Get a block out of a Berkeley DB record (decompressing it if need be).
+ * @param stored  the record
+ * @param block   set to the block's memory
+ * @param into    where to put the block, or null to leave it in the record's memory (or in page_buffer if
+ *                it had to be decompressed)
+ */
+void HeapFile::unpack(const Dbt &stored, Dbt &block, char *into) {
+    const char *bytes = (const char *) stored.get_data();
+    uint size = stored.get_size();
+    bool packed = false;
+    if (this->compressed) {
+        packed = *(u16 *) bytes & COMPRESSED_PAGE;
+        bytes += PAGE_ENVELOPE_SZ;
+        size -= PAGE_ENVELOPE_SZ;
+    }
+    if (packed) {
+        if (into == nullptr) {
+            this->page_buffer.resize(this->block_size);
+            into = this->page_buffer.data();
+        }
+        if (LZCodec::decompress(bytes, size, into, this->block_size) != this->block_size)
+            throw DbRelationError("compressed block is the wrong size");
+    } else if (into != nullptr) {
+        memcpy(into, bytes, this->block_size);
+    } else {
+        into = (char *) bytes;  // stored as is
+    }
+    block.set_data(into);
+    block.set_size(this->block_size);
+}
+
+/**
+ * Set up a block from a Berkeley DB record we already have (like from a bulk read), using the buffer pool's
+ * copy if it has one and otherwise putting it into the pool.
+ * @param block_id
+ * @param stored    the record
+ * @return          the given slotted page or PAX page (freed by caller)
+ */
+DbBlock *HeapFile::stored_block(BlockID block_id, const Dbt &stored) {
+    if (this->pool != nullptr && this->pool->contains(this, block_id))
+        return get(block_id);
+    Dbt data;
+    unpack(stored, data, nullptr);
+    if (this->pool == nullptr)
+        return make_block(data, block_id);
+    uint frame = this->pool->pin(this, block_id, false);
+    memcpy(this->pool->get_data(frame), data.get_data(), this->block_size);
+    Dbt pooled(this->pool->get_data(frame), this->block_size);
+    DbBlock *block = make_block(pooled, block_id);
+    block->set_frame(this->pool, frame);
+    return block;
+}
+
+/**
+ * Check if a block has been written to Berkeley DB since some earlier point.
+ * @param block_id
+ * @param stamp     block_writes as of that point
+ * @return          true if it has
+ */
+bool HeapFile::written_since(BlockID block_id, ulong stamp) const {
+    return block_id <= this->written.size() && this->written[block_id - 1] > stamp;
+}
+
+/**
+ * Write a block to Berkeley DB (compressing it if the file is compressed and it gets smaller).
+ * @param block_id
+ * @param bytes     the block
+ */
+void HeapFile::write_block(BlockID block_id, const char *bytes) {
+    if (this->written.size() < block_id)
+        this->written.resize(block_id, 0);
+    this->written[block_id - 1] = ++this->block_writes;
     Dbt key(&block_id, sizeof(block_id));
-    this->db.put(nullptr, &key, block->get_block(), 0);
+    if (!this->compressed) {
+        Dbt data((void *) bytes, this->block_size);
+        this->db.put(nullptr, &key, &data, 0);
+        return;
+    }
+
+    char envelope[PAGE_ENVELOPE_SZ + DbBlock::MAX_BLOCK_SZ];
+    char *packed = envelope + PAGE_ENVELOPE_SZ;
+    uint size = LZCodec::compress(bytes, this->block_size, packed, this->block_size - 1);
+    u16 flags = COMPRESSED_PAGE;
+    if (size == 0) {
+        // didn't get any smaller, so store it as is
+        memcpy(packed, bytes, this->block_size);
+        size = this->block_size;
+        flags = 0;
+    }
+    *(u16 *) envelope = flags;
+    *(u16 *) (envelope + 2) = (u16) this->block_size;
+    Dbt data(envelope, PAGE_ENVELOPE_SZ + size);
+    this->db.put(nullptr, &key, &data, 0);
+}
+
+/**
+ * Write a batch of blocks (in the order given). Berkeley DB takes them one at a time.
+ * @param blocks  block id and bytes of each
+ */
+void HeapFile::write_blocks(const vector<pair<BlockID, const char *>> &blocks) {
+    for (auto const &block: blocks)
+        write_block(block.first, block.second);
 }
 
 /**
@@ -104,6 +361,141 @@ BlockIDs *HeapFile::block_ids() const {
     return vec;
 }
 
+bool HeapFile::exists(string name) {
+    const char *home = nullptr;
+    _DB_ENV->get_home(&home);
+    struct stat buf;
+    return stat((string(home == nullptr ? "." : home) + "/" + name + ".db").c_str(), &buf) == 0;
+}
+
+/**
+ * Find a block with room for another record, using only the free-space map.
+ * Only blocks whose category guarantees the room are considered, so the answer can't be a block without room,
+ * except that blocks (PaxPage ones in particular) may need more room than the record for their own bookkeeping.
+ * @param size  size of the record to be added
+ * @return      id of a block that should have room, or 0 if no block is known to
+ */
+BlockID HeapFile::find_free_block(uint size) {
+    uint step = this->block_size / FSM_CATEGORIES;
+    uint needed = (size + FSM_RECORD_OVERHEAD + step - 1) / step;
+    for (uint category = needed; category < FSM_CATEGORIES; category++) {
+        vector<BlockID> &blocks = this->free_blocks[category];
+        while (!blocks.empty()) {
+            BlockID block_id = blocks.back();
+            if (this->free_map[block_id - 1] == category)
+                return block_id;
+            blocks.pop_back();  // moved to another category since it was pushed
+            this->queued[block_id - 1] &= ~(1U << category);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Record how much free space a block has in the free-space map, writing out the map's record if it changed.
+ * @param block_id
+ * @param unused_bytes  free space in the block
+ */
+void HeapFile::note_free_space(BlockID block_id, uint unused_bytes) {
+    uint category = unused_bytes / (this->block_size / FSM_CATEGORIES);
+    if (category >= FSM_CATEGORIES)
+        category = FSM_CATEGORIES - 1;
+    if (this->free_map.size() < block_id)
+        this->free_map.resize(block_id, 0);
+    else if (this->free_map[block_id - 1] == category)
+        return;
+    this->free_map[block_id - 1] = (uint8_t) category;
+    queue_free_block(block_id, category);
+    fsm_write((block_id - 1) / FSM_PAGE_SZ + 1);
+}
+
+/**
+ * Push a block onto its category's stack, unless it is in there already (from an earlier time in the category,
+ * further down), so a block going back and forth between categories doesn't pile up in the stacks.
+ * @param block_id
+ * @param category  the block's category in free_map
+ */
+void HeapFile::queue_free_block(BlockID block_id, uint category) {
+    if (this->queued.size() < block_id)
+        this->queued.resize(block_id, 0);
+    if (this->queued[block_id - 1] & (1U << category))
+        return;
+    this->queued[block_id - 1] |= (uint16_t) (1U << category);
+    this->free_blocks[category].push_back(block_id);
+}
+
+/**
+ * Write out a record of the free-space map.
+ * @param fsm_page  which record
+ */
+void HeapFile::fsm_write(uint32_t fsm_page) {
+    uint8_t bytes[FSM_PAGE_SZ] = {0};
+    uint first = (fsm_page - 1) * FSM_PAGE_SZ;
+    uint n = min((uint) this->free_map.size() - first, FSM_PAGE_SZ);
+    memcpy(bytes, this->free_map.data() + first, n);
+    Dbt key(&fsm_page, sizeof(fsm_page));
+    Dbt data(bytes, FSM_PAGE_SZ);
+    this->fsm.put(nullptr, &key, &data, 0);
+}
+
+/**
+ * Start reading all the blocks in order, in bulk.
+ * @return the scan (freed by caller)
+ */
+HeapFile::BlockScan *HeapFile::scan_blocks() {
+    return new BulkScan(*this);
+}
+
+DbBlock *HeapFile::BlockScan::next() {
+    if (this->block_id >= this->file.get_last_block_id())
+        return nullptr;
+    return this->file.get(++this->block_id);
+}
+
+HeapFile::BulkScan::BulkScan(HeapFile &file)
+        : BlockScan(file), cursor(nullptr), buffer(BULK_BUFFER_SZ), bulk(), records(nullptr), done(false),
+          filled(0), pending(false), recno(0), stored() {
+    this->bulk.set_data(this->buffer.data());
+    this->bulk.set_ulen(BULK_BUFFER_SZ);
+    this->bulk.set_flags(DB_DBT_USERMEM);
+    file.db.cursor(nullptr, &this->cursor, 0);
+}
+
+HeapFile::BulkScan::~BulkScan() {
+    delete this->records;
+    this->cursor->close();
+}
+
+DbBlock *HeapFile::BulkScan::next() {
+    if (this->block_id >= this->file.get_last_block_id())
+        return nullptr;  // the rest (if any) are reserved, not in use
+    while (!this->pending && !this->done) {
+        if (this->records != nullptr && this->records->next(this->recno, this->stored)) {
+            this->pending = true;
+            break;
+        }
+        delete this->records;
+        this->records = nullptr;
+        Dbt key;
+        this->filled = this->file.block_writes;
+        if (this->cursor->get(&key, &this->bulk, DB_MULTIPLE_KEY | DB_NEXT) != 0)
+            this->done = true;
+        else
+            this->records = new DbMultipleRecnoDataIterator(this->bulk);
+    }
+    if (this->pending && this->recno == this->block_id + 1) {
+        this->pending = false;
+        if (this->file.written_since(++this->block_id, this->filled))
+            return this->file.get(this->block_id);  // the buffer's copy is stale
+        return this->file.stored_block(this->block_id, this->stored);
+    }
+    // blocks that haven't been written to Berkeley DB yet are only in the buffer pool
+    BlockID through = this->pending ? this->recno - 1 : this->file.get_last_block_id();
+    if (this->block_id < through)
+        return this->file.get(++this->block_id);
+    return nullptr;
+}
+
 /**
  * Ask BerkDb how many blocks we are currently using in the file.
  * @return number of blocks
@@ -123,9 +515,100 @@ uint32_t HeapFile::get_block_count() {
 void HeapFile::db_open(uint flags) {
     if (!this->closed)
         return;
-    this->db.set_re_len(DbBlock::BLOCK_SZ); // record length - will be ignored if file already exists
+    if ((flags & DB_CREATE) && !this->compressed)
+        this->db.set_re_len(this->block_size); // record length - fixed for the life of the file
     this->db.open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags, 0644);
+    u_int32_t re_len;
+    this->db.get_re_len(&re_len);
+    this->compressed = re_len == 0;  // compressed files are the ones with variable-length records
+    if (!this->compressed)
+        this->block_size = re_len;
 
-    this->last = flags ? 0 : get_block_count();
     this->closed = false;
+    if (this->pool != nullptr) {
+        this->pool_file_id = this->pool->file_id(this->dbfilename);
+        this->pool->checkpoint(this);  // blocks another HeapFile on this file hasn't written yet
+    }
+    this->last = flags ? 0 : get_block_count();
+    if (this->compressed && this->last > 0) {
+        // block size is in every block's envelope
+        BlockID block_id = 1;
+        Dbt key(&block_id, sizeof(block_id));
+        Dbt data;
+        this->db.get(nullptr, &key, &data, 0);
+        this->block_size = *(u16 *) ((char *) data.get_data() + 2);
+    }
+    fsm_open(flags);
+    if (this->last > 0) {
+        // new blocks have to match the ones already there
+        DbBlock *first = get(1);
+        this->layout = PaxPage::is_pax(*first->get_block()) ? PAX : SLOTTED_PAGE;
+        delete first;
+    }
+
+    // Berkeley DB still counts blocks cut off by truncate, and before them, blocks reserved but never handed out
+    // are at the end (still reserved)
+    while (this->last > 0 && this->free_map[this->last - 1] == FSM_CUT)
+        this->last--;
+    this->reserved = this->last;
+    this->next_extent = this->extent_first;
+    while (this->last > 0 && this->free_map[this->last - 1] == FSM_RESERVED)
+        this->last--;
+}
+
+/**
+ * Open the free-space map (creating it if need be) and read it in.
+ * A file from before there were free-space maps starts out with every block in category 0 (no room known of).
+ * @param flags  BerkDb flags the file itself was opened with
+ */
+void HeapFile::fsm_open(uint flags) {
+    if (flags & DB_CREATE)
+        this->fsm.set_re_len(FSM_PAGE_SZ);
+    this->fsm.open(nullptr, this->fsmfilename.c_str(), nullptr, DB_RECNO, flags | DB_CREATE, 0644);
+    this->free_map.assign(this->last, 0);
+    for (uint category = 0; category < FSM_CATEGORIES; category++)
+        this->free_blocks[category].clear();
+    this->queued.assign(this->last, 0);
+    for (uint32_t fsm_page = 1; (fsm_page - 1) * FSM_PAGE_SZ < this->last; fsm_page++) {
+        Dbt key(&fsm_page, sizeof(fsm_page));
+        Dbt data;
+        if (this->fsm.get(nullptr, &key, &data, 0) != 0)
+            continue;
+        uint first = (fsm_page - 1) * FSM_PAGE_SZ;
+        uint n = min(this->last - first, min(data.get_size(), FSM_PAGE_SZ));
+        const uint8_t *bytes = (const uint8_t *) data.get_data();
+        for (uint i = 0; i < n; i++)
+            this->free_map[first + i] = bytes[i] < FSM_CATEGORIES || bytes[i] == FSM_RESERVED || bytes[i] == FSM_CUT
+                                        ? bytes[i] : 0;
+    }
+    // stack them so the lowest block ids come off first, to keep the front of the file full
+    for (BlockID block_id = this->last; block_id > 0; block_id--)
+        if (this->free_map[block_id - 1] > 0 && this->free_map[block_id - 1] < FSM_CATEGORIES)
+            queue_free_block(block_id, this->free_map[block_id - 1]);
+}
+
+/**
+ * Delete the free-space map's file.
+ */
+void HeapFile::fsm_drop() {
+    try {
+        Db fsm(_DB_ENV, 0);
+        fsm.remove(this->fsmfilename.c_str(), nullptr, 0);
+    } catch (DbException &e) {
+        // file made before there were free-space maps
+    }
+}
+
+/**
+ * Set up the right kind of DbBlock for a block of this file.
+ * Existing blocks say what they are in their header; new ones get the file's layout.
+ * @param data      the block's memory
+ * @param block_id
+ * @param is_new    true to initialize the block
+ * @return          the slotted page or PAX page (freed by caller)
+ */
+DbBlock *HeapFile::make_block(Dbt &data, BlockID block_id, bool is_new) {
+    if (is_new ? this->layout == PAX : PaxPage::is_pax(data))
+        return new PaxPage(data, block_id, this->column_attributes, is_new);
+    return new SlottedPage(data, block_id, is_new, is_new);
 }
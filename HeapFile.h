@@ -7,8 +7,11 @@
  */
 #pragma once
 
+#include <vector>
 #include "db_cxx.h"
 #include "SlottedPage.h"
+#include "PaxPage.h"
+#include "BufferPool.h"
 
 
 /**
@@ -17,13 +20,75 @@
  * Heap file organization. Built on top of Berkeley DB RecNo file. There is one of our
         database blocks for each Berkeley DB record in the RecNo file. In this way we are using Berkeley DB
         for buffer management and file management.
-        Uses SlottedPage for storing records within blocks.
+        Uses SlottedPage for storing records within blocks (in deferred-compaction mode), or PaxPage if the
+        file was created with the PAX layout. Each block says which it is in its header, so the layout of an
+        existing file is picked up when it is opened.
+
+        The block size is chosen when the file is created (4K, 8K, 16K, or 32K) and is kept by Berkeley DB
+        as the RecNo record length, so it is picked up again whenever the file is opened.
+
+        A file can instead be created compressed, in which case the RecNo records are variable length and
+        each one is a block behind a 4-byte envelope:
+            Bytes 0x00 - 0x01: envelope flags (COMPRESSED_PAGE if the rest is compressed with LZCodec)
+            Bytes 0x02 - 0x03: block size
+        Blocks are compressed on put and decompressed on get; any block that doesn't get smaller is stored
+        as is (without the flag), so a file can have a mix of both.
+
+        Each file keeps a free-space map beside it (in <name>.fsm.db) so that inserts can find a block with
+        room without reading any blocks. The map has a byte per block giving how much of the block is free,
+        in sixteenths of the block size (rounded down), and is updated whenever a block is put. The map is
+        stored as fixed-length RecNo records of FSM_PAGE_SZ blocks each; only the records that change get
+        written. When the file is opened the map is read and indexed by category, so find_free_block only
+        has to look at the top of at most FSM_CATEGORIES stacks. Blocks in the stacks whose category has
+        since changed are dropped when they come to the top.
+
+        The file only ever gets smaller when it is truncated (see HeapTable::vacuum, which empties out the blocks
+        at the end first). Berkeley DB is then asked to give the room back to the file system. A deleted RecNo
+        record still counts as one, though, so the blocks cut off are marked FSM_CUT in the free-space map
+        first, and that is how the end of the file is found when it is reopened.
+
+        Blocks are got through the buffer pool (_BUFFER_POOL), so a block already in a frame is not read again,
+        and the DbBlock returned by get works right on the frame until it is deleted. A block that is put is
+        only marked dirty (write-behind), so putting the same block over and over, as a run of inserts does,
+        writes it to Berkeley DB once: when its frame is reused, at a checkpoint (which SQLExec does at the
+        end of every statement), or when the file is closed. Scans read blocks in bulk with scan_blocks
+        instead of a get per block.
+
+        New blocks are written out an extent at a time, all initialized empty in one batch, and then handed
+        out by get_new without going back to Berkeley DB. Extents start at EXTENT_FIRST blocks and double up
+        to EXTENT_MOST. Blocks reserved but not yet handed out are past last, so they aren't scanned, and are
+        marked FSM_RESERVED in the free-space map, which is how they're told apart from blocks in use when the
+        file is reopened.
  */
 class HeapFile : public DbFile {
 public:
-    HeapFile(std::string name);
+    /**
+     * How much of the file BulkScan gets from Berkeley DB at a time.
+     */
+    static const uint BULK_BUFFER_SZ = 1024 * 1024;
+
+    /**
+     * Blocks get_new reserves at a time to start with, and most it ever reserves at a time (see set_extents).
+     */
+    static const uint EXTENT_FIRST = 4, EXTENT_MOST = 128;
+
+    /**
+     * How records are laid out within the blocks of the file.
+     */
+    enum BlockLayout {
+        SLOTTED_PAGE,  // records kept whole (SlottedPage)
+        PAX            // records split up by column (PaxPage)
+    };
+
+    /**
+     * Envelope flag for a compressed block in a compressed file.
+     */
+    static const uint16_t COMPRESSED_PAGE = 0x0001;
+
+    HeapFile(std::string name, uint block_size = DbBlock::BLOCK_SZ, BlockLayout layout = SLOTTED_PAGE,
+             const ColumnAttributes &column_attributes = ColumnAttributes(), bool compressed = false);
 
-    virtual ~HeapFile() {}
+    virtual ~HeapFile();
 
     HeapFile(const HeapFile &other) = delete;
 
@@ -41,28 +106,208 @@ public:
 
     virtual void close(void);
 
-    virtual SlottedPage *get_new(void);
+    virtual DbBlock *get_new(void);
 
-    virtual SlottedPage *get(BlockID block_id);
+    virtual DbBlock *get(BlockID block_id);
 
     virtual void put(DbBlock *block);
 
     virtual BlockIDs *block_ids() const;
 
+    /**
+     * @class HeapFile::BlockScan - reads all the blocks of a file in order, one at a time (with get)
+     */
+    class BlockScan : public DbBlockScan {
+    public:
+        explicit BlockScan(HeapFile &file) : file(file), block_id(0) {}
+
+        virtual ~BlockScan() {}
+
+        /**
+         * Get the next block.
+         * @returns  the block (freed by caller), or nullptr if there are no more
+         */
+        virtual DbBlock *next();
+
+    protected:
+        HeapFile &file;
+        BlockID block_id;
+    };
+
+    /**
+     * Start reading all the blocks of the file in order, as fast as the file can.
+     * For a Berkeley DB file, that is with a cursor and bulk retrieval (see BulkScan).
+     * @returns  the scan (freed by caller, and only good while the file is open)
+     */
+    virtual BlockScan *scan_blocks();
+
+    /**
+     * Check if there is a Berkeley DB heap file for the given name.
+     * @param name  name the file would have been constructed with
+     * @returns     true if there is one
+     */
+    static bool exists(std::string name);
+
+    /**
+     * Find a block with room for another record, using only the free-space map.
+     * @param size  size of the record to be added
+     * @return      id of a block that should have room, or 0 if no block is known to
+     */
+    virtual BlockID find_free_block(uint size);
+
     /**
      * Get the id of the current final block in the heap file.
      * @return block id of last block
      */
     virtual uint32_t get_last_block_id() { return last; }
 
+    /**
+     * Get the size of the blocks in this file.
+     * @return block size in bytes (only known for certain once the file is open)
+     */
+    virtual uint get_block_size() const { return block_size; }
+
+    /**
+     * Get the layout of the blocks in this file.
+     * @return SLOTTED_PAGE or PAX (only known for certain once the file is open)
+     */
+    virtual BlockLayout get_layout() const { return layout; }
+
+    /**
+     * Check if the blocks in this file are compressed.
+     * @return true if the file was created compressed (only known for certain once the file is open)
+     */
+    virtual bool is_compressed() const { return compressed; }
+
+    /**
+     * Turn write-behind on or off (it is on to start with). With it on, put just marks the block dirty in
+     * the buffer pool, and it is written to Berkeley DB later (see BufferPool::checkpoint); with it off, put
+     * writes the block right away. Turning it off writes out any of the file's blocks still waiting.
+     * @param on  true for write-behind
+     */
+    virtual void set_write_behind(bool on);
+
+    /**
+     * Get the buffer pool the file's blocks are got through.
+     * @return the pool, or nullptr if blocks are got straight from the file (and may not outlast the next get)
+     */
+    virtual BufferPool *get_pool() const { return pool; }
+
+    /**
+     * Cut the file short after a given block, along with any blocks reserved but not handed out yet, so the
+     * file takes up less room. The blocks after it should all be empty by now.
+     * @param block_id  block to be the last one (at least 1)
+     * @return          number of blocks in use that were cut off
+     */
+    virtual BlockID truncate(BlockID block_id);
+
+    /**
+     * Check if put leaves blocks to be written later.
+     * @return true if write-behind is on (and there is a buffer pool to do it)
+     */
+    virtual bool is_write_behind() const { return write_behind && pool != nullptr; }
+
+    /**
+     * Set how many blocks get_new reserves at a time: first to start with (each time the file is opened), then
+     * twice as many each time, up to most. 1 and 1 go back to allocating a block at a time.
+     * @param first  blocks in the first extent
+     * @param most   most blocks in an extent
+     */
+    virtual void set_extents(uint first, uint most);
+
 protected:
+    static const uint PAGE_ENVELOPE_SZ = 4;  // envelope ahead of each block in a compressed file
+    static const uint FSM_PAGE_SZ = 1024;     // number of blocks mapped by each record of the free-space map
+    static const uint FSM_CATEGORIES = 16;    // free space is kept in sixteenths of the block size
+    static const uint FSM_RECORD_OVERHEAD = 4; // room a block needs beyond the record itself (a slot header)
+    static const uint8_t FSM_RESERVED = 0xFF;  // free-space map entry of a block reserved but not handed out
+    static const uint8_t FSM_CUT = 0xFE;       // free-space map entry of a block cut off by truncate
+
     std::string dbfilename;
+    uint block_size;
+    BlockLayout layout;
+    ColumnAttributes column_attributes;
+    bool compressed;
+    std::vector<char> page_buffer;  // where get decompresses to without a buffer pool (good until the next get)
     uint32_t last;
     bool closed;
     Db db;
+    std::string fsmfilename;
+    std::vector<uint8_t> free_map;  // free-space category of each block (block_id - 1)
+    std::vector<BlockID> free_blocks[FSM_CATEGORIES];  // blocks by category (possibly stale, see find_free_block)
+    std::vector<uint16_t> queued;  // bit per category whose free_blocks holds the block (block_id - 1)
+    Db fsm;
+    BufferPool *pool;
+    uint pool_file_id;
+    ulong block_writes;          // blocks written to Berkeley DB so far
+    std::vector<ulong> written;  // block_writes as of each block's last write (block_id - 1)
+    bool write_behind;
+    BlockID reserved;  // last block written out by reserve (blocks after last are ready for get_new)
+    uint extent_first;
+    uint extent_most;
+    uint next_extent;  // blocks the next reserve writes out
 
     virtual void db_open(uint flags = 0);
 
+    virtual void read_block(BlockID block_id, Dbt &block, char *into);
+
+    virtual void unpack(const Dbt &stored, Dbt &block, char *into);
+
+    virtual DbBlock *stored_block(BlockID block_id, const Dbt &stored);
+
+    virtual bool written_since(BlockID block_id, ulong stamp) const;
+
+    virtual void write_block(BlockID block_id, const char *bytes);
+
+    virtual void write_blocks(const std::vector<std::pair<BlockID, const char *>> &blocks);
+
+    virtual void reserve();
+
+    virtual void cut_after(BlockID block_id);
+
+    virtual void fsm_open(uint flags);
+
+    virtual void fsm_drop();
+
+    virtual void note_free_space(BlockID block_id, uint unused_bytes);
+
+    virtual void queue_free_block(BlockID block_id, uint category);
+
+    virtual void fsm_write(uint32_t fsm_page);
+
     virtual uint32_t get_block_count();
+
+    virtual DbBlock *make_block(Dbt &data, BlockID block_id, bool is_new = false);
+
+    /**
+     * @class HeapFile::BulkScan - reads the blocks of a Berkeley DB file with a cursor, getting as many blocks
+     * as fit in BULK_BUFFER_SZ with each call (DB_MULTIPLE_KEY). Blocks that are in the buffer pool are taken
+     * from there instead (in case they are newer); the others are put into the pool as they are handed out,
+     * so projecting rows of the block just handed out doesn't have to read it again. New blocks still waiting
+     * to be written (write-behind) aren't in Berkeley DB yet, so any block ids the cursor skips over are got
+     * from the pool. A block written to Berkeley DB after the buffer was filled (changed, and then
+     * pushed out of the pool) is read again instead, since the buffer's copy of it is stale.
+     */
+    class BulkScan : public BlockScan {
+    public:
+        explicit BulkScan(HeapFile &file);
+
+        virtual ~BulkScan();
+
+        virtual DbBlock *next();
+
+    protected:
+        Dbc *cursor;
+        std::vector<char> buffer;
+        Dbt bulk;
+        DbMultipleRecnoDataIterator *records;  // within buffer, or null if the buffer needs filling
+        bool done;
+        ulong filled;  // the file's block_writes when the buffer was filled
+        bool pending;         // whether recno and stored hold a record not yet handed out
+        db_recno_t recno;
+        Dbt stored;
+    };
+
+    friend class BufferPool;
 };
 
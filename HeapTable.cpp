@@ -3,8 +3,14 @@
  * @author K Lundeen
  * @see Seattle University, CPSC5300
  */
+#include <algorithm>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <exception>
+#include <thread>
 #include "HeapTable.h"
+#include "LZCodec.h"
 
 using namespace std;
 typedef uint16_t u16;
@@ -14,9 +20,32 @@ typedef uint16_t u16;
  * @param table_name
  * @param column_names
  * @param column_attributes
+ * @param block_size         block size for the file, if it gets created (existing files keep theirs)
+ * @param layout             block layout for the file, if it gets created (existing files keep theirs)
+ * @param compressed         whether to compress the file's blocks, if it gets created (existing files keep theirs)
+ * @param engine             what keeps the blocks (BERKELEY_DB, MMAP, URING, or DIRECT)
  */
-HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes) : DbRelation(
-        table_name, column_names, column_attributes), file(table_name) {
+HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+                     uint block_size, HeapFile::BlockLayout layout, bool compressed, StorageEngine engine)
+        : DbRelation(table_name, column_names, column_attributes), file(nullptr),
+          toast(table_name + ".toast", block_size), codec(*this), zones(table_name, column_names, column_attributes),
+          parallelism(1) {
+    if (engine == MMAP) {
+        if (compressed)
+            throw DbRelationError("mmap tables can't be compressed");
+        this->file = new MmapHeapFile(table_name, block_size, layout, column_attributes);
+    } else if (engine == URING || engine == DIRECT) {
+        if (compressed)
+            throw DbRelationError("uring tables can't be compressed");
+        this->file = new UringHeapFile(table_name, block_size, layout, column_attributes,
+                                       UringHeapFile::DEFAULT_QUEUE_DEPTH, engine == DIRECT);
+    } else {
+        this->file = new HeapFile(table_name, block_size, layout, column_attributes, compressed);
+    }
+}
+
+HeapTable::~HeapTable() {
+    delete this->file;
 }
 
 /**
@@ -24,7 +53,8 @@ HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttr
  * Is not responsible for metadata storage or validation.
  */
 void HeapTable::create() {
-    file.create();
+    file->create();
+    zones.create();
 }
 
 /**
@@ -43,21 +73,41 @@ void HeapTable::create_if_not_exists() {
  * Execute: DROP TABLE <table_name>
  */
 void HeapTable::drop() {
-    file.drop();
+    file->drop();
+    zones.drop();
+    try {
+        toast.open();
+        toast.drop();
+    } catch (DbException &e) {
+        // never needed one
+    }
 }
 
 /**
  * Open existing table. Enables: insert, update, delete, select, project
+ * A table from before there were zone maps gets its zones worked out.
  */
 void HeapTable::open() {
-    file.open();
+    file->open();
+    if (!zones.open(file->get_last_block_id()))
+        rezone();
 }
 
 /**
  * Closes the table. Disables: insert, update, delete, select, project
  */
 void HeapTable::close() {
-    file.close();
+    file->close();
+    toast.close();
+    zones.close();
+}
+
+/**
+ * Write out the zones changed since the last checkpoint.
+ */
+void HeapTable::checkpoint() {
+    if (zones.is_open())
+        zones.flush();
 }
 
 /**
@@ -69,19 +119,220 @@ Handle HeapTable::insert(const ValueDict *row) {
     open();
     ValueDict *full_row = validate(row);
     Handle handle = append(full_row);
+    zones.add(handle.first, *full_row);
     delete full_row;
     return handle;
 }
 
+/**
+ * Execute: INSERT INTO <table_name> (<row_keys>) VALUES (<row_values>), (<row_values>), ...
+ * The block being filled stays pinned until it has no room for the next row, and is put just once; every row
+ * is marshaled into the same buffer.
+ * @param rows  dictionaries with column name keys
+ * @return the handles of the inserted rows, in order (freed by caller)
+ * @throws DbRelationError if a row isn't valid (the rows before it are inserted)
+ */
+Handles *HeapTable::insert_batch(const ValueDicts &rows) {
+    open();
+    Handles *handles = new Handles();
+    handles->reserve(rows.size());
+    HeapFile &heap_file = *this->file;
+    char *bytes = new char[heap_file.get_block_size()];
+    DbBlock *block = nullptr;
+    bool pending = false;  // bytes has a row not yet added (whose TOAST values have to go if it never is)
+    try {
+        for (auto const &row: rows) {
+            Dbt data(bytes, marshal(row, bytes));
+            pending = true;
+            if (block == nullptr) {
+                BlockID block_id = heap_file.find_free_block(data.get_size());
+                block = heap_file.get(block_id == 0 ? heap_file.get_last_block_id() : block_id);
+            }
+            RecordID record_id;
+            try {
+                record_id = block->add(&data);
+            } catch (DbBlockNoRoomError &e) {
+                // done with this block: on to one the free-space map says has room, else a new one
+                heap_file.put(block);
+                delete block;
+                block = nullptr;
+                BlockID block_id = heap_file.find_free_block(data.get_size());
+                block = block_id == 0 ? heap_file.get_new() : heap_file.get(block_id);
+                record_id = block->add(&data);
+            }
+            pending = false;
+            handles->push_back(Handle(block->get_block_id(), record_id));
+            zones.add(block->get_block_id(), *row);
+        }
+    } catch (...) {
+        if (pending)
+            toast_del_row(bytes, (uint) this->column_names.size());
+        if (block != nullptr) {
+            heap_file.put(block);
+            delete block;
+        }
+        delete[] bytes;
+        delete handles;
+        throw;
+    }
+    if (block != nullptr) {
+        heap_file.put(block);
+        delete block;
+    }
+    delete[] bytes;
+    return handles;
+}
+
 /**
  * Conceptually, execute: UPDATE INTO <table_name> SET <new_values> WHERE <handle>
  * where handle is sufficient to identify one specific record (e.g., returned from an insert
  * or select).
+ * The row is rewritten in place if its block has room for it. If not, it moves to another block and leaves a
+ * forwarding stub behind, so its handle stays good. A row that has moved goes back to its own block once there
+ * is room for it there again.
  * @param handle the row to be updated
- * @param new_values a dictionary with column name keys
+ * @param new_values a dictionary with column name keys (just the columns to change)
+ * @throws DbRelationError if the row has been deleted, a column isn't one of the table's, or there is no room
+ *                         (the row of a PAX table can't move, and a row can't move if it is too small to leave
+ *                         a stub in its place)
  */
 void HeapTable::update(const Handle handle, const ValueDict *new_values) {
-    throw DbRelationError("Not implemented");
+    open();
+    HeapFile &heap_file = *this->file;
+    DbBlock *home = heap_file.get(handle.first);
+    DbBlock *block = nullptr;  // where the row has moved to, if it has
+    char *bytes = new char[FORWARD_SZ + heap_file.get_block_size()];
+    ValueDict *row = nullptr;
+    vector<string> old_toast;
+    Dbt data(bytes + FORWARD_SZ, 0);
+    try {
+        Handle moved;
+        if (forwarded(home, handle.second, moved))
+            block = heap_file.get(moved.first);
+        u16 size;
+        const char *old_bytes = row_view(block != nullptr ? block : home, block != nullptr ? moved.second
+                                                                                           : handle.second, size);
+        if (old_bytes == nullptr)
+            throw DbRelationError("row to update has been deleted");
+
+        // the new row is the old one with the new values put in
+        row = this->codec.decode(old_bytes);
+        for (auto const &column: *new_values) {
+            if (this->codec.column_number(column.first) < 0)
+                throw DbRelationError("table does not have column named '" + column.first + "'");
+            (*row)[column.first] = column.second;
+        }
+        for (uint col_num = 0; col_num < this->column_names.size(); col_num++) {
+            const char *pointer = this->codec.toast_pointer(old_bytes, col_num);
+            if (pointer != nullptr)
+                old_toast.push_back(string(pointer, TOAST_POINTER_SZ));
+        }
+        data.set_size(marshal(row, bytes + FORWARD_SZ));
+        place(home, handle.second, block, moved, data);
+        zones.add(handle.first, *row);  // the row's zone is its stub's, wherever it went
+    } catch (...) {
+        if (data.get_size() > 0)  // marshaled but not placed (marshal cleans up after itself)
+            toast_del_row(bytes + FORWARD_SZ, (uint) this->column_names.size());
+        delete block;
+        delete home;
+        delete row;
+        delete[] bytes;
+        throw;
+    }
+    delete block;
+    delete home;
+    delete row;
+    delete[] bytes;
+    for (auto const &pointer: old_toast)
+        toast_del(pointer.data());
+}
+
+/**
+ * Put the new version of a row where it belongs: in its own block if there is room, else where it has already
+ * moved to if there is room there, else in yet another block.
+ * @param home       the row's own block
+ * @param record_id  the row's record in home
+ * @param block      the block the row has moved to, or nullptr if it hasn't
+ * @param moved      where the row has moved to (if it has)
+ * @param data       the marshaled row, with FORWARD_SZ bytes before it for the pointer back to home
+ * @throws DbRelationError if there is no room and the row can't move
+ */
+void HeapTable::place(DbBlock *home, RecordID record_id, DbBlock *block, Handle moved, const Dbt &data) {
+    HeapFile &heap_file = *this->file;
+    try {
+        home->put(record_id, data);
+        if (block != nullptr) {
+            home->set_marked(record_id, false);
+            block->del(moved.second);
+            heap_file.put(block);
+        }
+        heap_file.put(home);
+        return;
+    } catch (DbBlockNoRoomError &e) {
+        if (dynamic_cast<PaxPage *>(home) != nullptr)
+            throw DbRelationError("no room for the updated row in its block");
+    }
+
+    // it has to live somewhere else, with a pointer back to home in front of it
+    char *with_home = (char *) data.get_data() - FORWARD_SZ;
+    *(BlockID *) with_home = home->get_block_id();
+    *(RecordID *) (with_home + sizeof(BlockID)) = record_id;
+    Dbt moving(with_home, FORWARD_SZ + data.get_size());
+    if (block != nullptr) {
+        try {
+            block->put(moved.second, moving);
+            heap_file.put(block);
+            return;
+        } catch (DbBlockNoRoomError &e) {
+            // on to another block
+        }
+    }
+    Handle to = relocate(moving, home->get_block_id(), block != nullptr ? block->get_block_id() : 0);
+    char stub[FORWARD_SZ];
+    *(BlockID *) stub = to.first;
+    *(RecordID *) (stub + sizeof(BlockID)) = to.second;
+    try {
+        home->put(record_id, Dbt(stub, FORWARD_SZ));
+    } catch (DbBlockNoRoomError &e) {
+        DbBlock *other = heap_file.get(to.first);
+        other->del(to.second);
+        heap_file.put(other);
+        delete other;
+        throw DbRelationError("no room for the updated row in its block, nor for a stub to where it could move");
+    }
+    home->set_marked(record_id, true);
+    heap_file.put(home);
+    if (block != nullptr) {
+        block->del(moved.second);
+        heap_file.put(block);
+    }
+}
+
+/**
+ * Add a row that is moving out of its own block to some other block, marked as having moved.
+ * @param data   the row, with the pointer back to its own block in front
+ * @param home   block the row is moving out of (not to be used)
+ * @param from   block the row had already moved to, or 0 (not to be used either)
+ * @return       where it went
+ * @throws DbRelationError if it is too big for any block
+ */
+Handle HeapTable::relocate(const Dbt &data, BlockID home, BlockID from) {
+    HeapFile &heap_file = *this->file;
+    BlockID block_id = heap_file.find_free_block(data.get_size());
+    DbBlock *block = block_id == 0 || block_id == home || block_id == from ? heap_file.get_new()
+                                                                          : heap_file.get(block_id);
+    RecordID record_id;
+    try {
+        record_id = block->add(&data);
+    } catch (DbBlockNoRoomError &e) {
+        delete block;
+        throw DbRelationError("updated row too big to move to another block");
+    }
+    block->set_marked(record_id, true);
+    heap_file.put(block);
+    Handle to(block->get_block_id(), record_id);
+    delete block;
+    return to;
 }
 
 /**
@@ -94,12 +345,204 @@ void HeapTable::del(const Handle handle) {
     open();
     BlockID block_id = handle.first;
     RecordID record_id = handle.second;
-    SlottedPage *block = this->file.get(block_id);
+    DbBlock *block = this->file->get(block_id);
+
+    // a row that has moved is deleted where it is, and then its stub
+    Handle moved;
+    DbBlock *moved_block = nullptr;
+    if (forwarded(block, record_id, moved))
+        moved_block = this->file->get(moved.first);
+
+    // free any of its TEXT that is out of line
+    u16 size;
+    const char *bytes = row_view(moved_block != nullptr ? moved_block : block,
+                                 moved_block != nullptr ? moved.second : record_id, size);
+    if (bytes != nullptr)
+        toast_del_row(bytes, (uint) this->column_names.size());
+
+    if (moved_block != nullptr) {
+        moved_block->del(moved.second);
+        this->file->put(moved_block);
+        delete moved_block;
+    }
     block->del(record_id);
-    this->file.put(block);
+    this->file->put(block);
+    if (block->size() == 0)
+        zones.clear(block_id);
     delete block;
 }
 
+/**
+ * Pack the rows into as few blocks as they fit in, and cut the empty blocks off the end of the file.
+ * Going back from the last block, each record is added to the front-most block with room for it. A row that
+ * had moved out of its own block goes back there in place of its stub if there is room for it now, and never
+ * into that block behind a stub of its own.
+ * @param moved  set to the old and new handle of each row whose handle changed
+ * @return       number of blocks cut off the end of the file
+ */
+BlockID HeapTable::vacuum(map<Handle, Handle> &moved) {
+    open();
+    HeapFile &heap_file = *this->file;
+    BlockID front = 1, back = heap_file.get_last_block_id();
+    DbBlock *to = nullptr;    // block at front, once it has been got
+    DbBlock *from = nullptr;  // block at back
+
+    // get a block, or use to or from if it is one of them (two DbBlocks on the same block would get out of step)
+    auto acquire = [&](BlockID block_id) -> DbBlock * {
+        if (to != nullptr && block_id == to->get_block_id())
+            return to;
+        if (from != nullptr && block_id == from->get_block_id())
+            return from;
+        return heap_file.get(block_id);
+    };
+    auto release = [&](DbBlock *block, bool changed) {
+        if (changed)
+            heap_file.put(block);
+        if (block != to && block != from)
+            delete block;
+    };
+    // add a record to the front-most block with room for it, or return false if none before back has room
+    // (skip, if not 0, is passed over as if it had no room, which it is only asked to do when it hasn't)
+    auto add = [&](const Dbt &data, Handle &where, BlockID skip) -> bool {
+        while (front < back) {
+            if (front != skip) {
+                if (to == nullptr)
+                    to = heap_file.get(front);
+                try {
+                    where = Handle(front, to->add(&data));
+                    return true;
+                } catch (DbBlockNoRoomError &e) {
+                    // on to the next block
+                }
+            }
+            if (to != nullptr) {
+                heap_file.put(to);
+                delete to;
+                to = nullptr;
+            }
+            front++;
+        }
+        return false;
+    };
+
+    while (front < back) {
+        from = heap_file.get(back);
+        RecordIDs *record_ids = from->ids();
+        for (auto const record_id: *record_ids) {
+            u16 size;
+            const char *bytes = from->view(record_id, size);
+            Handle where, stub_to;
+            if (forwarded(from, record_id, stub_to)) {
+                // a stub brings its row along from where it moved to, as an ordinary row again
+                DbBlock *block = acquire(stub_to.first);
+                bytes = row_view(block, stub_to.second, size);
+                vector<char> row(bytes, bytes + size);
+                release(block, false);
+                Dbt data(row.data(), size);
+                if (!add(data, where, 0))
+                    break;
+                block = acquire(stub_to.first);
+                block->del(stub_to.second);
+                release(block, true);
+                moved[Handle(back, record_id)] = where;
+            } else if (from->is_marked(record_id)) {
+                // a row that moved here goes back to its own block in place of its stub if there is room there
+                // now; if not, it moves again, back pointer and all (but not into its own block, where it would
+                // share a block with its stub), and its stub is pointed at it
+                vector<char> row(bytes, bytes + size);
+                Handle home(*(BlockID *) row.data(), *(RecordID *) (row.data() + sizeof(BlockID)));
+                DbBlock *block = acquire(home.first);
+                bool at_home = false;
+                try {
+                    block->put(home.second, Dbt(row.data() + FORWARD_SZ, size - FORWARD_SZ));
+                    block->set_marked(home.second, false);
+                    at_home = true;
+                } catch (DbBlockNoRoomError &e) {
+                    // move it on instead
+                }
+                release(block, at_home);
+                if (!at_home) {
+                    Dbt data(row.data(), size);
+                    if (!add(data, where, home.first))
+                        break;
+                    to->set_marked(where.second, true);
+                    char stub[FORWARD_SZ];
+                    *(BlockID *) stub = where.first;
+                    *(RecordID *) (stub + sizeof(BlockID)) = where.second;
+                    block = acquire(home.first);
+                    block->put(home.second, Dbt(stub, FORWARD_SZ));
+                    release(block, true);
+                }
+            } else {
+                Dbt data((void *) bytes, size);
+                if (!add(data, where, 0))
+                    break;
+                moved[Handle(back, record_id)] = where;
+            }
+            from->del(record_id);
+        }
+        delete record_ids;
+        bool emptied = from->size() == 0;
+        heap_file.put(from);
+        delete from;
+        from = nullptr;
+        if (!emptied)
+            break;
+        back--;
+    }
+    if (to != nullptr) {
+        heap_file.put(to);
+        delete to;
+    }
+
+    // blocks that were empty to start with can go too
+    for (; back > 1; back--) {
+        DbBlock *block = heap_file.get(back);
+        bool empty = block->size() == 0;
+        delete block;
+        if (!empty)
+            break;
+    }
+    BlockID reclaimed = heap_file.truncate(back);
+    rezone();  // rows have moved all over
+    return reclaimed;
+}
+
+/**
+ * Check if a record is the forwarding stub of a row that has moved to another block.
+ * @param block      block the record is in
+ * @param record_id  the record
+ * @param to         set to where the row is, if it has moved
+ * @return           true if it has moved
+ */
+bool HeapTable::forwarded(const DbBlock *block, RecordID record_id, Handle &to) {
+    if (!block->is_marked(record_id))
+        return false;
+    u16 size;
+    const char *bytes = block->view(record_id, size);
+    if (size != FORWARD_SZ)
+        return false;  // it's the moved row, not the stub
+    to = Handle(*(BlockID *) bytes, *(RecordID *) (bytes + sizeof(BlockID)));
+    return true;
+}
+
+/**
+ * Look at a row where it sits in its block: just the record, except for a row that has moved there from
+ * another block, which has the pointer back to its own block in front.
+ * @param block      block the row is in
+ * @param record_id  the row's record
+ * @param size       set to the size of the row
+ * @return           the row, or nullptr if it has been deleted
+ */
+const char *HeapTable::row_view(const DbBlock *block, RecordID record_id, u16 &size) {
+    const char *bytes = block->view(record_id, size);
+    if (bytes != nullptr && size > FORWARD_SZ && block->is_marked(record_id)) {
+        bytes += FORWARD_SZ;
+        size -= FORWARD_SZ;
+    }
+    return bytes;
+}
+
 /**
  * Conceptually, execute: SELECT <handle> FROM <table_name> WHERE 1
  * @return a list of handles for qualifying rows
@@ -115,20 +558,14 @@ Handles *HeapTable::select() {
  */
 Handles *HeapTable::select(const ValueDict *where) {
     open();
+    if (where != nullptr && this->parallelism > 1 && this->file->get_pool() != nullptr)
+        return parallel_select(where);
     Handles *handles = new Handles();
-    BlockIDs *block_ids = file.block_ids();
-    for (auto const &block_id: *block_ids) {
-        SlottedPage *block = file.get(block_id);
-        RecordIDs *record_ids = block->ids();
-        for (auto const &record_id: *record_ids) {
-            Handle handle(block_id, record_id);
-            if (selected(handle, where))
-                handles->push_back(handle);
-        }
-        delete record_ids;
-        delete block;
-    }
-    delete block_ids;
+    DbHandleIterator *rows = scan(where);
+    Handle handle;
+    while (rows->next(handle))
+        handles->push_back(handle);
+    delete rows;
     return handles;
 }
 
@@ -140,13 +577,330 @@ Handles *HeapTable::select(const ValueDict *where) {
  * @return                  list of handles of the selected rows
  */
 Handles *HeapTable::select(Handles *current_selection, const ValueDict *where) {
+    RowCodec::Predicate predicate(this->codec, where);
     Handles *handles = new Handles();
     for (auto const &handle: *current_selection)
-        if (selected(handle, where))
+        if (selected(handle, predicate))
             handles->push_back(handle);
     return handles;
 }
 
+/**
+ * The select command, a row at a time.
+ * @param where predicates to match (nullptr for all rows)
+ * @return iterator over the handles of the selected rows (freed by caller)
+ */
+DbHandleIterator *HeapTable::scan(const ValueDict *where) {
+    open();
+    return new ScanIterator(*this, where);
+}
+
+/**
+ * Refine another selection, a row at a time.
+ * @param current_selection iterator over the handles to filter (freed along with the returned iterator)
+ * @param where             predicates to match
+ * @return                  iterator over the handles of the selected rows (freed by caller)
+ */
+DbHandleIterator *HeapTable::scan(DbHandleIterator *current_selection, const ValueDict *where) {
+    return new FilterIterator(*this, current_selection, where);
+}
+
+HeapTable::ScanIterator::ScanIterator(HeapTable &table, const ValueDict *where)
+        : table(table), predicate(table.codec, where), blocks(table.scan_blocks(where)), block_id(0),
+          record_ids(nullptr), pos(0) {
+}
+
+HeapTable::ScanIterator::~ScanIterator() {
+    delete this->blocks;
+    delete this->record_ids;
+}
+
+bool HeapTable::ScanIterator::next(Handle &handle) {
+    while (true) {
+        if (this->record_ids != nullptr && this->pos < this->record_ids->size()) {
+            handle = Handle(this->block_id, (*this->record_ids)[this->pos++]);
+            return true;
+        }
+        delete this->record_ids;
+        this->record_ids = nullptr;
+        DbBlock *block = this->blocks->next();
+        if (block == nullptr)
+            return false;
+        this->block_id = block->get_block_id();
+        this->record_ids = this->table.select_block(block, this->predicate);
+        this->pos = 0;
+        delete block;
+    }
+}
+
+/**
+ * Find the rows of a block that satisfy a where clause.
+ * Rows that have moved here are left out; the stubs they left behind here are in their place, checked where the
+ * rows are now.
+ * @param block      the block
+ * @param predicate  where clause (its latch, if it has one, is held while going to other blocks)
+ * @return           ids of the records that match, in order (freed by caller)
+ */
+RecordIDs *HeapTable::select_block(DbBlock *block, const RowCodec::Predicate &predicate) {
+    BlockID block_id = block->get_block_id();
+    RecordIDs *record_ids = block->ids();
+    RecordIDs forwarded;
+    auto kept = record_ids->begin();
+    for (auto const record_id: *record_ids) {
+        Handle to;
+        if (!block->is_marked(record_id)) {
+            *kept++ = record_id;
+        } else if (HeapTable::forwarded(block, record_id, to)) {
+            if (predicate.get_latch() != nullptr) {
+                lock_guard<recursive_mutex> latched(*predicate.get_latch());
+                if (selected(Handle(block_id, record_id), predicate))
+                    forwarded.push_back(record_id);
+            } else if (predicate.is_everything() || selected(Handle(block_id, record_id), predicate)) {
+                forwarded.push_back(record_id);
+            }
+        }
+    }
+    record_ids->erase(kept, record_ids->end());
+    if (!predicate.is_everything())
+        predicate.filter(block, *record_ids);
+    if (!forwarded.empty()) {
+        RecordIDs *all = new RecordIDs(record_ids->size() + forwarded.size());
+        merge(record_ids->begin(), record_ids->end(), forwarded.begin(), forwarded.end(), all->begin());
+        delete record_ids;
+        record_ids = all;
+    }
+    return record_ids;
+}
+
+/**
+ * Set how many worker threads a select with a where clause spreads its blocks over.
+ * @param degree  number of workers, or 0 for as many as the machine has cores
+ */
+void HeapTable::set_parallelism(uint degree) {
+    if (degree == 0)
+        degree = thread::hardware_concurrency();
+    this->parallelism = degree > 0 ? degree : 1;
+}
+
+/**
+ * The select command, with the blocks spread over parallelism worker threads.
+ * This thread reads the blocks (pinned in the buffer pool until the workers are done with them) and queues them up
+ * a morsel at a time, keeping no more than half the pool's frames pinned. The workers take morsels off the queue
+ * and find the rows of each of its blocks that satisfy the where clause. Then the morsels' rows are put together
+ * in block order, so the result is just what a select on one thread would have found.
+ * @param where predicates to match
+ * @return list of handles of the selected rows
+ */
+Handles *HeapTable::parallel_select(const ValueDict *where) {
+    struct Morsel {
+        vector<DbBlock *> blocks;
+        Handles handles;
+        bool done;
+        exception_ptr error;
+    };
+    recursive_mutex latch;  // held by anyone going to the buffer pool or the files
+    RowCodec::Predicate predicate(this->codec, where, &latch);
+    mutex queue_mutex;      // held by anyone looking at queue, done, or no_more
+    condition_variable queued, done;
+    deque<Morsel *> queue;
+    bool no_more = false;
+
+    auto work = [&]() {
+        unique_lock<mutex> lock(queue_mutex);
+        while (true) {
+            queued.wait(lock, [&]() { return !queue.empty() || no_more; });
+            if (queue.empty())
+                return;
+            Morsel *morsel = queue.front();
+            queue.pop_front();
+            lock.unlock();
+            try {
+                for (auto const block: morsel->blocks) {
+                    RecordIDs *record_ids = select_block(block, predicate);
+                    for (auto const record_id: *record_ids)
+                        morsel->handles.push_back(Handle(block->get_block_id(), record_id));
+                    delete record_ids;
+                }
+            } catch (...) {
+                morsel->error = current_exception();
+            }
+            lock.lock();
+            morsel->done = true;
+            done.notify_one();
+        }
+    };
+
+    BufferPool *pool = this->file->get_pool();
+    const size_t most_pinned = max(pool->get_num_frames() / 2, 1u);
+    const size_t morsel_blocks = max(min((size_t) MORSEL_BLOCKS, most_pinned / (2 * this->parallelism)), (size_t) 1);
+    vector<Morsel *> morsels;  // in block order
+    vector<Morsel *> in_flight;  // queued or being worked on, still holding their blocks
+    size_t pinned = 0;
+
+    // unpin the blocks of the morsels the workers are done with (waiting for one, if need be)
+    auto release = [&](bool wait) {
+        vector<DbBlock *> blocks;
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            if (wait)
+                done.wait(lock, [&]() {
+                    return any_of(in_flight.begin(), in_flight.end(), [](const Morsel *m) { return m->done; });
+                });
+            auto kept = in_flight.begin();
+            for (auto const morsel: in_flight)
+                if (morsel->done)
+                    blocks.insert(blocks.end(), morsel->blocks.begin(), morsel->blocks.end());
+                else
+                    *kept++ = morsel;
+            in_flight.erase(kept, in_flight.end());
+        }
+        pinned -= blocks.size();
+        lock_guard<recursive_mutex> latched(latch);
+        for (auto const block: blocks)
+            delete block;
+    };
+
+    vector<thread> workers;
+    HeapFile::BlockScan *blocks = nullptr;
+    exception_ptr error;
+    try {
+        for (uint i = 0; i < this->parallelism; i++)
+            workers.push_back(thread(work));
+        {
+            lock_guard<recursive_mutex> latched(latch);
+            blocks = scan_blocks(where);
+        }
+        Morsel *morsel = nullptr;
+        while (true) {
+            DbBlock *block;
+            {
+                lock_guard<recursive_mutex> latched(latch);
+                block = blocks->next();
+            }
+            if (block != nullptr) {
+                if (morsel == nullptr) {
+                    morsel = new Morsel();
+                    morsel->done = false;
+                    morsels.push_back(morsel);
+                }
+                morsel->blocks.push_back(block);
+                pinned++;
+            }
+            if (morsel != nullptr && (block == nullptr || morsel->blocks.size() == morsel_blocks)) {
+                {
+                    lock_guard<mutex> lock(queue_mutex);
+                    in_flight.push_back(morsel);
+                    queue.push_back(morsel);
+                }
+                queued.notify_one();
+                morsel = nullptr;
+            }
+            if (block == nullptr)
+                break;
+            release(pinned >= most_pinned);
+        }
+    } catch (...) {
+        error = current_exception();
+    }
+
+    // let the workers finish what's queued, then clean up
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        no_more = true;
+    }
+    queued.notify_all();
+    for (auto &worker: workers)
+        worker.join();
+    release(false);
+    delete blocks;
+    Handles *handles = new Handles();
+    for (auto const morsel: morsels) {
+        if (morsel->error && !error)
+            error = morsel->error;
+        if (!morsel->done)  // never queued (only if reading the blocks failed)
+            for (auto const block: morsel->blocks)
+                delete block;
+        handles->insert(handles->end(), morsel->handles.begin(), morsel->handles.end());
+        delete morsel;
+    }
+    if (error) {
+        delete handles;
+        rethrow_exception(error);
+    }
+    return handles;
+}
+
+/**
+ * Start reading the blocks that might have rows satisfying a where clause, in order.
+ * @param where  predicates to match (nullptr for all rows)
+ * @return       the scan (freed by caller): of every block if there is no where clause, else a ZoneScan
+ */
+HeapFile::BlockScan *HeapTable::scan_blocks(const ValueDict *where) {
+    if (where == nullptr || where->empty())
+        return this->file->scan_blocks();
+    return new ZoneScan(*this, where);
+}
+
+HeapTable::ZoneScan::ZoneScan(HeapTable &table, const ValueDict *where)
+        : BlockScan(*table.file), candidates(), last(table.file->get_last_block_id()), blocks(nullptr) {
+    this->candidates = table.zones.might_match(where, this->last);
+    BlockID wanted = (BlockID) count(this->candidates.begin(), this->candidates.end(), true);
+    if (wanted * ZONE_SEEK_FRACTION > this->last)
+        this->blocks = table.file->scan_blocks();
+}
+
+HeapTable::ZoneScan::~ZoneScan() {
+    delete this->blocks;
+}
+
+DbBlock *HeapTable::ZoneScan::next() {
+    if (this->blocks != nullptr) {
+        for (DbBlock *block = this->blocks->next(); block != nullptr; block = this->blocks->next()) {
+            BlockID block_id = block->get_block_id();
+            if (block_id > this->last || this->candidates[block_id - 1])
+                return block;
+            delete block;
+        }
+        return nullptr;
+    }
+    // blocks added since the scan started have no say in candidates
+    while (this->block_id < this->file.get_last_block_id())
+        if (++this->block_id > this->last || this->candidates[this->block_id - 1])
+            return this->file.get(this->block_id);
+    return nullptr;
+}
+
+/**
+ * Work out every block's zone from its rows, starting over.
+ */
+void HeapTable::rezone() {
+    HeapFile &heap_file = *this->file;
+    this->zones.reset(heap_file.get_last_block_id());
+    HeapFile::BlockScan *blocks = heap_file.scan_blocks();
+    for (DbBlock *block = blocks->next(); block != nullptr; block = blocks->next()) {
+        RecordIDs *record_ids = block->ids();
+        for (auto const record_id: *record_ids) {
+            Handle to;
+            if (block->is_marked(record_id) && !forwarded(block, record_id, to))
+                continue;  // a row that moved here is in the zone of its stub's block
+            ValueDict *row = project(block, record_id, &this->column_names);
+            this->zones.add(block->get_block_id(), *row);
+            delete row;
+        }
+        delete record_ids;
+        delete block;
+    }
+    delete blocks;
+    this->zones.flush();
+}
+
+bool HeapTable::FilterIterator::next(Handle &handle) {
+    while (this->source->next(handle))
+        if (this->table.selected(handle, this->predicate))
+            return true;
+    return false;
+}
+
 /**
  * Project all columns from a given row.
  * @param handle row to be projected
@@ -163,23 +917,117 @@ ValueDict *HeapTable::project(Handle handle) {
  * @return a sequence of values for handle given by column_names
  */
 ValueDict *HeapTable::project(Handle handle, const ColumnNames *column_names) {
-    BlockID block_id = handle.first;
-    RecordID record_id = handle.second;
-    SlottedPage *block = file.get(block_id);
-    Dbt *data = block->get(record_id);
-    ValueDict *row = unmarshal(data);
-    delete data;
+    check_columns(column_names);
+    DbBlock *block = file->get(handle.first);
+    ValueDict *row;
+    try {
+        row = project(block, handle.second, column_names);
+    } catch (...) {
+        delete block;
+        throw;
+    }
     delete block;
-    if (column_names->empty())
+    return row;
+}
+
+/**
+ * Project all the columns of each of a list of rows.
+ * @param handles  rows to be projected
+ * @return         the rows, in the same order as handles (freed by caller, along with each row)
+ */
+ValueDicts *HeapTable::project(Handles *handles) {
+    return project(handles, &this->column_names);
+}
+
+/**
+ * Project given columns from each of a list of rows. The rows are gone through in block order, so each block
+ * is got just once however many of the rows are in it, but are returned in the order they were asked for.
+ * @param handles       rows to be projected
+ * @param column_names  columns to be included in the result
+ * @return              the rows, in the same order as handles (freed by caller, along with each row)
+ */
+ValueDicts *HeapTable::project(Handles *handles, const ColumnNames *column_names) {
+    check_columns(column_names);
+    vector<pair<Handle, size_t>> order;  // each handle and where its row goes
+    order.reserve(handles->size());
+    for (size_t i = 0; i < handles->size(); i++)
+        order.push_back(make_pair((*handles)[i], i));
+    if (!is_sorted(handles->begin(), handles->end()))
+        sort(order.begin(), order.end());
+
+    ValueDicts *rows = new ValueDicts(handles->size(), nullptr);
+    DbBlock *block = nullptr;
+    try {
+        for (auto const &one: order) {
+            if (block == nullptr || block->get_block_id() != one.first.first) {
+                delete block;
+                block = nullptr;
+                block = file->get(one.first.first);
+            }
+            (*rows)[one.second] = project(block, one.first.second, column_names);
+        }
+    } catch (...) {
+        delete block;
+        for (auto const &row: *rows)
+            delete row;
+        delete rows;
+        throw;
+    }
+    delete block;
+    return rows;
+}
+
+/**
+ * Project the columns of a where clause from each of a list of rows (see project(Handles*, ColumnNames*)).
+ * @param handles  rows to be projected
+ * @param where    columns to be included in the result (just the names are used)
+ * @return         the rows, in the same order as handles (freed by caller, along with each row)
+ */
+ValueDicts *HeapTable::project(Handles *handles, const ValueDict *where) {
+    ColumnNames t;
+    for (auto const &column: *where)
+        t.push_back(column.first);
+    return project(handles, &t);
+}
+
+/**
+ * Project given columns from a row of a block already got.
+ * @param block         block the row is in
+ * @param record_id     row within the block
+ * @param column_names  columns to be included in the result (all of them if empty)
+ * @return              the row (freed by caller)
+ */
+ValueDict *HeapTable::project(const DbBlock *block, RecordID record_id, const ColumnNames *column_names) {
+    const PaxPage *pax_block = dynamic_cast<const PaxPage *>(block);
+    if (pax_block != nullptr && !column_names->empty())
+        return unmarshal(pax_block, record_id, column_names);  // just look at the mini-pages for the columns we want
+    Handle moved;
+    if (forwarded(block, record_id, moved)) {
+        DbBlock *moved_block = this->file->get(moved.first);
+        ValueDict *row;
+        try {
+            row = project(moved_block, moved.second, column_names);
+        } catch (...) {
+            delete moved_block;
+            throw;
+        }
+        delete moved_block;
         return row;
-    ValueDict *result = new ValueDict();
-    for (auto const &column_name: *column_names) {
-        if (row->find(column_name) == row->end())
-            throw DbRelationError("table does not have column named '" + column_name + "'");
-        (*result)[column_name] = (*row)[column_name];
     }
-    delete row;
-    return result;
+    u16 size;
+    const char *bytes = row_view(block, record_id, size);
+    return unmarshal(bytes, column_names);
+}
+
+/**
+ * Make sure the table has each of the given columns.
+ * @param column_names  columns to check
+ * @throws DbRelationError if one of them isn't one of the table's
+ */
+void HeapTable::check_columns(const ColumnNames *column_names) const {
+    for (auto const &column_name: *column_names)
+        if (this->codec.column_number(column_name) < 0)
+            throw DbRelationError("table does not have column named '" + column_name + "'");
 }
 
 /**
@@ -209,21 +1057,45 @@ ValueDict *HeapTable::validate(const ValueDict *row) const {
  */
 Handle HeapTable::append(const ValueDict *row) {
     Dbt *data = marshal(row);
-    SlottedPage *block = this->file.get(this->file.get_last_block_id());
+    Handle handle;
+    try {
+        handle = append(*this->file, data);
+    } catch (...) {
+        toast_del_row((const char *) data->get_data(), (uint) this->column_names.size());
+        delete[] (char *) data->get_data();
+        delete data;
+        throw;
+    }
+    delete[] (char *) data->get_data();
+    delete data;
+    return handle;
+}
+
+/**
+ * Appends a record to the given file (ours or our TOAST file).
+ * @param heap_file  file to append to
+ * @param data       the record
+ * @return handle of newly inserted record
+ */
+Handle HeapTable::append(HeapFile &heap_file, const Dbt *data) {
+    // prefer a block the free-space map says has room (maybe freed by deletes), then the last block
+    BlockID block_id = heap_file.find_free_block(data->get_size());
+    if (block_id == 0)
+        block_id = heap_file.get_last_block_id();
+    DbBlock *block = heap_file.get(block_id);
     RecordID record_id;
     try {
         record_id = block->add(data);
     } catch (DbBlockNoRoomError &e) {
         // need a new block
         delete block;
-        block = this->file.get_new();
+        block = heap_file.get_new();
         record_id = block->add(data);
     }
-    this->file.put(block);
+    heap_file.put(block);
+    block_id = block->get_block_id();
     delete block;
-    delete[] (char *) data->get_data();
-    delete data;
-    return Handle(this->file.get_last_block_id(), record_id);
+    return Handle(block_id, record_id);
 }
 
 /**
@@ -232,39 +1104,9 @@ Handle HeapTable::append(const ValueDict *row) {
  * @param row data for the tuple
  * @return bits of the record as it should appear on disk
  */
-Dbt *HeapTable::marshal(const ValueDict *row) const {
-    char *bytes = new char[DbBlock::BLOCK_SZ]; // more than we need (we insist that one row fits into DbBlock::BLOCK_SZ)
-    uint offset = 0;
-    uint col_num = 0;
-    for (auto const &column_name: this->column_names) {
-        ColumnAttribute ca = this->column_attributes[col_num++];
-        ValueDict::const_iterator column = row->find(column_name);
-        Value value = column->second;
-
-        if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
-            if (offset + 4 > DbBlock::BLOCK_SZ - 4)
-                throw DbRelationError("row too big to marshal");
-            *(int32_t *) (bytes + offset) = value.n;
-            offset += sizeof(int32_t);
-        } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
-            u_long size = value.s.length();
-            if (size > UINT16_MAX)
-                throw DbRelationError("text field too long to marshal");
-            if (offset + 2 + size > DbBlock::BLOCK_SZ)
-                throw DbRelationError("row too big to marshal");
-            *(u16 *) (bytes + offset) = size;
-            offset += sizeof(u16);
-            memcpy(bytes + offset, value.s.c_str(), size); // assume ascii for now
-            offset += size;
-        } else if (ca.get_data_type() == ColumnAttribute::DataType::BOOLEAN) {
-            if (offset + 1 > DbBlock::BLOCK_SZ - 1)
-                throw DbRelationError("row too big to marshal");
-            *(uint8_t *) (bytes + offset) = (uint8_t) value.n;
-            offset += sizeof(uint8_t);
-        } else {
-            throw DbRelationError("Only know how to marshal INT, TEXT, and BOOLEAN");
-        }
-    }
+Dbt *HeapTable::marshal(const ValueDict *row) {
+    char *bytes = new char[this->file->get_block_size()]; // more than we need (we insist that one row fits into a block)
+    uint offset = marshal(row, bytes);
     char *right_size_bytes = new char[offset];
     memcpy(right_size_bytes, bytes, offset);
     delete[] bytes;
@@ -272,42 +1114,357 @@ Dbt *HeapTable::marshal(const ValueDict *row) const {
     return data;
 }
 
+/**
+ * Figure out the bits to go into the file, putting them into the given buffer.
+ * @param row    data for the tuple
+ * @param bytes  where to put the record (a block's worth)
+ * @return size of the record
+ * @throws DbRelationError if the row is missing a column or is too big
+ */
+uint HeapTable::marshal(const ValueDict *row, char *bytes) {
+    return this->codec.encode(row, bytes);
+}
+
 /**
  * Figure out the memory data structures from the given bits gotten from the file.
- * @param data file data for the tuple
+ * Only the requested columns are decoded (and only their out-of-line TEXT is fetched).
+ * @param bytes         file data for the tuple (e.g., as viewed in its block)
+ * @param column_names  columns to include, or nullptr or empty for all of them
  * @return row data for the tuple
  */
-ValueDict *HeapTable::unmarshal(Dbt *data) const {
+ValueDict *HeapTable::unmarshal(const char *bytes, const ColumnNames *column_names) {
+    return this->codec.decode(bytes, column_names);
+}
+
+/**
+ * Pull the given columns of a record out of a PAX block, leaving the other columns alone.
+ * @param block         block the record is in
+ * @param record_id     record within the block
+ * @param column_names  columns to get
+ * @return row data for the requested columns
+ */
+ValueDict *HeapTable::unmarshal(const PaxPage *block, RecordID record_id, const ColumnNames *column_names) {
     ValueDict *row = new ValueDict();
-    Value value;
-    char *bytes = (char *) data->get_data();
-    uint offset = 0;
-    uint col_num = 0;
-    for (auto const &column_name: this->column_names) {
-        ColumnAttribute ca = this->column_attributes[col_num++];
-        value.data_type = ca.get_data_type();
-        if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
-            value.n = *(int32_t *) (bytes + offset);
-            offset += sizeof(int32_t);
-        } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
-            u16 size = *(u16 *) (bytes + offset);
-            offset += sizeof(u16);
-            char buffer[DbBlock::BLOCK_SZ];
-            memcpy(buffer, bytes + offset, size);
-            buffer[size] = '\0';
-            value.s = string(buffer);  // assume ascii for now
-            offset += size;
-        } else if (ca.get_data_type() == ColumnAttribute::DataType::BOOLEAN) {
-            value.n = *(uint8_t *) (bytes + offset);
-            offset += sizeof(uint8_t);
+    for (auto const &column_name: *column_names) {
+        int col_num = this->codec.column_number(column_name);
+        if (col_num < 0) {
+            delete row;
+            throw DbRelationError("table does not have column named '" + column_name + "'");
+        }
+        u16 size;
+        const char *bytes = block->view_column(record_id, (uint) col_num, size);
+        this->codec.decode_value((uint) col_num, bytes, size, (*row)[column_name]);
+    }
+    return row;
+}
+
+/**
+ * Constructor
+ * Works out each column's functions and its place in the row.
+ * @param table  table whose rows these are (for its columns, block size, and TOAST file)
+ */
+HeapTable::RowCodec::RowCodec(HeapTable &table) : table(table), columns(), by_name(), text_start(0), values() {
+    const ColumnNames &column_names = table.column_names;
+    uint fixed_size = 0, texts = 0;
+    for (uint col_num = 0; col_num < column_names.size(); col_num++) {
+        Column column;
+        column.name = column_names[col_num];
+        column.data_type = col_num < table.column_attributes.size() ? table.column_attributes[col_num].get_data_type()
+                                                                    : ColumnAttribute::INT;
+        column.start = 0;
+        if (column.data_type == ColumnAttribute::DataType::INT) {
+            column.offset = fixed_size;
+            fixed_size += sizeof(int32_t);
+            column.encode = encode_int;
+            column.decode = decode_int;
+        } else if (column.data_type == ColumnAttribute::DataType::TEXT) {
+            column.offset = texts++;  // just its place in the directory for now
+            column.encode = encode_text;
+            column.decode = decode_text;
+        } else if (column.data_type == ColumnAttribute::DataType::BOOLEAN) {
+            column.offset = fixed_size;
+            fixed_size += sizeof(uint8_t);
+            column.encode = encode_boolean;
+            column.decode = decode_boolean;
         } else {
-            throw DbRelationError("Only know how to unmarshal INT, TEXT, and BOOLEAN");
+            throw DbRelationError("Only know how to marshal INT, TEXT, and BOOLEAN");
+        }
+        this->columns.push_back(column);
+        this->by_name.push_back(col_num);
+    }
+
+    // the directory of TEXT end offsets comes after the fixed-width columns, then the text
+    this->text_start = fixed_size + texts * (uint) sizeof(u16);
+    for (auto &column: this->columns)
+        if (column.data_type == ColumnAttribute::DataType::TEXT) {
+            if (column.offset == 0)
+                column.start = this->text_start;
+            column.offset = fixed_size + column.offset * (uint) sizeof(u16);
+        }
+    sort(this->by_name.begin(), this->by_name.end(), [this](uint a, uint b) {
+        return this->columns[a].name < this->columns[b].name;
+    });
+    this->values.resize(this->columns.size());
+}
+
+uint HeapTable::RowCodec::encode(const ValueDict *row, char *bytes) const {
+    // the row's values are in name order, so a walk through them finds each column in turn
+    ValueDict::const_iterator it = row->begin();
+    for (auto const col_num: this->by_name) {
+        const Identifier &name = this->columns[col_num].name;
+        while (it != row->end() && it->first < name)
+            it++;
+        if (it == row->end() || it->first != name)
+            throw DbRelationError("don't know how to handle NULLs, defaults, etc. yet");
+        this->values[col_num] = &it->second;
+    }
+    const uint block_size = this->table.file->get_block_size();
+    uint end = this->text_start;
+    if (end >= block_size)
+        throw DbRelationError("row too big to marshal");
+    uint col_num = 0;
+    try {
+        for (; col_num < this->columns.size(); col_num++) {
+            const Column &column = this->columns[col_num];
+            column.encode(this->table, column, *this->values[col_num], bytes, end, block_size);
         }
-        (*row)[column_name] = value;
+    } catch (...) {
+        this->table.toast_del_row(bytes, col_num);  // the values already TOASTed aren't any row's
+        throw;
+    }
+    return end;
+}
+
+ValueDict *HeapTable::RowCodec::decode(const char *bytes, const ColumnNames *column_names) const {
+    ValueDict *row = new ValueDict();
+    if (column_names == nullptr || column_names->empty()) {
+        for (auto const &column: this->columns)
+            column.decode(this->table, column, bytes, (*row)[column.name]);
+        return row;
+    }
+    for (auto const &column_name: *column_names) {
+        int col_num = column_number(column_name);
+        if (col_num < 0) {
+            delete row;
+            throw DbRelationError("table does not have column named '" + column_name + "'");
+        }
+        const Column &column = this->columns[col_num];
+        column.decode(this->table, column, bytes, (*row)[column_name]);
     }
     return row;
 }
 
+void HeapTable::RowCodec::decode_column(const char *bytes, uint col_num, Value &value) const {
+    const Column &column = this->columns[col_num];
+    column.decode(this->table, column, bytes, value);
+}
+
+void HeapTable::RowCodec::decode_value(uint col_num, const char *bytes, u16 size, Value &value) const {
+    value.data_type = this->columns[col_num].data_type;
+    if (value.data_type == ColumnAttribute::DataType::INT)
+        value.n = *(int32_t *) bytes;
+    else if (value.data_type == ColumnAttribute::DataType::TEXT && size == TOASTED)
+        value.s = this->table.detoast(bytes);
+    else if (value.data_type == ColumnAttribute::DataType::TEXT)
+        value.s.assign(bytes, size);  // assume ascii for now
+    else
+        value.n = *(uint8_t *) bytes;
+}
+
+const char *HeapTable::RowCodec::toast_pointer(const char *bytes, uint col_num) const {
+    const Column &column = this->columns[col_num];
+    if (column.data_type != ColumnAttribute::DataType::TEXT || (*(u16 *) (bytes + column.offset) & TOASTED_END) == 0)
+        return nullptr;
+    return bytes + text_begin(column, bytes);
+}
+
+int HeapTable::RowCodec::column_number(const Identifier &column_name) const {
+    auto it = lower_bound(this->by_name.begin(), this->by_name.end(), column_name,
+                          [this](uint col_num, const Identifier &name) {
+                              return this->columns[col_num].name < name;
+                          });
+    if (it == this->by_name.end() || this->columns[*it].name != column_name)
+        return -1;
+    return (int) *it;
+}
+
+/**
+ * Where a TEXT value starts in a row: right after the directory for the first TEXT column, else where the one
+ * before it ends.
+ * @param column  a TEXT column
+ * @param bytes   the row
+ * @return        offset in the row
+ */
+uint HeapTable::RowCodec::text_begin(const Column &column, const char *bytes) {
+    if (column.start != 0)
+        return column.start;
+    return *(u16 *) (bytes + column.offset - sizeof(u16)) & ~TOASTED_END;
+}
+
+void HeapTable::RowCodec::encode_int(HeapTable &table, const Column &column, const Value &value, char *bytes,
+                                     uint &end, uint block_size) {
+    *(int32_t *) (bytes + column.offset) = value.n;
+}
+
+void HeapTable::RowCodec::encode_text(HeapTable &table, const Column &column, const Value &value, char *bytes,
+                                      uint &end, uint block_size) {
+    u_long size = value.s.length();
+    u16 toasted = 0;
+    if (size > block_size / 4) {
+        if (end + TOAST_POINTER_SZ >= block_size)
+            throw DbRelationError("row too big to marshal");
+        table.toast_value(value.s, bytes + end);
+        end += TOAST_POINTER_SZ;
+        toasted = TOASTED_END;
+    } else {
+        if (end + size >= block_size)
+            throw DbRelationError("row too big to marshal");
+        memcpy(bytes + end, value.s.data(), size); // assume ascii for now
+        end += (uint) size;
+    }
+    *(u16 *) (bytes + column.offset) = (u16) (end | toasted);
+}
+
+void HeapTable::RowCodec::encode_boolean(HeapTable &table, const Column &column, const Value &value, char *bytes,
+                                         uint &end, uint block_size) {
+    *(uint8_t *) (bytes + column.offset) = (uint8_t) value.n;
+}
+
+void HeapTable::RowCodec::decode_int(HeapTable &table, const Column &column, const char *bytes, Value &value) {
+    value.data_type = ColumnAttribute::DataType::INT;
+    value.n = *(int32_t *) (bytes + column.offset);
+}
+
+void HeapTable::RowCodec::decode_text(HeapTable &table, const Column &column, const char *bytes, Value &value) {
+    u16 end = *(u16 *) (bytes + column.offset);
+    uint begin = text_begin(column, bytes);
+    value.data_type = ColumnAttribute::DataType::TEXT;
+    if (end & TOASTED_END)
+        value.s = table.detoast(bytes + begin);
+    else
+        value.s.assign(bytes + begin, end - begin);  // assume ascii for now
+}
+
+void HeapTable::RowCodec::decode_boolean(HeapTable &table, const Column &column, const char *bytes, Value &value) {
+    value.data_type = ColumnAttribute::DataType::BOOLEAN;
+    value.n = *(uint8_t *) (bytes + column.offset);
+}
+
+/**
+ * Open the TOAST file.
+ * @param create  true to create it if it isn't there yet
+ */
+void HeapTable::toast_open(bool create) {
+    try {
+        this->toast.open();
+    } catch (DbException &e) {
+        if (!create)
+            throw;
+        this->toast.create();
+    }
+}
+
+/**
+ * Store a TEXT value in the TOAST file, as a chain of chunks, each a record of:
+ * 4-byte block id and 2-byte record id of the next chunk (block id 0 for none), then the text.
+ * @param text     the value
+ * @param pointer  where to put the TOAST_POINTER_SZ pointer to it
+ */
+void HeapTable::toast_value(const string &text, char *pointer) {
+    toast_open(true);
+    const uint chunk_size = this->toast.get_block_size() - 32;  // fits in an empty block, with room to spare
+    const uint length = (uint) text.length();
+    char *chunk = new char[6 + chunk_size];
+    Handle next(0, 0);
+    // write the chunks from last to first, so each one knows where the next one is
+    for (uint n = (length + chunk_size - 1) / chunk_size; n-- > 0;) {
+        uint size = length - n * chunk_size < chunk_size ? length - n * chunk_size : chunk_size;
+        *(uint32_t *) chunk = next.first;
+        *(u16 *) (chunk + 4) = next.second;
+        memcpy(chunk + 6, text.data() + n * chunk_size, size);
+        Dbt data(chunk, 6 + size);
+        try {
+            next = append(this->toast, &data);
+        } catch (...) {
+            delete[] chunk;
+            char written[TOAST_POINTER_SZ];  // the chunks after this one
+            *(uint32_t *) (written + 4) = next.first;
+            *(u16 *) (written + 8) = next.second;
+            toast_del(written);
+            throw;
+        }
+    }
+    delete[] chunk;
+    *(uint32_t *) pointer = length;
+    *(uint32_t *) (pointer + 4) = next.first;
+    *(u16 *) (pointer + 8) = next.second;
+}
+
+/**
+ * Fetch a TEXT value from the TOAST file.
+ * @param pointer  TOAST_POINTER_SZ pointer from a row
+ * @return the value
+ */
+string HeapTable::detoast(const char *pointer) {
+    toast_open(false);
+    uint length = *(uint32_t *) pointer;
+    BlockID block_id = *(uint32_t *) (pointer + 4);
+    RecordID record_id = *(u16 *) (pointer + 8);
+    string text;
+    text.reserve(length);
+    while (block_id != 0) {
+        DbBlock *block = this->toast.get(block_id);
+        u16 size;
+        const char *chunk = block->view(record_id, size);
+        if (chunk == nullptr) {
+            delete block;
+            throw DbRelationError("TOAST chunk is missing");
+        }
+        block_id = *(uint32_t *) chunk;
+        record_id = *(u16 *) (chunk + 4);
+        text.append(chunk + 6, size - 6U);
+        delete block;
+    }
+    if (text.length() != length)
+        throw DbRelationError("TOAST value is the wrong length");
+    return text;
+}
+
+/**
+ * Remove a TEXT value from the TOAST file.
+ * @param pointer  TOAST_POINTER_SZ pointer from a row
+ */
+void HeapTable::toast_del(const char *pointer) {
+    toast_open(false);
+    BlockID block_id = *(uint32_t *) (pointer + 4);
+    RecordID record_id = *(u16 *) (pointer + 8);
+    while (block_id != 0) {
+        DbBlock *block = this->toast.get(block_id);
+        u16 size;
+        const char *chunk = block->view(record_id, size);
+        BlockID next_block_id = chunk == nullptr ? 0 : *(uint32_t *) chunk;
+        RecordID next_record_id = chunk == nullptr ? 0 : *(u16 *) (chunk + 4);
+        block->del(record_id);
+        this->toast.put(block);
+        delete block;
+        block_id = next_block_id;
+        record_id = next_record_id;
+    }
+}
+
+/**
+ * Remove the out-of-line TEXT values of a row from the TOAST file.
+ * @param bytes    the row
+ * @param columns  how many of its columns (from the first) to look at (the ones that have been encoded)
+ */
+void HeapTable::toast_del_row(const char *bytes, uint columns) {
+    for (uint col_num = 0; col_num < columns; col_num++) {
+        const char *pointer = this->codec.toast_pointer(bytes, col_num);
+        if (pointer != nullptr)
+            toast_del(pointer);
+    }
+}
+
 /**
  * See if the row at the given handle satisfies the given where clause
  * @param handle  row to check
@@ -317,12 +1474,142 @@ ValueDict *HeapTable::unmarshal(Dbt *data) const {
 bool HeapTable::selected(Handle handle, const ValueDict *where) {
     if (where == nullptr)
         return true;
-    ValueDict *row = this->project(handle, where);
-    bool is_selected = *row == *where;
-    delete row;
+    return selected(handle, RowCodec::Predicate(this->codec, where));
+}
+
+/**
+ * See if the row at the given handle satisfies the given where clause, already worked out for our rows
+ * @param handle     row to check
+ * @param predicate  conditions to check
+ * @return           true if conditions met, false otherwise
+ */
+bool HeapTable::selected(Handle handle, const RowCodec::Predicate &predicate) {
+    DbBlock *block = this->file->get(handle.first);
+    Handle moved;
+    if (forwarded(block, handle.second, moved)) {
+        delete block;
+        block = this->file->get(moved.first);
+        handle = moved;
+    }
+    bool is_selected = predicate.matches(block, handle.second);
+    delete block;
     return is_selected;
 }
 
+HeapTable::RowCodec::Predicate::Predicate(const RowCodec &codec, const ValueDict *where, recursive_mutex *latch)
+        : codec(codec), terms(), never(false), latch(latch) {
+    if (where == nullptr)
+        return;
+    for (auto const &column: *where) {
+        int col_num = codec.column_number(column.first);
+        if (col_num < 0)
+            throw DbRelationError("table does not have column named '" + column.first + "'");
+        if (column.second.data_type != codec.columns[col_num].data_type)
+            this->never = true;
+        Term term;
+        term.col_num = (uint) col_num;
+        term.value = &column.second;
+        this->terms.push_back(term);
+    }
+    // the fixed-width columns are quickest to check, so they go first
+    stable_sort(this->terms.begin(), this->terms.end(), [&codec](const Term &a, const Term &b) {
+        return codec.columns[a.col_num].data_type != ColumnAttribute::DataType::TEXT
+               && codec.columns[b.col_num].data_type == ColumnAttribute::DataType::TEXT;
+    });
+}
+
+bool HeapTable::RowCodec::Predicate::matches(const char *bytes) const {
+    if (bytes == nullptr || this->never)
+        return false;
+    for (auto const &term: this->terms) {
+        const Column &column = this->codec.columns[term.col_num];
+        const char *at = bytes + column.offset;
+        if (column.data_type == ColumnAttribute::DataType::INT) {
+            if (*(int32_t *) at != term.value->n)
+                return false;
+        } else if (column.data_type == ColumnAttribute::DataType::BOOLEAN) {
+            if (*(uint8_t *) at != term.value->n)
+                return false;
+        } else {
+            u16 end = *(u16 *) at;
+            uint begin = text_begin(column, bytes);
+            const string &text = term.value->s;
+            if (end & TOASTED_END) {
+                if (!toasted_equals(bytes + begin, text))
+                    return false;
+            } else if (end - begin != text.size() || memcmp(bytes + begin, text.data(), text.size()) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool HeapTable::RowCodec::Predicate::matches(const PaxPage *block, RecordID record_id) const {
+    if (this->never)
+        return false;
+    if (this->terms.empty()) {
+        u16 size;
+        return block->view_column(record_id, 0, size) != nullptr;
+    }
+    for (auto const &term: this->terms) {
+        u16 size;
+        const char *at = block->view_column(record_id, term.col_num, size);
+        if (at == nullptr)
+            return false;  // deleted
+        ColumnAttribute::DataType data_type = this->codec.columns[term.col_num].data_type;
+        if (data_type == ColumnAttribute::DataType::INT) {
+            if (*(int32_t *) at != term.value->n)
+                return false;
+        } else if (data_type == ColumnAttribute::DataType::BOOLEAN) {
+            if (*(uint8_t *) at != term.value->n)
+                return false;
+        } else {
+            const string &text = term.value->s;
+            if (size == TOASTED) {
+                if (!toasted_equals(at, text))
+                    return false;
+            } else if (size != text.size() || memcmp(at, text.data(), size) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool HeapTable::RowCodec::Predicate::matches(const DbBlock *block, RecordID record_id) const {
+    const PaxPage *pax_block = dynamic_cast<const PaxPage *>(block);
+    if (pax_block != nullptr)
+        return matches(pax_block, record_id);
+    u16 size;
+    return matches(row_view(block, record_id, size));
+}
+
+/**
+ * Check a TOASTed value, only fetching it if it is the right length.
+ * @param pointer  TOAST_POINTER_SZ pointer from a row
+ * @param text     value to compare to
+ * @return         true if the same
+ */
+bool HeapTable::RowCodec::Predicate::toasted_equals(const char *pointer, const string &text) const {
+    if (*(uint32_t *) pointer != text.size())
+        return false;
+    if (this->latch == nullptr)
+        return this->codec.table.detoast(pointer) == text;
+    lock_guard<recursive_mutex> latched(*this->latch);
+    return this->codec.table.detoast(pointer) == text;
+}
+
+void HeapTable::RowCodec::Predicate::filter(const DbBlock *block, RecordIDs &record_ids) const {
+    const PaxPage *pax_block = dynamic_cast<const PaxPage *>(block);
+    u16 size;
+    auto kept = record_ids.begin();
+    for (auto const record_id: record_ids)
+        if (pax_block != nullptr ? matches(pax_block, record_id) : matches(block->view(record_id, size)))
+            *kept++ = record_id;
+    record_ids.erase(kept, record_ids.end());
+}
+
 /**
  * Test helper. Sets the row's a and b values.
  * @param row to set
@@ -335,6 +1622,66 @@ void test_set_row(ValueDict &row, int a, string b) {
     row["c"] = Value(a % 2 == 0);  // true for even, false for odd
 }
 
+/**
+ * Test helper. Makes a different TEXT value for each i that doesn't compress (three of them fill an 8K block).
+ * @param i   which one
+ * @return    the value
+ */
+string test_noise(int i) {
+    string noise;
+    uint32_t seed = (uint32_t) i;
+    for (int j = 0; j < 2715; j++) {
+        seed = seed * 1103515245U + 12345U;
+        noise += (char) ('!' + (seed >> 16U) % 90);
+    }
+    return noise;
+}
+
+/**
+ * Test helper. A heap file that lets the test move blocks around the free-space map and count its stacks.
+ */
+class TestFreeSpaceFile : public HeapFile {
+public:
+    explicit TestFreeSpaceFile(string name) : HeapFile(name) {}
+
+    void note(BlockID block_id, uint unused_bytes) { note_free_space(block_id, unused_bytes); }
+
+    size_t stacked() const {
+        size_t n = 0;
+        for (auto const &blocks: this->free_blocks)
+            n += blocks.size();
+        return n;
+    }
+};
+
+/**
+ * Test helper. A table that lets the test count the chunks in its TOAST file.
+ */
+class TestToastTable : public HeapTable {
+public:
+    TestToastTable(Identifier table_name, const ColumnNames &column_names, const ColumnAttributes &column_attributes,
+                   uint block_size = DbBlock::BLOCK_SZ)
+            : HeapTable(table_name, column_names, column_attributes, block_size) {}
+
+    size_t toasted() {
+        try {
+            toast_open(false);
+        } catch (DbException &e) {
+            return 0;  // nothing has gone out of line yet
+        }
+        size_t n = 0;
+        HeapFile::BlockScan *blocks = this->toast.scan_blocks();
+        for (DbBlock *block = blocks->next(); block != nullptr; block = blocks->next()) {
+            RecordIDs *record_ids = block->ids();
+            n += record_ids->size();
+            delete record_ids;
+            delete block;
+        }
+        delete blocks;
+        return n;
+    }
+};
+
 /**
  * Test helper. Compares row to expected values for columns a and b.
  * @param table    relation where row is
@@ -371,6 +1718,24 @@ bool test_heap_storage() {
     if (!test_slotted_page())
         return assertion_failure("slotted page tests failed");
     cout << endl << "slotted page tests ok" << endl;
+    if (!test_pax_page())
+        return assertion_failure("PAX page tests failed");
+    cout << "PAX page tests ok" << endl;
+    if (!test_lz_codec())
+        return assertion_failure("LZ codec tests failed");
+    cout << "LZ codec tests ok" << endl;
+    if (!test_buffer_pool())
+        return assertion_failure("buffer pool tests failed");
+    cout << "buffer pool tests ok" << endl;
+    if (!test_mmap_heap_file())
+        return assertion_failure("mmap heap file tests failed");
+    cout << "mmap heap file tests ok" << endl;
+    if (!test_uring_heap_file())
+        return assertion_failure("uring heap file tests failed");
+    cout << "uring heap file tests ok" << endl;
+    if (!test_zone_map())
+        return assertion_failure("zone map tests failed");
+    cout << "zone map tests ok" << endl;
 
     ColumnNames column_names;
     column_names.push_back("a");
@@ -433,5 +1798,976 @@ bool test_heap_storage() {
     cout << "del ok" << endl;
     table.drop();
     delete handles;
+
+    // larger blocks: the block size is chosen at create and remembered by the file
+    {
+        TestToastTable big_table("_test_big_blocks_cpp", column_names, column_attributes, 32768);
+        big_table.create();
+        string big_b(8000, 'x');  // too big for a 4k block, but not big enough to go out of line in a 32k one
+        test_set_row(row, 7, big_b);
+        big_table.insert(&row);
+        test_set_row(row, 8, b);
+        big_table.insert(&row);
+        if (big_table.toasted() != 0)
+            return assertion_failure("32k block row out of line", big_table.toasted());
+        string toast_b(20000, 'x');  // this one does go out of line
+        test_set_row(row, 9, toast_b);
+        big_table.insert(&row);
+        if (big_table.toasted() != 1)
+            return assertion_failure("32k block TOAST chunks", big_table.toasted());
+        big_table.close();
+        HeapTable reopened("_test_big_blocks_cpp", column_names, column_attributes);  // default size ignored
+        reopened.open();
+        handles = reopened.select();
+        if (handles->size() != 3 || !test_compare(reopened, (*handles)[0], 7, big_b) ||
+            !test_compare(reopened, (*handles)[1], 8, b) || !test_compare(reopened, (*handles)[2], 9, toast_b))
+            return assertion_failure("32k block table");
+        delete handles;
+        reopened.drop();
+    }
+    try {
+        HeapTable bad_table("_test_bad_blocks_cpp", column_names, column_attributes, 5000);
+        return assertion_failure("block size not a power of two was accepted");
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    cout << "block size ok" << endl;
+
+    // PAX layout: same rows, split up by column
+    {
+        HeapTable pax_table("_test_pax_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ, HeapFile::PAX);
+        pax_table.create();
+        for (int i = 0; i < 1000; i++) {
+            test_set_row(row, i, b);
+            last_handle = pax_table.insert(&row);
+        }
+        pax_table.del(last_handle);
+        pax_table.close();
+        HeapTable reopened("_test_pax_cpp", column_names, column_attributes);  // layout comes from the file
+        reopened.open();
+        handles = reopened.select();
+        if (handles->size() != 999)
+            return assertion_failure("PAX select", handles->size());
+        i = 0;
+        for (auto const &handle: *handles)
+            if (!test_compare(reopened, handle, i++, b))
+                return assertion_failure("PAX project", i);
+        delete handles;
+        ValueDict where;
+        where["a"] = Value(12);
+        handles = reopened.select(&where);
+        if (handles->size() != 1 || !test_compare(reopened, (*handles)[0], 12, b))
+            return assertion_failure("PAX select where");
+        ColumnNames just_b;
+        just_b.push_back("b");
+        ValueDict *result = reopened.project((*handles)[0], &just_b);
+        if (result->size() != 1 || (*result)["b"].s != b)
+            return assertion_failure("PAX project one column");
+        delete result;
+        delete handles;
+        reopened.drop();
+    }
+    cout << "PAX layout ok" << endl;
+
+    // compressed blocks, mixed with blocks that don't compress
+    {
+        HeapTable compressed_table("_test_compressed_cpp", column_names, column_attributes, 8192,
+                                   HeapFile::SLOTTED_PAGE, true);
+        compressed_table.create();
+        for (int i = 0; i < 500; i++) {
+            test_set_row(row, i, (i >= 200 && i < 210) ? test_noise(i) : b);
+            compressed_table.insert(&row);
+        }
+        compressed_table.close();
+        HeapTable reopened("_test_compressed_cpp", column_names, column_attributes);  // settings from the file
+        reopened.open();
+        handles = reopened.select();
+        if (handles->size() != 500)
+            return assertion_failure("compressed select", handles->size());
+        i = 0;
+        for (auto const &handle: *handles) {
+            if (!test_compare(reopened, handle, i, (i >= 200 && i < 210) ? test_noise(i) : b))
+                return assertion_failure("compressed project", i);
+            i++;
+        }
+        delete handles;
+        reopened.drop();
+    }
+    cout << "compressed blocks ok" << endl;
+
+    // big TEXT values go out of line (even ones too big for a block, or for a 16-bit size)
+    for (int pax = 0; pax <= 1; pax++) {
+        HeapTable toast_table("_test_toast_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                              pax ? HeapFile::PAX : HeapFile::SLOTTED_PAGE);
+        toast_table.create();
+        string big(70000, 'x');
+        for (uint j = 0; j < big.size(); j += 100)
+            big[j] = (char) ('a' + j % 26);
+        Handles inserted;
+        for (int i = 0; i < 30; i++) {
+            test_set_row(row, i, i % 3 == 0 ? big.substr(0, 1000 + 2500 * i) : b);
+            inserted.push_back(toast_table.insert(&row));
+        }
+        i = 0;
+        for (auto const &handle: inserted) {
+            if (!test_compare(toast_table, handle, i, i % 3 == 0 ? big.substr(0, 1000 + 2500 * i) : b))
+                return assertion_failure("TOAST project", i);
+            i++;
+        }
+        ColumnNames just_a;
+        just_a.push_back("a");
+        ValueDict *result = toast_table.project(inserted[27], &just_a);
+        if (result->size() != 1 || (*result)["a"].n != 27)
+            return assertion_failure("TOAST project other column");
+        delete result;
+        toast_table.del(inserted[27]);
+        toast_table.del(inserted[3]);
+        test_set_row(row, 99, big);
+        Handle handle = toast_table.insert(&row);
+        if (!test_compare(toast_table, handle, 99, big) || !test_compare(toast_table, inserted[24], 24,
+                                                                          big.substr(0, 1000 + 2500 * 24)))
+            return assertion_failure("TOAST after del");
+        toast_table.drop();
+    }
+    {
+        // a row that turns out too big leaves nothing in the TOAST file, whether inserted or updated
+        ColumnNames text_names;
+        ColumnAttributes text_attributes(5, ColumnAttribute(ColumnAttribute::TEXT));
+        for (char name = 'p'; name < 'u'; name++)
+            text_names.push_back(string(1, name));
+        TestToastTable toast_table("_test_toast_leak_cpp", text_names, text_attributes);
+        toast_table.create();
+        ValueDict text_row;
+        for (auto const &name: text_names)
+            text_row[name] = Value(string(1024, name[0]));  // each just small enough to stay in line
+        text_row["p"] = Value(string(5000, 'p'));
+        try {
+            toast_table.insert(&text_row);
+            return assertion_failure("row too big to marshal was inserted");
+        } catch (DbRelationError &e) {
+            // expected
+        }
+        if (toast_table.toasted() != 0)
+            return assertion_failure("TOAST left by a failed insert", toast_table.toasted());
+        text_row["t"] = Value("t");
+        Handle handle = toast_table.insert(&text_row);
+        size_t toasted = toast_table.toasted();
+        ValueDict too_big;
+        too_big["t"] = Value(string(1024, 't'));
+        try {
+            toast_table.update(handle, &too_big);
+            return assertion_failure("update to a row too big to marshal");
+        } catch (DbRelationError &e) {
+            // expected
+        }
+        if (toast_table.toasted() != toasted)
+            return assertion_failure("TOAST left by a failed update", toast_table.toasted());
+        ValueDict *result = toast_table.project(handle);
+        if ((*result)["p"].s != text_row["p"].s || (*result)["t"].s != "t")
+            return assertion_failure("row after a failed update");
+        delete result;
+        toast_table.drop();
+    }
+    cout << "out-of-line TEXT ok" << endl;
+
+    // room freed by deletes gets used again, even after reopening (from the free-space map)
+    {
+        HeapTable fsm_table("_test_fsm_cpp", column_names, column_attributes);
+        fsm_table.create();
+        Handles inserted;
+        for (int i = 0; i < 400; i++) {
+            test_set_row(row, i, b);
+            inserted.push_back(fsm_table.insert(&row));
+        }
+        BlockID last = inserted.back().first;
+        uint freed = 0;
+        for (auto const &handle: inserted)
+            if (handle.first <= 2) {
+                fsm_table.del(handle);
+                freed++;
+            }
+        fsm_table.close();
+        HeapTable reopened("_test_fsm_cpp", column_names, column_attributes);
+        reopened.open();
+        for (uint j = 0; j < freed; j++) {
+            test_set_row(row, 1000 + j, b);
+            Handle handle = reopened.insert(&row);
+            if (handle.first > 2)
+                return assertion_failure("free space not reused", handle.first);
+        }
+        test_set_row(row, 2000, b);
+        if (reopened.insert(&row).first != last)
+            return assertion_failure("free-space map after filling freed blocks");
+        handles = reopened.select();
+        if (handles->size() != 401)
+            return assertion_failure("free-space map select", handles->size());
+        delete handles;
+        reopened.drop();
+    }
+    {
+        // a block going back and forth between categories is stacked once per category, not once per trip
+        TestFreeSpaceFile file("_test_fsm_stacks");
+        file.create();  // just block 1
+        file.note(1, 100);
+        file.note(1, 3000);
+        size_t stacked = file.stacked();
+        for (int i = 0; i < 1000; i++) {
+            file.note(1, 100);
+            file.note(1, 3000);
+        }
+        if (file.stacked() != stacked)
+            return assertion_failure("free-space stacks grow", file.stacked());
+        if (file.find_free_block(2000) != 1)
+            return assertion_failure("free-space stacks lost a block");
+        file.note(1, 1000);
+        if (file.find_free_block(2000) != 0 || file.find_free_block(500) != 1)
+            return assertion_failure("free-space stacks after a stale entry");
+        file.note(1, 3000);
+        if (file.find_free_block(2000) != 1)
+            return assertion_failure("free-space stacks after a stale entry is popped");
+        file.drop();
+    }
+    cout << "free-space map ok" << endl;
+
+    // the same rows kept in a memory-mapped file instead
+    {
+        HeapTable mmap_table("_test_mmap_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                             HeapFile::SLOTTED_PAGE, false, HeapTable::MMAP);
+        mmap_table.create();
+        for (int i = 0; i < 1000; i++) {
+            test_set_row(row, i, b);
+            mmap_table.insert(&row);
+        }
+        mmap_table.close();
+        HeapTable reopened("_test_mmap_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                           HeapFile::SLOTTED_PAGE, false, HeapTable::MMAP);
+        reopened.open();
+        handles = reopened.select();
+        if (handles->size() != 1000)
+            return assertion_failure("mmap select", handles->size());
+        i = 0;
+        for (auto const &handle: *handles)
+            if (!test_compare(reopened, handle, i++, b))
+                return assertion_failure("mmap project", i);
+        reopened.del((*handles)[10]);
+        delete handles;
+        handles = reopened.select();
+        if (handles->size() != 999)
+            return assertion_failure("mmap del", handles->size());
+        delete handles;
+        reopened.drop();
+    }
+    cout << "mmap table ok" << endl;
+
+    // scanning a row at a time
+    {
+        HeapTable scan_table("_test_scan_cpp", column_names, column_attributes);
+        scan_table.create();
+        for (int i = 0; i < 500; i++) {
+            test_set_row(row, i % 100, b);
+            scan_table.insert(&row);
+        }
+        handles = scan_table.select();
+        DbHandleIterator *rows = scan_table.scan();
+        Handle handle;
+        uint n = 0;
+        while (rows->next(handle))
+            if (n >= handles->size() || (*handles)[n++] != handle)
+                return assertion_failure("scan order", n);
+        delete rows;
+        if (n != 500)
+            return assertion_failure("scan count", n);
+        delete handles;
+        ValueDict where;
+        where["a"] = Value(12);
+        rows = scan_table.scan(&where);
+        n = 0;
+        while (rows->next(handle)) {
+            if (!test_compare(scan_table, handle, 12, b))
+                return assertion_failure("scan where");
+            n++;
+        }
+        delete rows;
+        where["b"] = Value(b);
+        rows = scan_table.scan(scan_table.scan(&where), &where);
+        uint refined = 0;
+        while (rows->next(handle))
+            refined++;
+        delete rows;
+        if (n != 5 || refined != 5)
+            return assertion_failure("scan where count", n);
+        scan_table.drop();
+    }
+    cout << "scan ok" << endl;
+    {
+        // more blocks than one bulk read gets
+        const BlockID N_BLOCKS = HeapFile::BULK_BUFFER_SZ / DbBlock::BLOCK_SZ + 50;
+        HeapFile file("_test_bulk_scan");
+        file.create();
+        char bytes[100];
+        for (BlockID block_id = 1; block_id <= N_BLOCKS; block_id++) {
+            DbBlock *block = block_id == 1 ? file.get(1) : file.get_new();
+            memset(bytes, 'a' + block_id % 26, sizeof(bytes));
+            Dbt data(bytes, sizeof(bytes) - block_id % 50);
+            block->add(&data);
+            file.put(block);
+            delete block;
+        }
+        DbFile &db_file = file;  // a scan through the DbFile interface is still the bulk one
+        DbBlockScan *blocks = db_file.scan_blocks();
+        BlockID n = 0;
+        for (DbBlock *block = blocks->next(); block != nullptr; block = blocks->next()) {
+            u_int16_t size;
+            const char *record = block->view(1, size);
+            if (block->get_block_id() != ++n || record == nullptr || size != sizeof(bytes) - n % 50
+                || record[size - 1] != (char) ('a' + n % 26))
+                return assertion_failure("bulk scan block", n);
+            delete block;
+        }
+        delete blocks;
+        if (n != N_BLOCKS)
+            return assertion_failure("bulk scan count", n);
+        if (_BUFFER_POOL != nullptr) {
+            ulong hits = _BUFFER_POOL->get_hits();
+            delete file.get(N_BLOCKS);
+            if (_BUFFER_POOL->get_hits() != hits + 1)
+                return assertion_failure("bulk scan block left in the pool");
+        }
+        file.drop();
+    }
+    cout << "bulk scan ok" << endl;
+    {
+        HeapFile file("_test_extents");
+        file.create();
+        char bytes[] = "hello";
+        Dbt data(bytes, sizeof(bytes));
+        for (int i = 0; i < 10; i++) {
+            DbBlock *block = file.get_new();
+            block->add(&data);
+            file.put(block);
+            delete block;
+        }
+        file.close();
+        HeapFile reopened("_test_extents");
+        reopened.open();
+        if (reopened.get_last_block_id() != 11)
+            return assertion_failure("reserved blocks counted as in use", reopened.get_last_block_id());
+        BlockID free_block = reopened.find_free_block(100);
+        if (free_block == 0 || free_block > 11)
+            return assertion_failure("reserved block in the free-space map", free_block);
+        DbBlock *block = reopened.get_new();
+        if (block->get_block_id() != 12 || block->size() != 0 || reopened.get_last_block_id() != 12)
+            return assertion_failure("block from a reserved extent");
+        delete block;
+        HeapFile::BlockScan *blocks = reopened.scan_blocks();
+        BlockID n = 0;
+        for (block = blocks->next(); block != nullptr; block = blocks->next()) {
+            n++;
+            delete block;
+        }
+        delete blocks;
+        if (n != 12)
+            return assertion_failure("scan past the blocks in use", n);
+        reopened.set_extents(1, 1);
+        for (BlockID block_id = 13; block_id <= 20; block_id++)  // through the rest of the extent, then one at a time
+            delete reopened.get_new();
+        reopened.close();
+        HeapFile again("_test_extents");
+        again.open();
+        if (again.get_last_block_id() != 20)
+            return assertion_failure("extents of one block", again.get_last_block_id());
+
+        // a truncated file ends where it was cut when it is reopened (Berkeley DB still counts the records deleted)
+        if (again.truncate(15) != 5)
+            return assertion_failure("truncate count");
+        again.close();
+        HeapFile cut("_test_extents");
+        cut.open();
+        if (cut.get_last_block_id() != 15)
+            return assertion_failure("reopened after truncate", cut.get_last_block_id());
+        block = cut.get_new();
+        if (block->get_block_id() != 16 || block->size() != 0)
+            return assertion_failure("new block after truncate", block->get_block_id());
+        delete block;
+        cut.close();
+        cut.open();
+        if (cut.get_last_block_id() != 16)
+            return assertion_failure("reopened after growing back", cut.get_last_block_id());
+        cut.drop();
+    }
+    cout << "extents ok" << endl;
+    {
+        HeapTable batch_table("_test_insert_batch_cpp", column_names, column_attributes);
+        batch_table.create();
+        ValueDicts rows;
+        for (int i = 0; i < 1000; i++) {
+            ValueDict *batch_row = new ValueDict();
+            test_set_row(*batch_row, i, b);
+            rows.push_back(batch_row);
+        }
+        handles = batch_table.insert_batch(rows);
+        if (handles->size() != rows.size())
+            return assertion_failure("insert_batch handle count", handles->size());
+        for (uint n = 0; n < handles->size(); n++) {
+            if (!test_compare(batch_table, (*handles)[n], (int) n, b))
+                return assertion_failure("insert_batch row", n);
+            if (n > 0 && (*handles)[n].first < (*handles)[n - 1].first)
+                return assertion_failure("insert_batch fills blocks in order", n);
+        }
+        BlockID last_block = handles->back().first;
+        delete handles;
+
+        // as many blocks as inserting one at a time, and the next batch carries on in the last of them
+        HeapTable single_table("_test_insert_single_cpp", column_names, column_attributes);
+        single_table.create();
+        for (auto const &one: rows)
+            single_table.insert(one);
+        if (single_table.get_file().get_last_block_id() != batch_table.get_file().get_last_block_id())
+            return assertion_failure("insert_batch blocks", batch_table.get_file().get_last_block_id());
+        single_table.drop();
+        ValueDicts two(rows.begin(), rows.begin() + 2);
+        handles = batch_table.insert_batch(two);
+        if ((*handles)[0].first != last_block || !test_compare(batch_table, (*handles)[1], 1, b))
+            return assertion_failure("insert_batch after a batch");
+        delete handles;
+
+        // a bad row stops the batch, but the rows before it are in
+        ValueDict *partial = new ValueDict();
+        (*partial)["a"] = Value(12);
+        delete rows[3];
+        rows[3] = partial;
+        try {
+            delete batch_table.insert_batch(ValueDicts(rows.begin(), rows.begin() + 5));
+            return assertion_failure("insert_batch of a row missing a column");
+        } catch (DbRelationError &e) {
+            // expected
+        }
+        handles = batch_table.select();
+        if (handles->size() != 1005)
+            return assertion_failure("insert_batch before a bad row", handles->size());
+        delete handles;
+        for (auto const &one: rows)
+            delete one;
+        delete batch_table.insert_batch(ValueDicts());
+        batch_table.drop();
+    }
+    cout << "insert batch ok" << endl;
+    {
+        ColumnNames codec_names = {"x", "y", "z", "w", "v"};
+        ColumnAttributes codec_attributes = {ColumnAttribute(ColumnAttribute::INT),
+                                             ColumnAttribute(ColumnAttribute::TEXT),
+                                             ColumnAttribute(ColumnAttribute::INT),
+                                             ColumnAttribute(ColumnAttribute::TEXT),
+                                             ColumnAttribute(ColumnAttribute::BOOLEAN)};
+        HeapTable codec_table("_test_row_codec_cpp", codec_names, codec_attributes);
+        const HeapTable::RowCodec &codec = codec_table.get_codec();
+        if (codec.column_number("x") != 0 || codec.column_number("v") != 4 || codec.column_number("u") != -1)
+            return assertion_failure("codec column numbers");
+        ValueDict codec_row;
+        codec_row["x"] = Value(-7);
+        codec_row["y"] = Value("why");
+        codec_row["z"] = Value(1234567);
+        codec_row["w"] = Value("");
+        codec_row["v"] = Value(1);
+        codec_row["extra"] = Value(99);  // not a column, so ignored
+        char bytes[DbBlock::BLOCK_SZ];
+        uint size = codec.encode(&codec_row, bytes);
+        if (size != 4 + 2 + 3 + 4 + 2 + 1)
+            return assertion_failure("codec encoded size", size);
+        if (*(u16 *) (bytes + 9) != 13 + 3 || *(u16 *) (bytes + 11) != 13 + 3)  // after x, z, and v
+            return assertion_failure("codec TEXT directory");
+        Value value;
+        codec.decode_column(bytes, 3, value);
+        if (value.data_type != ColumnAttribute::TEXT || value.s != "")
+            return assertion_failure("codec decode column");
+        codec_row.erase("extra");
+        ValueDict *decoded = codec.decode(bytes);
+        if (decoded->size() != 5 || (*decoded)["x"].n != -7 || (*decoded)["y"].s != "why"
+            || (*decoded)["z"].n != 1234567 || (*decoded)["w"].s != "" || (*decoded)["v"].n != 1
+            || (*decoded)["v"].data_type != ColumnAttribute::BOOLEAN)
+            return assertion_failure("codec decode all");
+        delete decoded;
+        ColumnNames some = {"v", "w", "x", "z"};  // out of order, so decoding has to go back
+        decoded = codec.decode(bytes, &some);
+        if (decoded->size() != 4 || (*decoded)["x"].n != -7 || (*decoded)["z"].n != 1234567
+            || (*decoded)["w"].s != "" || (*decoded)["v"].n != 1)
+            return assertion_failure("codec decode some");
+        delete decoded;
+        some = {"u"};
+        try {
+            delete codec.decode(bytes, &some);
+            return assertion_failure("codec decode of a column the table doesn't have");
+        } catch (DbRelationError &e) {
+            // expected
+        }
+        codec_row.erase("w");
+        try {
+            codec.encode(&codec_row, bytes);
+            return assertion_failure("codec encode of a row missing a column");
+        } catch (DbRelationError &e) {
+            // expected
+        }
+    }
+    cout << "row codec ok" << endl;
+    for (int pax = 0; pax <= 1; pax++) {
+        HeapTable where_table("_test_select_where_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                              pax ? HeapFile::PAX : HeapFile::SLOTTED_PAGE);
+        where_table.create();
+        string long_b(DbBlock::BLOCK_SZ / 2, 'q');  // out of line
+        for (int i = 0; i < 300; i++) {
+            test_set_row(row, i % 10, i % 3 == 0 ? long_b : b);
+            where_table.insert(&row);
+        }
+        ValueDict where;
+        where["b"] = Value(long_b);
+        handles = where_table.select(&where);
+        if (handles->size() != 100 || !test_compare(where_table, handles->back(), 7, long_b))
+            return assertion_failure("select where TEXT out of line", handles->size());
+        delete handles;
+        where["a"] = Value(3);
+        handles = where_table.select(&where);  // i % 10 == 3 and i % 3 == 0
+        if (handles->size() != 10 || !test_compare(where_table, handles->front(), 3, long_b))
+            return assertion_failure("select where INT and TEXT", handles->size());
+        Handles current(*handles);
+        delete handles;
+        where.erase("b");
+        where["c"] = Value(0);
+        where["c"].data_type = ColumnAttribute::BOOLEAN;
+        handles = where_table.select(&current, &where);
+        if (handles->size() != 10)
+            return assertion_failure("refined select where BOOLEAN", handles->size());
+        delete handles;
+        where["c"].n = 1;
+        handles = where_table.select(&current, &where);
+        if (!handles->empty())
+            return assertion_failure("refined select where BOOLEAN true", handles->size());
+        delete handles;
+
+        // a value of the wrong type matches nothing, and a column the table doesn't have is an error
+        ValueDict wrong;
+        wrong["a"] = Value("3");
+        handles = where_table.select(&wrong);
+        if (!handles->empty())
+            return assertion_failure("select where value of the wrong type", handles->size());
+        delete handles;
+        wrong.clear();
+        wrong["nope"] = Value(3);
+        try {
+            delete where_table.select(&wrong);
+            return assertion_failure("select where unknown column");
+        } catch (DbRelationError &e) {
+            // expected
+        }
+        where_table.drop();
+    }
+    cout << "select where ok" << endl;
+    for (int pax = 0; pax <= 1; pax++) {
+        HeapTable batch_table("_test_project_batch_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                              pax ? HeapFile::PAX : HeapFile::SLOTTED_PAGE);
+        batch_table.create();
+        for (int i = 0; i < 500; i++) {
+            test_set_row(row, i, b);
+            batch_table.insert(&row);
+        }
+        handles = batch_table.select();
+        BlockID blocks = handles->back().first;
+        reverse(handles->begin(), handles->end());
+        handles->push_back(handles->front());  // the same row twice
+        ulong pins = _BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses();
+        ValueDicts *rows = batch_table.project(handles);
+        if (_BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses() != pins + blocks)
+            return assertion_failure("project batch gets each block once",
+                                     _BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses() - pins);
+        if (rows->size() != 501 || (*rows)[0]->size() != 3 || (*(*rows)[0])["a"].n != 499
+            || (*(*rows)[499])["a"].n != 0 || (*(*rows)[500])["a"].n != 499 || (*(*rows)[250])["b"].s != b)
+            return assertion_failure("project batch in the order asked for");
+        for (auto const &one: *rows)
+            delete one;
+        delete rows;
+        ColumnNames just_a = {"a"};
+        rows = batch_table.project(handles, &just_a);
+        if (rows->size() != 501 || (*rows)[1]->size() != 1 || (*(*rows)[1])["a"].n != 498)
+            return assertion_failure("project batch of some columns");
+        for (auto const &one: *rows)
+            delete one;
+        delete rows;
+        just_a.push_back("nope");
+        try {
+            delete batch_table.project(handles, &just_a);
+            return assertion_failure("project batch of an unknown column");
+        } catch (DbRelationError &e) {
+            // expected
+        }
+        delete handles;
+        batch_table.drop();
+    }
+    cout << "project batch ok" << endl;
+    for (int pax = 0; pax <= 1; pax++) {
+        HeapTable update_table("_test_update_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                               pax ? HeapFile::PAX : HeapFile::SLOTTED_PAGE);
+        update_table.create();
+        for (int i = 0; i < 100; i++) {
+            test_set_row(row, i, b);
+            update_table.insert(&row);
+        }
+        handles = update_table.select();
+        Handle first = (*handles)[0], second = (*handles)[1];
+        delete handles;
+
+        // in place
+        ValueDict new_values;
+        new_values["a"] = Value(1000);
+        update_table.update(first, &new_values);
+        if (!test_compare(update_table, first, 1000, b) || !test_compare(update_table, second, 1, b))
+            return assertion_failure("update in place");
+        string shorter = b.substr(0, 10);
+        new_values["b"] = Value(shorter);
+        update_table.update(first, &new_values);
+        if (!test_compare(update_table, first, 1000, shorter))
+            return assertion_failure("update in place smaller");
+        new_values.clear();
+        new_values["nope"] = Value(1);
+        try {
+            update_table.update(first, &new_values);
+            return assertion_failure("update of an unknown column");
+        } catch (DbRelationError &e) {
+            // expected
+        }
+        new_values.clear();
+        DbBlock *block;
+        string longer = b + b + b + b;  // won't fit in the full block
+        new_values["b"] = Value(longer);
+        if (pax) {
+            try {
+                update_table.update(second, &new_values);
+                return assertion_failure("update of a PAX row that doesn't fit");
+            } catch (DbRelationError &e) {
+                // expected
+            }
+            if (!test_compare(update_table, second, 1, b))
+                return assertion_failure("update of a PAX row that doesn't fit left it alone");
+            update_table.drop();
+            continue;
+        }
+
+        // moved to another block, with a stub left behind, and found by scans just once, at its old handle
+        update_table.update(second, &new_values);
+        block = update_table.get_file().get(second.first);
+        bool marked = block->is_marked(second.second);
+        delete block;
+        if (!marked || !test_compare(update_table, second, 1, longer))
+            return assertion_failure("update moved");
+        handles = update_table.select();
+        if (handles->size() != 100 || (*handles)[1] != second)
+            return assertion_failure("update moved select", handles->size());
+        delete handles;
+        ValueDict where;
+        where["b"] = Value(longer);
+        handles = update_table.select(&where);
+        if (handles->size() != 1 || (*handles)[0] != second)
+            return assertion_failure("update moved select where", handles->size());
+        Handles current(*handles);
+        delete handles;
+        handles = update_table.select(&current, &where);
+        if (handles->size() != 1)
+            return assertion_failure("update moved select refined", handles->size());
+        delete handles;
+        ValueDicts *rows = update_table.project(&current);
+        if ((*(*rows)[0])["b"].s != longer)
+            return assertion_failure("update moved project batch");
+        delete (*rows)[0];
+        delete rows;
+
+        // updated where it moved to, then back home once it fits there again (with its TEXT out of line)
+        new_values.clear();
+        new_values["a"] = Value(3);
+        update_table.update(second, &new_values);
+        block = update_table.get_file().get(second.first);
+        marked = block->is_marked(second.second);
+        delete block;
+        if (!marked || !test_compare(update_table, second, 3, longer))
+            return assertion_failure("update where moved to");
+        string longest(DbBlock::BLOCK_SZ / 2, 'z');
+        new_values["b"] = Value(longest);
+        update_table.update(second, &new_values);
+        block = update_table.get_file().get(second.first);
+        marked = block->is_marked(second.second);
+        delete block;
+        if (marked || !test_compare(update_table, second, 3, longest))
+            return assertion_failure("update moved back");
+        new_values["b"] = Value(longer);
+        update_table.update(second, &new_values);
+
+        // deleting a moved row deletes it where it is, too
+        update_table.del(second);
+        handles = update_table.select();
+        if (handles->size() != 99)
+            return assertion_failure("del of a moved row", handles->size());
+        delete handles;
+        ulong records = 0;
+        HeapFile::BlockScan *blocks = update_table.get_file().scan_blocks();
+        for (block = blocks->next(); block != nullptr; block = blocks->next()) {
+            records += block->size();
+            delete block;
+        }
+        delete blocks;
+        if (records != 99)
+            return assertion_failure("del of a moved row left it", records);
+        try {
+            update_table.update(second, &new_values);
+            return assertion_failure("update of a deleted row");
+        } catch (DbRelationError &e) {
+            // expected
+        }
+        update_table.drop();
+    }
+    cout << "update ok" << endl;
+    for (int pax = 0; pax <= 1; pax++) {
+        // on a small pool of its own, so the scan has to wait for the workers to let go of blocks
+        BufferPool *saved = _BUFFER_POOL;
+        BufferPool pool(8);
+        _BUFFER_POOL = &pool;
+        HeapTable parallel_table("_test_parallel_select_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                                 pax ? HeapFile::PAX : HeapFile::SLOTTED_PAGE);
+        parallel_table.create();
+        for (int i = 0; i < 1000; i++) {
+            test_set_row(row, i % 7, b);
+            parallel_table.insert(&row);
+        }
+        string longer = b + b + b + b, longest(DbBlock::BLOCK_SZ / 2, 'z');
+        if (!pax) {
+            // some rows moved to other blocks, and one with its TEXT out of line
+            handles = parallel_table.select();
+            ValueDict new_values;
+            for (int i = 0; i < 1000; i += 97) {
+                new_values["b"] = Value(i == 97 ? longest : longer);
+                parallel_table.update((*handles)[i], &new_values);
+            }
+            delete handles;
+        }
+        vector<ValueDict> wheres(5);
+        wheres[0]["a"] = Value(3);
+        wheres[1]["c"] = Value(1);
+        wheres[1]["c"].data_type = ColumnAttribute::BOOLEAN;
+        wheres[2]["b"] = Value(longer);
+        wheres[3]["b"] = Value(longest);
+        wheres[3]["a"] = Value(6);
+        wheres[4]["a"] = Value(3);
+        wheres[4]["b"] = Value(b);
+        for (auto const &where: wheres) {
+            parallel_table.set_parallelism(1);
+            Handles *serial = parallel_table.select(&where);
+            parallel_table.set_parallelism(4);
+            handles = parallel_table.select(&where);
+            if (*handles != *serial || (!pax && serial->empty()))
+                return assertion_failure("parallel select same as serial", handles->size());
+            delete handles;
+            delete serial;
+        }
+        ValueDict wrong;
+        wrong["nope"] = Value(3);
+        try {
+            delete parallel_table.select(&wrong);
+            return assertion_failure("parallel select where unknown column");
+        } catch (DbRelationError &e) {
+            // expected
+        }
+        parallel_table.drop();
+        _BUFFER_POOL = saved;
+    }
+    cout << "parallel select ok" << endl;
+    for (int pax = 0; pax <= 1; pax++) {
+        HeapTable vacuum_table("_test_vacuum_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                               pax ? HeapFile::PAX : HeapFile::SLOTTED_PAGE);
+        vacuum_table.create();
+        for (int i = 0; i < 2000; i++) {
+            test_set_row(row, i, b);
+            vacuum_table.insert(&row);
+        }
+        handles = vacuum_table.select();
+        string longer = b + b + b + b;
+        ValueDict new_values;
+        new_values["b"] = Value(longer);
+        if (!pax) {
+            // rows moved behind stubs, from the front of the file and from the back
+            vacuum_table.update((*handles)[0], &new_values);
+            vacuum_table.update((*handles)[4], &new_values);
+            vacuum_table.update((*handles)[1996], &new_values);
+        }
+        // three quarters of the rows deleted, leaving the blocks sparse
+        Handles kept;
+        for (int i = 0; i < 2000; i++)
+            if (i % 4 == 0)
+                kept.push_back((*handles)[i]);
+            else
+                vacuum_table.del((*handles)[i]);
+        delete handles;
+        BlockID blocks = vacuum_table.get_file().get_last_block_id();
+        map<Handle, Handle> moved;
+        BlockID reclaimed = vacuum_table.vacuum(moved);
+        if (reclaimed < blocks / 2 || vacuum_table.get_file().get_last_block_id() != blocks - reclaimed)
+            return assertion_failure("vacuum reclaimed", reclaimed, blocks);
+        if (moved.empty())
+            return assertion_failure("vacuum moved rows");
+        Handles now;
+        vector<pair<Handle, int>> grown;  // rows that had moved behind stubs, and their a values
+        for (int i = 0; i < 500; i++) {
+            Handle handle = kept[i];
+            if (moved.find(handle) != moved.end())
+                handle = moved[handle];
+            bool was_updated = !pax && (i == 0 || i == 1 || i == 499);
+            if (!test_compare(vacuum_table, handle, i * 4, was_updated ? longer : b))
+                return assertion_failure("vacuum kept row", i);
+            now.push_back(handle);
+            if (was_updated)
+                grown.push_back(make_pair(handle, i * 4));
+        }
+        handles = vacuum_table.select();
+        sort(now.begin(), now.end());
+        sort(handles->begin(), handles->end());
+        if (*handles != now)
+            return assertion_failure("vacuum select", handles->size());
+        delete handles;
+        ValueDict where;
+        where["b"] = Value(longer);
+        handles = vacuum_table.select(&where);
+        if (handles->size() != (pax ? 0 : 3))
+            return assertion_failure("vacuum select moved rows", handles->size());
+        delete handles;
+
+        // nothing more to do the second time, and the file grows again from where it was cut off
+        moved.clear();
+        blocks = vacuum_table.get_file().get_last_block_id();
+        if (vacuum_table.vacuum(moved) != 0 || !moved.empty())
+            return assertion_failure("vacuum again", moved.size());
+        for (int i = 0; i < 2000; i++) {
+            test_set_row(row, i, b);
+            vacuum_table.insert(&row);
+        }
+        vacuum_table.close();
+        vacuum_table.open();
+        handles = vacuum_table.select();
+        if (handles->size() != 2500 || vacuum_table.get_file().get_last_block_id() <= blocks)
+            return assertion_failure("vacuum then insert", handles->size());
+        delete handles;
+
+        // rows that had moved behind stubs can still be updated and deleted, wherever the vacuum put them
+        string longest = longer + longer;
+        new_values["b"] = Value(longest);
+        for (auto const &row_moved: grown) {
+            vacuum_table.update(row_moved.first, &new_values);
+            if (!test_compare(vacuum_table, row_moved.first, row_moved.second, longest))
+                return assertion_failure("vacuum then update", row_moved.second);
+        }
+        for (auto const &row_moved: grown)
+            vacuum_table.del(row_moved.first);
+        handles = vacuum_table.select();
+        if (handles->size() != 2500 - grown.size())
+            return assertion_failure("vacuum then delete", handles->size());
+        delete handles;
+        size_t records = 0;  // no copies of them left behind in blocks, either
+        HeapFile::BlockScan *scan = vacuum_table.get_file().scan_blocks();
+        for (DbBlock *block = scan->next(); block != nullptr; block = scan->next()) {
+            records += block->size();
+            delete block;
+        }
+        delete scan;
+        if (records != 2500 - grown.size())
+            return assertion_failure("vacuum then delete, records left", records);
+        where["b"] = Value(b);
+        handles = vacuum_table.select(&where);
+        if (handles->size() != 2500 - grown.size())
+            return assertion_failure("vacuum then delete, others kept", handles->size());
+        delete handles;
+        vacuum_table.drop();
+    }
+    cout << "vacuum ok" << endl;
+
+    HeapTable zoned_table("_test_zone_cpp", column_names, column_attributes);
+    zoned_table.create();
+    ValueDicts batch;
+    for (int i = 0; i < 3000; i++) {
+        auto *one = new ValueDict();
+        test_set_row(*one, i, b);
+        batch.push_back(one);
+    }
+    handles = zoned_table.insert_batch(batch);
+    for (auto const one: batch)
+        delete one;
+    Handles zoned = *handles;
+    delete handles;
+    BlockID blocks = zoned_table.get_file().get_last_block_id();
+    ValueDict where;
+    for (int i = 0; i < 3000; i += 299) {
+        where["a"] = Value(i);
+        vector<bool> candidates = zoned_table.get_zone_map().might_match(&where, blocks);
+        if (count(candidates.begin(), candidates.end(), true) != 1 || !candidates[zoned[i].first - 1])
+            return assertion_failure("zones of a batch", i);
+        handles = zoned_table.select(&where);
+        if (handles->size() != 1 || (*handles)[0] != zoned[i])
+            return assertion_failure("zone select", i, handles->size());
+        delete handles;
+    }
+    where["a"] = Value(3000);
+    handles = zoned_table.select(&where);
+    if (!handles->empty())
+        return assertion_failure("zone select of nothing", handles->size());
+    delete handles;
+
+    // a row keeps its handle's zone wherever it goes, and updated values widen it
+    ValueDict new_values;
+    new_values["a"] = Value(-5);
+    new_values["b"] = Value(b + b + b + b);
+    zoned_table.update(zoned[1], &new_values);
+    where["a"] = Value(-5);
+    handles = zoned_table.select(&where);
+    if (handles->size() != 1 || (*handles)[0] != zoned[1])
+        return assertion_failure("zone select of updated row", handles->size());
+    delete handles;
+    row = new_values;
+    row["c"] = Value(false);
+    zoned_table.insert(&row);
+    handles = zoned_table.select(&new_values);
+    if (handles->size() != 2)
+        return assertion_failure("zone select of moved row and new one", handles->size());
+    delete handles;
+
+    // a block with no rows left is passed over; one from before there were zone maps gets its zones worked out
+    BlockID emptied = zoned[2999].first;
+    zoned_table.checkpoint();
+    for (int i = 2999; i >= 0 && zoned[i].first == emptied; i--)
+        zoned_table.del(zoned[i]);
+    where.clear();
+    where["b"] = Value(b);
+    if (zoned_table.get_zone_map().might_match(&where, blocks)[emptied - 1])
+        return assertion_failure("zone of emptied block");
+
+    // the changed zones are written out at a checkpoint, not as each row changes
+    {
+        ZoneMap before(zoned_table.get_table_name(), column_names, column_attributes);
+        before.open(blocks);
+        bool written = !before.might_match(&where, blocks)[emptied - 1];
+        before.close();
+        zoned_table.checkpoint();
+        ZoneMap after(zoned_table.get_table_name(), column_names, column_attributes);
+        after.open(blocks);
+        if (written || after.might_match(&where, blocks)[emptied - 1])
+            return assertion_failure("zones written at a checkpoint");
+        after.close();
+    }
+    zoned_table.close();
+    ZoneMap(zoned_table.get_table_name(), column_names, column_attributes).drop();
+    zoned_table.open();
+    where.clear();
+    where["a"] = Value(1500);
+    vector<bool> candidates = zoned_table.get_zone_map().might_match(&where, blocks);
+    if (count(candidates.begin(), candidates.end(), true) != 1)
+        return assertion_failure("zones worked out", count(candidates.begin(), candidates.end(), true));
+    handles = zoned_table.select(&where);
+    if (handles->size() != 1 || (*handles)[0] != zoned[1500])
+        return assertion_failure("zone select after working zones out", handles->size());
+    delete handles;
+    zoned_table.drop();
+    cout << "zone maps ok" << endl;
     return true;
 }
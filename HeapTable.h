@@ -7,19 +7,61 @@
  */
 #pragma once
 
+#include <mutex>
 #include "storage_engine.h"
+#include "RowFormat.h"
 #include "SlottedPage.h"
+#include "PaxPage.h"
 #include "HeapFile.h"
+#include "MmapHeapFile.h"
+#include "UringHeapFile.h"
+#include "ZoneMap.h"
 
 /**
  * @class HeapTable - Heap storage engine (implementation of DbRelation)
+ *
+ * Rows are kept whole in SlottedPage blocks, or, with the PAX layout, split up by column in PaxPage blocks
+ * so that projecting or selecting on a few columns only has to look at those columns.
+ *
+ * TEXT values bigger than a quarter of a block are kept out of line in the table's TOAST file (made when
+ * first needed), in a chain of chunks, with just a pointer left in the row. They are only fetched when
+ * their column is projected.
+ *
+ * An updated row is rewritten in place when its block has room. When it doesn't, the row moves to another block
+ * and leaves a marked (see DbBlock::set_marked) FORWARD_SZ stub behind pointing to where it went, so its handle
+ * never changes. The moved row is marked too, and has a pointer back to its own block in front of it. Scans skip
+ * moved rows and hand out their stubs instead. (Rows of a PAX table are only ever updated in place.)
+ *
+ * A select with a where clause can be spread over worker threads (see set_parallelism). The calling thread still
+ * does all the reading, pinning each block in the buffer pool and handing them out MORSEL_BLOCKS at a time; the
+ * workers just check the where clause against the rows of the blocks they are handed, each on its own, and the
+ * rows they find are put back together in block order. Anything a worker has to get from the buffer pool (where a
+ * stub's row is now, or a TOASTed value) it gets under a latch shared with the calling thread.
+ *
+ * Each block has a zone in the table's ZoneMap, with bounds on the values of the rows whose handles are in it (those
+ * of moved rows included, under their stubs). Selects with a where clause pass over the blocks whose zones rule it
+ * out; when few enough are left (ZONE_SEEK_FRACTION), just those blocks are read, each on its own. A table from
+ * before there were zone maps has its zones worked out the first time it is opened, and vacuum works them out
+ * again, tight. The zones changed by inserts, updates, and deletes are written out at the next checkpoint (or close).
  */
 
 class HeapTable : public DbRelation {
 public:
-    HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes);
+    /**
+     * What keeps the table's blocks.
+     */
+    enum StorageEngine {
+        BERKELEY_DB,  // a Berkeley DB RecNo file (HeapFile)
+        MMAP,         // a plain memory-mapped file (MmapHeapFile)
+        URING,        // a plain file read and written through io_uring (UringHeapFile)
+        DIRECT        // as URING, but with O_DIRECT so blocks are cached only in the buffer pool
+    };
+
+    HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+              uint block_size = DbBlock::BLOCK_SZ, HeapFile::BlockLayout layout = HeapFile::SLOTTED_PAGE,
+              bool compressed = false, StorageEngine engine = BERKELEY_DB);
 
-    virtual ~HeapTable() {}
+    virtual ~HeapTable();
 
     HeapTable(const HeapTable &other) = delete;
 
@@ -39,8 +81,12 @@ public:
 
     virtual void close();
 
+    virtual void checkpoint();
+
     virtual Handle insert(const ValueDict *row);
 
+    virtual Handles *insert_batch(const ValueDicts &rows);
+
     virtual void update(const Handle handle, const ValueDict *new_values);
 
     virtual void del(const Handle handle);
@@ -51,24 +97,381 @@ public:
 
     virtual Handles* select(Handles *current_selection, const ValueDict* where);
 
+    virtual DbHandleIterator *scan(const ValueDict *where = nullptr);
+
+    virtual DbHandleIterator *scan(DbHandleIterator *current_selection, const ValueDict *where);
+
     virtual ValueDict *project(Handle handle);
 
     virtual ValueDict *project(Handle handle, const ColumnNames *column_names);
 
+    virtual ValueDicts *project(Handles *handles);
+
+    virtual ValueDicts *project(Handles *handles, const ColumnNames *column_names);
+
+    virtual ValueDicts *project(Handles *handles, const ValueDict *where);
+
     using DbRelation::project;
 
+    /**
+     * Get the heap file the table's rows are kept in.
+     * @return  the file (owned by the table)
+     */
+    virtual HeapFile &get_file() { return *file; }
+
+    /**
+     * Most blocks handed to a worker of a parallel select at a time.
+     */
+    static const uint MORSEL_BLOCKS = 16;
+
+    /**
+     * Set how many worker threads a select with a where clause spreads its blocks over. With 1 (to start with),
+     * selects run on just the calling thread; so do those of a table whose file has no buffer pool to keep the
+     * blocks being worked on pinned (MMAP).
+     * @param degree  number of workers, or 0 for as many as the machine has cores
+     */
+    virtual void set_parallelism(uint degree);
+
+    /**
+     * Get how many worker threads a select with a where clause spreads its blocks over.
+     * @return number of workers (1 if selects don't use any)
+     */
+    virtual uint get_parallelism() const { return parallelism; }
+
+    /**
+     * Pack the table's rows into as few blocks as they fit in, and cut the blocks left empty off the end of the file.
+     * Rows are moved from the last blocks into room in the first ones, until the rest won't fit any further forward.
+     * A row that moves gets a new handle, except one that had already moved behind a forwarding stub, which just
+     * has its stub pointed at where it goes. (A stub that moves brings its row along, no longer forwarded.)
+     * @param moved  set to the old and new handle of each row whose handle changed (to put right in any indices)
+     * @return       number of blocks cut off the end of the file
+     */
+    virtual BlockID vacuum(std::map<Handle, Handle> &moved);
+
+    /**
+     * Get the bounds on the values of each block's rows.
+     * @return  the zone map (owned by the table)
+     */
+    virtual const ZoneMap &get_zone_map() const { return zones; }
+
+    /**
+     * A select whose where clause leaves no more than one in this many blocks to look at reads just those blocks,
+     * one at a time; otherwise it reads through the file and passes over the rest.
+     */
+    static const uint ZONE_SEEK_FRACTION = 8;
+
+    /**
+     * How a marshaled row marks a TEXT value that is in the TOAST file (see RowFormat).
+     */
+    static const uint16_t TOASTED_END = RowFormat::TOASTED_END;
+    static const uint16_t TOASTED = RowFormat::TOASTED;
+    static const uint TOAST_POINTER_SZ = RowFormat::TOAST_POINTER_SZ;
+
+    /**
+     * Size of the stub a row leaves behind when it moves to another block, and of the pointer back to the row's
+     * own block in front of the moved row: 4-byte block id and 2-byte record id.
+     */
+    static const uint FORWARD_SZ = 6;
+
+    /**
+     * @class HeapTable::RowCodec - marshals and unmarshals a table's rows, worked out once from its columns
+     *
+     *      A marshaled row has the fixed-width (INT and BOOLEAN) columns first, in column order, then a
+            directory with the 2-byte offset of the end of each TEXT value (TOASTED_END set if it is out of line),
+            then the TEXT values one after another. So any one column can be read without looking at the others.
+            Each column gets the encode and decode functions for its type and its place in the row (for TEXT,
+            the place of its directory entry). Encoding walks the row's values (kept in name order) alongside
+            the columns in name order instead of looking each column up, so a codec isn't for encoding from more
+            than one thread at once. Decoding is.
+     */
+    class RowCodec {
+    public:
+        explicit RowCodec(HeapTable &table);
+
+        RowCodec(const RowCodec &other) = delete;
+
+        RowCodec &operator=(const RowCodec &other) = delete;
+
+        /**
+         * Marshal a row.
+         * @param row    data for the tuple (every column has to be there; others are ignored)
+         * @param bytes  where to put the record (a block's worth)
+         * @return       size of the record
+         * @throws DbRelationError if the row is missing a column or is too big for a block
+         */
+        uint encode(const ValueDict *row, char *bytes) const;
+
+        /**
+         * Unmarshal a row, or just some of its columns (and only their out-of-line TEXT is fetched).
+         * @param bytes         the record
+         * @param column_names  columns to include, or nullptr or empty for all of them
+         * @return              row data (freed by caller)
+         * @throws DbRelationError if one of the column names isn't one of the table's
+         */
+        ValueDict *decode(const char *bytes, const ColumnNames *column_names = nullptr) const;
+
+        /**
+         * Unmarshal one column of a row, without looking at the others.
+         * @param bytes    the record
+         * @param col_num  which column
+         * @param value    gets the value
+         */
+        void decode_column(const char *bytes, uint col_num, Value &value) const;
+
+        /**
+         * Unmarshal one column's value, as kept apart from the rest of its row (as in a PAX block).
+         * @param col_num  which column
+         * @param bytes    the value
+         * @param size     size of the value, or TOASTED
+         * @param value    gets the value
+         */
+        void decode_value(uint col_num, const char *bytes, uint16_t size, Value &value) const;
+
+        /**
+         * Find a column's TOAST pointer in a row.
+         * @param bytes    the record
+         * @param col_num  which column
+         * @return         the pointer, or nullptr if the column isn't TEXT that is out of line
+         */
+        const char *toast_pointer(const char *bytes, uint col_num) const;
+
+        /**
+         * Find a column by name.
+         * @param column_name
+         * @return             its column number, or -1 if the table doesn't have it
+         */
+        int column_number(const Identifier &column_name) const;
+
+        /**
+         * @class HeapTable::RowCodec::Predicate - a where clause worked out against the codec's columns, so it can
+         * be checked against marshaled rows right where they are in their block, with a comparison of bytes for
+         * each column (fixed-width columns first)
+         */
+        class Predicate {
+        public:
+            /**
+             * Constructor
+             * @param codec  codec of the table whose rows get checked (must outlive the predicate)
+             * @param where  column values to match (must outlive the predicate), or nullptr to match every row
+             * @param latch  held while getting TOASTed values, if the predicate is shared by more than one thread
+             * @throws DbRelationError if one of the columns isn't one of the table's
+             */
+            Predicate(const RowCodec &codec, const ValueDict *where, std::recursive_mutex *latch = nullptr);
+
+            /**
+             * Check if every row matches (there is no where clause), so there is nothing to check.
+             * @return true if every row matches
+             */
+            bool is_everything() const { return terms.empty() && !never; }
+
+            /**
+             * Get the latch to hold while going to the table's files.
+             * @return the latch, or nullptr if the predicate is only used by one thread
+             */
+            std::recursive_mutex *get_latch() const { return latch; }
+
+            /**
+             * Check a marshaled row.
+             * @param bytes  the record (nullptr for one that has been deleted)
+             * @return       true if it matches
+             */
+            bool matches(const char *bytes) const;
+
+            /**
+             * Check a record in a PAX block, looking at just the where clause's columns' mini-pages.
+             * @param block      the block
+             * @param record_id  the record
+             * @return           true if it is there and matches
+             */
+            bool matches(const PaxPage *block, RecordID record_id) const;
+
+            /**
+             * Check a record in any kind of block.
+             * @param block      the block
+             * @param record_id  the record
+             * @return           true if it is there and matches
+             */
+            bool matches(const DbBlock *block, RecordID record_id) const;
+
+            /**
+             * Check all the given records of a block at once, keeping those that match.
+             * @param block       the block
+             * @param record_ids  records of the block, left with just the ones that match (in the same order)
+             */
+            void filter(const DbBlock *block, RecordIDs &record_ids) const;
+
+        protected:
+            struct Term {
+                uint col_num;
+                const Value *value;
+            };
+
+            const RowCodec &codec;
+            std::vector<Term> terms;  // fixed-width columns first
+            bool never;               // whether some value isn't even the type of its column
+            std::recursive_mutex *latch;
+
+            bool toasted_equals(const char *pointer, const std::string &text) const;
+        };
+
+    protected:
+        struct Column;
+
+        typedef void (*Encoder)(HeapTable &table, const Column &column, const Value &value, char *bytes, uint &end,
+                                uint block_size);
+        typedef void (*Decoder)(HeapTable &table, const Column &column, const char *bytes, Value &value);
+
+        struct Column {
+            Identifier name;
+            ColumnAttribute::DataType data_type;
+            uint offset;  // where its value is in the row (for TEXT, where its end offset is)
+            uint start;   // for the first TEXT column, where its value starts (0 for all the others)
+            Encoder encode;  // puts the value in its place (TEXT at end, moving end along)
+            Decoder decode;
+        };
+
+        HeapTable &table;
+        std::vector<Column> columns;    // in the table's order
+        std::vector<uint> by_name;      // column numbers in name order
+        uint text_start;                // where the first TEXT value starts (the size of the rest of the row)
+        mutable std::vector<const Value *> values;  // encode's values of the row being encoded
+
+        static uint text_begin(const Column &column, const char *bytes);
+
+        static void encode_int(HeapTable &table, const Column &column, const Value &value, char *bytes, uint &end,
+                               uint block_size);
+
+        static void encode_text(HeapTable &table, const Column &column, const Value &value, char *bytes, uint &end,
+                                uint block_size);
+
+        static void encode_boolean(HeapTable &table, const Column &column, const Value &value, char *bytes,
+                                   uint &end, uint block_size);
+
+        static void decode_int(HeapTable &table, const Column &column, const char *bytes, Value &value);
+
+        static void decode_text(HeapTable &table, const Column &column, const char *bytes, Value &value);
+
+        static void decode_boolean(HeapTable &table, const Column &column, const char *bytes, Value &value);
+    };
+
+    /**
+     * Get the codec the table's rows are marshaled with.
+     * @return  the codec (owned by the table)
+     */
+    virtual const RowCodec &get_codec() const { return codec; }
+
 protected:
-    HeapFile file;
+    HeapFile *file;
+    HeapFile toast;
+    RowCodec codec;
+    ZoneMap zones;
+    uint parallelism;
 
     virtual ValueDict *validate(const ValueDict *row) const;
 
     virtual Handle append(const ValueDict *row);
 
-    virtual Dbt *marshal(const ValueDict *row) const;
+    virtual Handle append(HeapFile &heap_file, const Dbt *data);
+
+    virtual Dbt *marshal(const ValueDict *row);
+
+    virtual uint marshal(const ValueDict *row, char *bytes);
+
+    virtual ValueDict *unmarshal(const char *bytes, const ColumnNames *column_names = nullptr);
+
+    virtual ValueDict *unmarshal(const PaxPage *block, RecordID record_id, const ColumnNames *column_names);
+
+    virtual ValueDict *project(const DbBlock *block, RecordID record_id, const ColumnNames *column_names);
+
+    virtual void check_columns(const ColumnNames *column_names) const;
+
+    virtual void toast_open(bool create);
+
+    virtual void toast_value(const std::string &text, char *pointer);
+
+    virtual std::string detoast(const char *pointer);
+
+    virtual void toast_del(const char *pointer);
 
-    virtual ValueDict *unmarshal(Dbt *data) const;
+    virtual void toast_del_row(const char *bytes, uint columns);
+
+    virtual void place(DbBlock *home, RecordID record_id, DbBlock *block, Handle moved, const Dbt &data);
+
+    virtual Handle relocate(const Dbt &data, BlockID home, BlockID from);
+
+    static bool forwarded(const DbBlock *block, RecordID record_id, Handle &to);
+
+    static const char *row_view(const DbBlock *block, RecordID record_id, u_int16_t &size);
 
     virtual bool selected(Handle handle, const ValueDict *where);
+
+    virtual bool selected(Handle handle, const RowCodec::Predicate &predicate);
+
+    virtual RecordIDs *select_block(DbBlock *block, const RowCodec::Predicate &predicate);
+
+    virtual Handles *parallel_select(const ValueDict *where);
+
+    virtual HeapFile::BlockScan *scan_blocks(const ValueDict *where);
+
+    virtual void rezone();
+
+    /**
+     * @class HeapTable::ZoneScan - reads just the blocks whose zones say they might have rows satisfying a where
+     * clause: each on its own with get if there are few enough of them (see ZONE_SEEK_FRACTION), else by reading
+     * through the file as usual (see HeapFile::scan_blocks) and passing over the others
+     */
+    class ZoneScan : public HeapFile::BlockScan {
+    public:
+        ZoneScan(HeapTable &table, const ValueDict *where);
+
+        virtual ~ZoneScan();
+
+        virtual DbBlock *next();
+
+    protected:
+        std::vector<bool> candidates;  // by block id less one
+        BlockID last;
+        HeapFile::BlockScan *blocks;   // reading through the file, or nullptr if getting just the candidates
+    };
+
+    /**
+     * @class HeapTable::ScanIterator - goes through the table a block at a time, holding just the record ids of
+     * one block's rows that satisfy the where clause (all checked while the block is at hand)
+     */
+    class ScanIterator : public DbHandleIterator {
+    public:
+        ScanIterator(HeapTable &table, const ValueDict *where);
+
+        virtual ~ScanIterator();
+
+        virtual bool next(Handle &handle);
+
+    protected:
+        HeapTable &table;
+        RowCodec::Predicate predicate;
+        HeapFile::BlockScan *blocks;
+        BlockID block_id;
+        RecordIDs *record_ids;  // of the current block
+        size_t pos;
+    };
+
+    /**
+     * @class HeapTable::FilterIterator - passes along the rows from another iterator that satisfy a where clause
+     */
+    class FilterIterator : public DbHandleIterator {
+    public:
+        FilterIterator(HeapTable &table, DbHandleIterator *source, const ValueDict *where)
+                : table(table), source(source), predicate(table.get_codec(), where) {}
+
+        virtual ~FilterIterator() { delete source; }
+
+        virtual bool next(Handle &handle);
+
+    protected:
+        HeapTable &table;
+        DbHandleIterator *source;
+        RowCodec::Predicate predicate;
+    };
 };
 
 bool test_heap_storage();
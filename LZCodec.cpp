@@ -0,0 +1,225 @@
+/**
+ * @file LZCodec.cpp
+ * @author K Lundeen
+ * @see Seattle University, CPSC5300
+ */
+#include <cstring>
+#include <cstdlib>
+#include "LZCodec.h"
+#include "SlottedPage.h"
+
+using namespace std;
+
+/**
+ * Compress in one pass, looking up each 4-byte prefix in a hash table of where it was last seen.
+ * @param in
+ * @param in_size
+ * @param out
+ * @param out_limit
+ * @return number of compressed bytes, or 0 if they don't fit
+ */
+uint LZCodec::compress(const char *in, uint in_size, char *out, uint out_limit) {
+    uint32_t last_seen[1U << HASH_BITS];  // position + 1 of the last prefix with each hash, 0 for none
+    memset(last_seen, 0, sizeof(last_seen));
+    uint out_size = 0, anchor = 0, pos = 0;
+    while (pos + MIN_MATCH <= in_size) {
+        uint32_t prefix;
+        memcpy(&prefix, in + pos, sizeof(prefix));
+        uint hash = (prefix * 2654435761U) >> (32 - HASH_BITS);
+        uint ref = last_seen[hash];
+        last_seen[hash] = pos + 1;
+        if (ref == 0 || pos - (ref - 1) > UINT16_MAX || memcmp(in + ref - 1, in + pos, MIN_MATCH) != 0) {
+            pos++;
+            continue;
+        }
+        ref--;
+        uint length = MIN_MATCH;
+        while (pos + length < in_size && in[ref + length] == in[pos + length])
+            length++;
+        if (!put_sequence(out, out_size, out_limit, in + anchor, pos - anchor, pos - ref, length))
+            return 0;
+        pos += length;
+        anchor = pos;
+    }
+    if (!put_sequence(out, out_size, out_limit, in + anchor, in_size - anchor, 0, 0))
+        return 0;
+    return out_size;
+}
+
+/**
+ * Decompress, checking every count and offset against the buffers.
+ * @param in
+ * @param in_size
+ * @param out
+ * @param out_limit
+ * @return number of bytes produced
+ */
+uint LZCodec::decompress(const char *in, uint in_size, char *out, uint out_limit) {
+    uint in_pos = 0, out_size = 0;
+    while (in_pos < in_size) {
+        uint8_t token = (uint8_t) in[in_pos++];
+        uint n_literals = token >> 4U;
+        if (n_literals == 15)
+            n_literals += get_count(in, in_pos, in_size);
+        if (in_pos + n_literals > in_size || out_size + n_literals > out_limit)
+            throw DbRelationError("corrupt compressed block");
+        memcpy(out + out_size, in + in_pos, n_literals);
+        in_pos += n_literals;
+        out_size += n_literals;
+        if (in_pos == in_size)
+            break;  // last sequence has no match
+
+        if (in_pos + 2 > in_size)
+            throw DbRelationError("corrupt compressed block");
+        uint offset = (uint8_t) in[in_pos] | ((uint) (uint8_t) in[in_pos + 1] << 8U);
+        in_pos += 2;
+        uint length = token & 0x0FU;
+        if (length == 15)
+            length += get_count(in, in_pos, in_size);
+        length += MIN_MATCH;
+        if (offset == 0 || offset > out_size || out_size + length > out_limit)
+            throw DbRelationError("corrupt compressed block");
+        char *from = out + out_size - offset;
+        if (offset >= length)
+            memcpy(out + out_size, from, length);
+        else
+            for (uint i = 0; i < length; i++)  // overlapping, e.g., a run of the same byte
+                out[out_size + i] = from[i];
+        out_size += length;
+    }
+    return out_size;
+}
+
+/**
+ * Append a sequence: token, literals, and (unless it's the last sequence) the match.
+ * @param out
+ * @param out_size      bytes already in out, updated
+ * @param out_limit
+ * @param literals
+ * @param n_literals
+ * @param offset        how far back the match is
+ * @param match_length  length of the match, or 0 for the last sequence
+ * @return false if it doesn't fit
+ */
+bool LZCodec::put_sequence(char *out, uint &out_size, uint out_limit, const char *literals, uint n_literals,
+                           uint offset, uint match_length) {
+    uint extra_length = match_length == 0 ? 0 : match_length - MIN_MATCH;
+    if (out_size >= out_limit)
+        return false;
+    out[out_size++] = (char) (((n_literals < 15 ? n_literals : 15) << 4U) | (extra_length < 15 ? extra_length : 15));
+    if (n_literals >= 15 && !put_count(out, out_size, out_limit, n_literals - 15))
+        return false;
+    if (out_size + n_literals > out_limit)
+        return false;
+    memcpy(out + out_size, literals, n_literals);
+    out_size += n_literals;
+    if (match_length == 0)
+        return true;
+    if (out_size + 2 > out_limit)
+        return false;
+    out[out_size++] = (char) (offset & 0xFFU);
+    out[out_size++] = (char) (offset >> 8U);
+    if (extra_length >= 15 && !put_count(out, out_size, out_limit, extra_length - 15))
+        return false;
+    return true;
+}
+
+/**
+ * Append the rest of a count that didn't fit in its nibble: bytes of 255 until one that is less.
+ * @return false if it doesn't fit
+ */
+bool LZCodec::put_count(char *out, uint &out_size, uint out_limit, uint count) {
+    while (true) {
+        if (out_size >= out_limit)
+            return false;
+        if (count < 255) {
+            out[out_size++] = (char) count;
+            return true;
+        }
+        out[out_size++] = (char) 255;
+        count -= 255;
+    }
+}
+
+/**
+ * Read the rest of a count that didn't fit in its nibble.
+ * @throws DbRelationError if it runs off the end
+ */
+uint LZCodec::get_count(const char *in, uint &in_pos, uint in_size) {
+    uint count = 0;
+    while (true) {
+        if (in_pos >= in_size)
+            throw DbRelationError("corrupt compressed block");
+        uint8_t byte = (uint8_t) in[in_pos++];
+        count += byte;
+        if (byte < 255)
+            return count;
+    }
+}
+
+/**
+ * Test helper. Compress and decompress, checking that we get back what we started with.
+ * @return the compressed size, or 0 if it failed
+ */
+static uint test_lz_round_trip(const char *in, uint in_size) {
+    char compressed[2 * DbBlock::BLOCK_SZ], decompressed[DbBlock::BLOCK_SZ];
+    uint compressed_size = LZCodec::compress(in, in_size, compressed, sizeof(compressed));
+    if (compressed_size == 0)
+        return 0;
+    uint size = LZCodec::decompress(compressed, compressed_size, decompressed, sizeof(decompressed));
+    if (size != in_size || memcmp(in, decompressed, size) != 0)
+        return 0;
+    return compressed_size;
+}
+
+/**
+ * Testing function for LZCodec.
+ * @return true if testing succeeded, false otherwise
+ */
+bool test_lz_codec() {
+    char block[DbBlock::BLOCK_SZ];
+    memset(block, 0, sizeof(block));
+    uint size = test_lz_round_trip(block, sizeof(block));
+    if (size == 0 || size > 64)
+        return assertion_failure("zeros", size);
+
+    string text = "Four score and seven years ago our fathers brought forth on this continent, a new nation. ";
+    for (uint i = 0; i < sizeof(block); i++)
+        block[i] = text[i % text.size()];
+    size = test_lz_round_trip(block, sizeof(block));
+    if (size == 0 || size > sizeof(block) / 10)
+        return assertion_failure("repeated text", size);
+
+    srand(5300);
+    for (uint i = 0; i < sizeof(block); i++)
+        block[i] = (char) rand();
+    size = test_lz_round_trip(block, sizeof(block));
+    if (size == 0)
+        return assertion_failure("random bytes");
+    char small[16];
+    if (LZCodec::compress(block, sizeof(block), small, sizeof(small)) != 0)
+        return assertion_failure("compress past out_limit");
+
+    for (uint n = 0; n < 40; n++)
+        if (test_lz_round_trip(text.c_str(), n) == 0)
+            return assertion_failure("short input", n);
+
+    // corrupt input
+    char compressed[DbBlock::BLOCK_SZ];
+    for (uint i = 0; i < sizeof(block); i++)
+        block[i] = text[i % text.size()];
+    size = LZCodec::compress(block, sizeof(block), compressed, sizeof(compressed));
+    try {
+        LZCodec::decompress(compressed, size, block, 100);
+        return assertion_failure("decompress past out_limit");
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    try {
+        if (LZCodec::decompress(compressed, size / 2, block, sizeof(block)) == sizeof(block))
+            return assertion_failure("decompress truncated");
+    } catch (DbRelationError &e) {
+        // also fine
+    }
+    return true;
+}
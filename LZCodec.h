@@ -0,0 +1,58 @@
+/**
+ * @file LZCodec.h - Small, fast LZ77-family compressor for blocks.
+ * LZCodec
+ *
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include "storage_engine.h"
+
+/**
+ * @class LZCodec - byte-oriented LZ77 compression in the style of LZ4, for compressing whole blocks.
+ *
+ *      The compressed form is a series of sequences, each:
+            token:         high nibble is the literal count, low nibble is the match length less 4
+                           (15 in either means more of the count follows, in bytes of 255 until one that is less)
+            literals:      copied as is
+            match offset:  2 bytes, how far back the match starts (the last sequence has no match)
+        Matches are found with a single-probe hash table of 4-byte prefixes, so compression is one pass and
+        decompression is just copying.
+ */
+class LZCodec {
+public:
+    /**
+     * Compress some bytes.
+     * @param in         bytes to compress
+     * @param in_size    how many
+     * @param out        where to put the compressed bytes
+     * @param out_limit  most compressed bytes to produce
+     * @returns          number of compressed bytes, or 0 if they would not fit in out_limit
+     */
+    static uint compress(const char *in, uint in_size, char *out, uint out_limit);
+
+    /**
+     * Decompress some bytes made by compress.
+     * @param in         compressed bytes
+     * @param in_size    how many
+     * @param out        where to put the original bytes
+     * @param out_limit  most bytes to produce
+     * @returns          number of bytes produced
+     * @throws           DbRelationError if the compressed bytes are corrupt (or too big for out_limit)
+     */
+    static uint decompress(const char *in, uint in_size, char *out, uint out_limit);
+
+protected:
+    static const uint MIN_MATCH = 4;
+    static const uint HASH_BITS = 12;
+
+    static bool put_sequence(char *out, uint &out_size, uint out_limit, const char *literals, uint n_literals,
+                             uint offset, uint match_length);
+
+    static bool put_count(char *out, uint &out_size, uint out_limit, uint count);
+
+    static uint get_count(const char *in, uint &in_pos, uint in_size);
+};
+
+bool test_lz_codec();
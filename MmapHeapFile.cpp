@@ -0,0 +1,306 @@
+/**
+ * @file MmapHeapFile.cpp - implementation of MmapHeapFile
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MmapHeapFile.h"
+
+using namespace std;
+
+static const uint HEADER_MAGIC = 0x00, HEADER_BLOCK_SZ = 0x04, HEADER_LAST = 0x08;
+
+/**
+ * Throw a DbException (like Berkeley DB would) for a failed system call.
+ * @param what  what we were trying to do
+ */
+static void system_failure(string what) {
+    int error = errno;
+    throw DbException((what + ": " + strerror(error)).c_str(), error);
+}
+
+/**
+ * Constructor
+ * @param name
+ * @param block_size         size of blocks if the file gets created (an existing file keeps its own block size)
+ * @param layout             layout of blocks if the file gets created (an existing file keeps its own layout)
+ * @param column_attributes  columns of the records, needed for PAX blocks
+ */
+MmapHeapFile::MmapHeapFile(string name, uint block_size, BlockLayout layout, const ColumnAttributes &column_attributes)
+        : HeapFile(name, block_size, layout, column_attributes), path(path_for(name)), fd(-1), file_size(0),
+          segments() {
+    this->pool = nullptr;  // the mapping is the cache
+}
+
+MmapHeapFile::~MmapHeapFile() {
+    if (!this->closed) {
+        unmap();
+        ::close(this->fd);
+    }
+}
+
+/**
+ * Where the file for a given name goes (in the database environment's directory).
+ * @param name
+ * @return      path of the file
+ */
+string MmapHeapFile::path_for(string name) {
+    const char *home = nullptr;
+    _DB_ENV->get_home(&home);
+    return string(home == nullptr ? "." : home) + "/" + name + ".mmap";
+}
+
+bool MmapHeapFile::exists(string name) {
+    struct stat buf;
+    return stat(path_for(name).c_str(), &buf) == 0;
+}
+
+/**
+ * Create physical file.
+ */
+void MmapHeapFile::create(void) {
+    db_open(DB_CREATE | DB_EXCL);
+    DbBlock *page = get_new(); // force one page to exist
+    delete page;
+}
+
+/**
+ * Delete the physical file.
+ */
+void MmapHeapFile::drop(void) {
+    close();
+    if (unlink(this->path.c_str()) != 0)
+        system_failure("remove " + this->path);
+    fsm_drop();
+}
+
+/**
+ * Open physical file.
+ */
+void MmapHeapFile::open(void) {
+    db_open();
+}
+
+/**
+ * Close the physical file, making sure every block has been written to it.
+ */
+void MmapHeapFile::close(void) {
+    if (this->closed)
+        return;
+    for (auto segment: this->segments)
+        if (segment != nullptr)
+            msync(segment, SEGMENT_SZ, MS_SYNC);
+    unmap();
+    ::close(this->fd);
+    this->fd = -1;
+    this->fsm.close(0);
+    this->closed = true;
+}
+
+/**
+ * Allocate a new block for the file, growing the file if need be.
+ * @return the new empty DbBlock that is managing the records in this block and its block id.
+ */
+DbBlock *MmapHeapFile::get_new(void) {
+    grow((uint64_t) (this->last + 2) * this->block_size);
+    BlockID block_id = ++this->last;
+    *(uint32_t *) (address(0) + HEADER_LAST) = this->last;
+    Dbt data(address(block_id), this->block_size);
+    DbBlock *page = make_block(data, block_id, true);
+    put(page);
+    delete page;
+    return get(block_id);
+}
+
+/**
+ * Get a block from the file (right on the mapped memory).
+ * @param block_id
+ * @return          the given slotted page or PAX page (freed by caller)
+ */
+DbBlock *MmapHeapFile::get(BlockID block_id) {
+    if (block_id == 0 || block_id > this->last)
+        throw DbRelationError("no such block in " + this->name);
+    Dbt data(address(block_id), this->block_size);
+    return make_block(data, block_id);
+}
+
+/**
+ * Write a block back to the file. The mapped memory is the file, so a block that was got from this file is
+ * there already.
+ * @param block
+ */
+void MmapHeapFile::put(DbBlock *block) {
+    BlockID block_id = block->get_block_id();
+    note_free_space(block_id, block->unused_bytes());
+    char *bytes = address(block_id);
+    if (block->get_data() != bytes)
+        memcpy(bytes, block->get_data(), this->block_size);
+}
+
+/**
+ * Start reading all the blocks in order. They're already in memory, so that is just a get for each.
+ * @return the scan (freed by caller)
+ */
+HeapFile::BlockScan *MmapHeapFile::scan_blocks() {
+    return new BlockScan(*this);
+}
+
+/**
+ * Open (or create) the file and map its first segment.
+ * @param flags  DB_CREATE and DB_EXCL, as for Berkeley DB
+ */
+void MmapHeapFile::db_open(uint flags) {
+    if (!this->closed)
+        return;
+    int open_flags = O_RDWR;
+    if (flags & DB_CREATE)
+        open_flags |= O_CREAT;
+    if (flags & DB_EXCL)
+        open_flags |= O_EXCL;
+    this->fd = ::open(this->path.c_str(), open_flags, 0644);
+    if (this->fd < 0)
+        system_failure("open " + this->path);
+    struct stat buf;
+    if (fstat(this->fd, &buf) != 0)
+        system_failure("stat " + this->path);
+    this->file_size = (uint64_t) buf.st_size;
+    this->segments.clear();
+    this->closed = false;
+
+    if (flags & DB_CREATE) {
+        this->last = 0;
+        grow(GROWTH_MIN_SZ);
+        char *header = address(0);
+        *(uint32_t *) (header + HEADER_MAGIC) = MAGIC;
+        *(uint32_t *) (header + HEADER_BLOCK_SZ) = this->block_size;
+        *(uint32_t *) (header + HEADER_LAST) = 0;
+    } else {
+        const char *header = this->file_size < DbBlock::BLOCK_SZ ? nullptr : address(0);
+        if (header == nullptr || *(uint32_t *) (header + HEADER_MAGIC) != MAGIC) {
+            close();
+            throw DbRelationError(this->path + " is not an mmap heap file");
+        }
+        this->block_size = *(uint32_t *) (header + HEADER_BLOCK_SZ);
+        this->last = *(uint32_t *) (header + HEADER_LAST);
+    }
+    fsm_open(flags);
+    if (this->last > 0) {
+        // new blocks have to match the ones already there
+        DbBlock *first = get(1);
+        this->layout = PaxPage::is_pax(*first->get_block()) ? PAX : SLOTTED_PAGE;
+        delete first;
+    }
+}
+
+/**
+ * Find a block in the mapped memory, mapping the segment it is in if need be.
+ * @param block_id  which block (0 for the header)
+ * @return          the block's memory
+ */
+char *MmapHeapFile::address(BlockID block_id) {
+    uint64_t offset = (uint64_t) block_id * this->block_size;
+    uint64_t segment = offset / SEGMENT_SZ;
+    if (segment >= this->segments.size())
+        this->segments.resize(segment + 1, nullptr);
+    if (this->segments[segment] == nullptr) {
+        // mapping past the end of the file is fine, so long as nothing there is touched before the file grows
+        void *mapped = mmap(nullptr, SEGMENT_SZ, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd,
+                            (off_t) (segment * SEGMENT_SZ));
+        if (mapped == MAP_FAILED)
+            system_failure("mmap " + this->path);
+        this->segments[segment] = (char *) mapped;
+    }
+    return this->segments[segment] + offset % SEGMENT_SZ;
+}
+
+/**
+ * Make sure the file is at least some size, growing it by at least a quarter if it has to grow.
+ * @param needed  bytes the file has to have
+ */
+void MmapHeapFile::grow(uint64_t needed) {
+    if (needed <= this->file_size)
+        return;
+    uint64_t size = max(needed, this->file_size + max(GROWTH_MIN_SZ, this->file_size / 4));
+    size = (size + GROWTH_MIN_SZ - 1) / GROWTH_MIN_SZ * GROWTH_MIN_SZ;
+    if (ftruncate(this->fd, (off_t) size) != 0)
+        system_failure("grow " + this->path);
+    this->file_size = size;
+}
+
+/**
+ * Let go of all the mappings.
+ */
+void MmapHeapFile::unmap() {
+    for (auto segment: this->segments)
+        if (segment != nullptr)
+            munmap(segment, SEGMENT_SZ);
+    this->segments.clear();
+}
+
+/**
+ * Shrink the file to just the blocks up to a given one (but no smaller than GROWTH_MIN_SZ). The mappings can stay,
+ * since nothing past the last block is touched until the file grows again.
+ * @param block_id  last block to keep
+ */
+void MmapHeapFile::cut_after(BlockID block_id) {
+    *(uint32_t *) (address(0) + HEADER_LAST) = block_id;
+    uint64_t size = max((uint64_t) (block_id + 1) * this->block_size, GROWTH_MIN_SZ);
+    size = (size + GROWTH_MIN_SZ - 1) / GROWTH_MIN_SZ * GROWTH_MIN_SZ;
+    if (size >= this->file_size)
+        return;
+    if (ftruncate(this->fd, (off_t) size) != 0)
+        system_failure("truncate " + this->path);
+    this->file_size = size;
+}
+
+/**
+ * Test MmapHeapFile: blocks go in and come back out, across growing the file and reopening it.
+ * @return true if the tests all succeeded
+ */
+bool test_mmap_heap_file() {
+    const uint N_BLOCKS = 600;  // a few extents' worth of 4K blocks
+    MmapHeapFile file("_test_mmap_heap_file");
+    file.create();
+    if (!MmapHeapFile::exists("_test_mmap_heap_file") || MmapHeapFile::exists("_test_mmap_heap_file_not"))
+        return assertion_failure("mmap file exists");
+    char bytes[100];
+    DbBlock *first = file.get(1);
+    for (BlockID block_id = 1; block_id <= N_BLOCKS; block_id++) {
+        DbBlock *block = block_id == 1 ? file.get(1) : file.get_new();
+        memset(bytes, 'a' + block_id % 26, sizeof(bytes));
+        Dbt data(bytes, sizeof(bytes) - block_id % 50);
+        block->add(&data);
+        file.put(block);
+        delete block;
+    }
+    DbBlock *again = file.get(1);
+    if (first->get_data() != again->get_data() || again->size() != 1 || file.get_last_block_id() != N_BLOCKS)
+        return assertion_failure("block got before the file grew");
+    delete again;
+    delete first;
+    file.close();
+
+    MmapHeapFile reopened("_test_mmap_heap_file", 8192);  // block size comes from the file
+    reopened.open();
+    if (reopened.get_block_size() != DbBlock::BLOCK_SZ || reopened.get_last_block_id() != N_BLOCKS)
+        return assertion_failure("mmap file header");
+    for (BlockID block_id = 1; block_id <= N_BLOCKS; block_id++) {
+        DbBlock *block = reopened.get(block_id);
+        u_int16_t size;
+        const char *record = block->view(1, size);
+        if (record == nullptr || size != sizeof(bytes) - block_id % 50 || record[size - 1] != (char) ('a' + block_id % 26))
+            return assertion_failure("mmap block", block_id);
+        delete block;
+    }
+    if (reopened.find_free_block(1000) == 0)
+        return assertion_failure("mmap free-space map");
+    reopened.drop();
+    if (MmapHeapFile::exists("_test_mmap_heap_file"))
+        return assertion_failure("mmap file dropped");
+    return true;
+}
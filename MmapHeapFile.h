@@ -0,0 +1,94 @@
+/**
+ * @file MmapHeapFile.h - Heap file kept in a plain memory-mapped file instead of Berkeley DB.
+ * MmapHeapFile: HeapFile
+ *
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <vector>
+#include "HeapFile.h"
+
+/**
+ * @class MmapHeapFile - heap file whose blocks live in a plain file that is memory-mapped
+ *
+ *      The blocks are kept in <name>.mmap in the database environment's directory, one after another at
+        multiples of the block size, and get and put work right on the mapped memory: there is no Berkeley DB
+        get or put, and no copy into a buffer pool frame. Changed blocks are written back by the operating
+        system, and all of them are flushed with msync when the file is closed.
+        Block 0 is a header rather than a block of records:
+            Bytes 0x00 - 0x03: MAGIC
+            Bytes 0x04 - 0x07: block size
+            Bytes 0x08 - 0x0B: number of blocks in use (the last block id)
+        The file is grown with ftruncate in extents (a quarter of its size, but at least GROWTH_MIN_SZ), and is
+        mapped in SEGMENT_SZ pieces as it reaches them, so blocks never move once mapped and a DbBlock got
+        before the file grew is still good afterwards.
+        Everything else (block layout, free-space map) is as for HeapFile. Blocks can't be compressed.
+ */
+class MmapHeapFile : public HeapFile {
+public:
+    /**
+     * Marks the header of an MmapHeapFile.
+     */
+    static const uint32_t MAGIC = 0x464d484d;  // "MHMF"
+
+    MmapHeapFile(std::string name, uint block_size = DbBlock::BLOCK_SZ, BlockLayout layout = SLOTTED_PAGE,
+                 const ColumnAttributes &column_attributes = ColumnAttributes());
+
+    virtual ~MmapHeapFile();
+
+    MmapHeapFile(const MmapHeapFile &other) = delete;
+
+    MmapHeapFile(MmapHeapFile &&temp) = delete;
+
+    MmapHeapFile &operator=(const MmapHeapFile &other) = delete;
+
+    MmapHeapFile &operator=(MmapHeapFile &&temp) = delete;
+
+    virtual void create(void);
+
+    virtual void drop(void);
+
+    virtual void open(void);
+
+    virtual void close(void);
+
+    virtual DbBlock *get_new(void);
+
+    virtual DbBlock *get(BlockID block_id);
+
+    virtual void put(DbBlock *block);
+
+    virtual BlockScan *scan_blocks();
+
+    /**
+     * Check if there is an MmapHeapFile for the given name (as opposed to a Berkeley DB one or none).
+     * @param name  name the file would have been constructed with
+     * @returns     true if there is one
+     */
+    static bool exists(std::string name);
+
+protected:
+    static const uint64_t SEGMENT_SZ = 64 * 1024 * 1024;  // how much of the file each mapping covers
+    static const uint64_t GROWTH_MIN_SZ = 1024 * 1024;    // least the file grows by at a time
+
+    std::string path;
+    int fd;
+    uint64_t file_size;
+    std::vector<char *> segments;  // mapping of each SEGMENT_SZ piece of the file (null until needed)
+
+    static std::string path_for(std::string name);
+
+    virtual void db_open(uint flags = 0);
+
+    virtual char *address(BlockID block_id);
+
+    virtual void grow(uint64_t needed);
+
+    virtual void unmap();
+
+    virtual void cut_after(BlockID block_id);
+};
+
+bool test_mmap_heap_file();
@@ -339,6 +339,26 @@ string ParseTreeToString::del(const DeleteStatement *stmt) {
     return ret;
 }
 
+string ParseTreeToString::update(const UpdateStatement *stmt) {
+    string ret("UPDATE ");
+    ret += table_ref(stmt->table);
+    ret += " SET ";
+    bool doComma = false;
+    for (auto const &clause: *stmt->updates) {
+        if (doComma)
+            ret += ", ";
+        ret += clause->column;
+        ret += " = ";
+        ret += expression(clause->value);
+        doComma = true;
+    }
+    if (stmt->where != NULL) {
+        ret += " WHERE ";
+        ret += expression(stmt->where);
+    }
+    return ret;
+}
+
 string ParseTreeToString::statement(const SQLStatement *stmt) {
     switch (stmt->type()) {
         case kStmtSelect:
@@ -347,6 +367,8 @@ string ParseTreeToString::statement(const SQLStatement *stmt) {
             return insert((const InsertStatement *) stmt);
         case kStmtDelete:
             return del((const DeleteStatement *) stmt);
+        case kStmtUpdate:
+            return update((const UpdateStatement *) stmt);
         case kStmtCreate:
             return create((const CreateStatement *) stmt);
         case kStmtDrop:
@@ -356,7 +378,6 @@ string ParseTreeToString::statement(const SQLStatement *stmt) {
 
         case kStmtError:
         case kStmtImport:
-        case kStmtUpdate:
         case kStmtPrepare:
         case kStmtExecute:
         case kStmtExport:
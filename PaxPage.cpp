@@ -0,0 +1,660 @@
+/**
+ * @file PaxPage.cpp
+ * @author K Lundeen
+ * @see Seattle University, CPSC5300
+ */
+#include <cstring>
+#include "PaxPage.h"
+#include "SlottedPage.h"
+#include "RowFormat.h"
+
+using namespace std;
+typedef uint16_t u16;
+
+/**
+ * PaxPage constructor
+ * @param block
+ * @param block_id
+ * @param column_attributes  the table's columns (must outlive the block)
+ * @param is_new
+ */
+PaxPage::PaxPage(Dbt &block, BlockID block_id, const ColumnAttributes &column_attributes, bool is_new)
+        : DbBlock(block, block_id, is_new), column_attributes(column_attributes), row_buffer(nullptr) {
+    if (is_new) {
+        this->num_records = 0;
+        this->end_free = (u16) (get_block_size() - 1);
+        this->fragmented = 0;
+        this->flags = PAX_LAYOUT;
+        this->num_live = 0;
+        this->capacity = 0;
+        this->num_columns = (u16) column_attributes.size();
+        this->free_slot = 0;
+        for (uint col_num = 0; col_num < this->num_columns; col_num++)
+            column_width(col_num);  // check that we know how to store each of them
+        put_header();
+    } else {
+        this->num_records = get_n(0);
+        this->end_free = get_n(2);
+        this->fragmented = get_n(4);
+        this->flags = get_n(6);
+        this->num_live = get_n(8);
+        this->capacity = get_n(10);
+        this->num_columns = get_n(12);
+        this->free_slot = get_n(14);
+        if (this->num_columns != column_attributes.size())
+            throw DbRelationError("PAX block does not have the table's columns");
+    }
+}
+
+PaxPage::~PaxPage() {
+    delete[] this->row_buffer;
+}
+
+/**
+ * Add a new record to the block. Reuses the id of a deleted record, if there is one.
+ * @param data  the record, marshaled as a row
+ * @return the new record's id
+ */
+RecordID PaxPage::add(const Dbt *data) {
+    u16 text_size = text_bytes(data);
+    RecordID id = 0;
+    if (this->num_live < this->num_records)
+        for (RecordID record_id = this->free_slot == 0 ? 1 : this->free_slot; record_id <= this->num_records && id == 0;
+             record_id++)
+            if (!is_live(record_id))
+                id = record_id;
+    if (id == 0 && this->num_records == this->capacity)
+        grow(text_size);  // mini-pages are full
+    if (text_size > contiguous_bytes()) {
+        if (text_size > unused_bytes())
+            throw DbBlockNoRoomError("not enough room for new record");
+        compact();  // the room is there, but it is fragmented
+    }
+    if (id == 0)
+        id = ++this->num_records;
+    this->num_live++;
+    this->free_slot = this->num_live < this->num_records ? (u16) (id + 1) : (u16) 0;  // ids before it are live
+    store(id, data);
+    put_header();
+    return id;
+}
+
+/**
+ * Get a record from the block, put back together as a row.
+ * @param record_id
+ * @return the bits of the record, or nullptr if it has been deleted (the Dbt is freed by caller,
+ *         its data belongs to the block and is only good until the next get or view)
+ */
+Dbt *PaxPage::get(RecordID record_id) const {
+    u16 size;
+    const char *bytes = view(record_id, size);
+    if (bytes == nullptr)
+        return nullptr;
+    return new Dbt((void *) bytes, size);
+}
+
+/**
+ * Look at a record, put back together as a row. Unlike SlottedPage, this copies, since the values
+ * are not next to each other in the block.
+ * @param record_id
+ * @param size       set to the record's size
+ * @return the bits of the record, or nullptr if it has been deleted (not to be freed, and only good
+ *         until the next get or view)
+ */
+const char *PaxPage::view(RecordID record_id, u16 &size) const {
+    if (!is_live(record_id))
+        return nullptr;
+    if (this->row_buffer == nullptr)
+        this->row_buffer = new char[get_block_size()];
+    u16 fixed, texts;
+    row_layout(fixed, texts);
+    uint offset = 0, directory = fixed, end = fixed + texts * sizeof(u16);
+    for (uint col_num = 0; col_num < this->num_columns; col_num++) {
+        const char *value = entry(col_num, record_id);
+        if (this->column_attributes[col_num].get_data_type() == ColumnAttribute::DataType::TEXT) {
+            u16 text_size = *(u16 *) value;
+            u16 stored = stored_size(text_size);
+            memcpy(this->row_buffer + end, this->address(*(u16 *) (value + 2)), stored);
+            end += stored;
+            u16 toasted = text_size == RowFormat::TOASTED ? RowFormat::TOASTED_END : 0;
+            *(u16 *) (this->row_buffer + directory) = (u16) (end | toasted);
+            directory += sizeof(u16);
+        } else {
+            u16 width = column_width(col_num);
+            memcpy(this->row_buffer + offset, value, width);
+            offset += width;
+        }
+    }
+    size = (u16) end;
+    return this->row_buffer;
+}
+
+/**
+ * Look at one column of a record where it sits in its mini-page.
+ * @param record_id
+ * @param col_num
+ * @param size       set to the value's size (RowFormat::TOASTED for an out-of-line TEXT pointer)
+ * @return the bits of the value, or nullptr if the record has been deleted (not to be freed)
+ */
+const char *PaxPage::view_column(RecordID record_id, uint col_num, u16 &size) const {
+    if (!is_live(record_id))
+        return nullptr;
+    const char *value = entry(col_num, record_id);
+    if (this->column_attributes[col_num].get_data_type() == ColumnAttribute::DataType::TEXT) {
+        size = *(u16 *) value;
+        return (const char *) this->address(*(u16 *) (value + 2));
+    }
+    size = column_width(col_num);
+    return value;
+}
+
+/**
+ * Replace the record with the given data.
+ * @param record_id   record to replace
+ * @param data        new contents of record_id, marshaled as a row
+ * @throws DbBlockNoRoomError if it won't fit (old record is retained)
+ * @throws DbBlockError if the record has been deleted
+ */
+void PaxPage::put(RecordID record_id, const Dbt &data) {
+    if (!is_live(record_id))
+        throw DbBlockError("cannot put a deleted record");
+    u16 text_size = text_bytes(&data);
+    u16 old_text_size = text_bytes(record_id);
+    if (text_size > unused_bytes() + old_text_size)
+        throw DbBlockNoRoomError("not enough room for enlarged record");
+    // the old text is now fragmented (and the record is out of the way if we have to compact)
+    *(uint8_t *) this->address((u16) (HEADER_SZ + record_id - 1)) = 0;
+    this->fragmented += old_text_size;
+    if (text_size > contiguous_bytes())
+        compact();
+    store(record_id, &data);
+    put_header();
+}
+
+/**
+ * Mark the given id as deleted. Its text is left where it is until the room is needed.
+ * @param record_id
+ */
+void PaxPage::del(RecordID record_id) {
+    if (!is_live(record_id))
+        return;
+    this->fragmented += text_bytes(record_id);
+    *(uint8_t *) this->address((u16) (HEADER_SZ + record_id - 1)) = 0;
+    this->num_live--;
+    if (this->free_slot == 0 || record_id < this->free_slot)
+        this->free_slot = record_id;
+    put_header();
+}
+
+/**
+ * Sequence of all non-deleted record IDs.
+ * @return  sequence of IDs (freed by caller)
+ */
+RecordIDs *PaxPage::ids(void) const {
+    RecordIDs *vec = new RecordIDs();
+    for (RecordID record_id = 1; record_id <= this->num_records; record_id++)
+        if (is_live(record_id))
+            vec->push_back(record_id);
+    return vec;
+}
+
+/**
+ * Erase all the records
+ */
+void PaxPage::clear() {
+    this->num_records = 0;
+    this->end_free = (u16) (get_block_size() - 1);
+    this->fragmented = 0;
+    this->num_live = 0;
+    this->capacity = 0;
+    this->free_slot = 0;
+    put_header();
+}
+
+/**
+ * Count of non-deleted records (kept in the block header).
+ * @return number of current records
+ */
+u16 PaxPage::size() const {
+    return this->num_live;
+}
+
+/**
+ * Get the number of bytes not currently used to store data or for overhead.
+ * Includes fragmented bytes, which can be reclaimed by compaction.
+ * @return number of bytes
+ */
+u16 PaxPage::unused_bytes() const {
+    return contiguous_bytes() + this->fragmented;
+}
+
+/**
+ * Check the flags in the block header for PAX_LAYOUT.
+ * @param block
+ * @return true if the block is a PaxPage
+ */
+bool PaxPage::is_pax(const Dbt &block) {
+    if (block.get_size() < HEADER_SZ)
+        return false;
+    return (*(u16 *) ((char *) block.get_data() + 6) & PAX_LAYOUT) != 0;
+}
+
+/**
+ * Store the block header.
+ */
+void PaxPage::put_header() {
+    put_n(0, this->num_records);
+    put_n(2, this->end_free);
+    put_n(4, this->fragmented);
+    put_n(6, this->flags);
+    put_n(8, this->num_live);
+    put_n(10, this->capacity);
+    put_n(12, this->num_columns);
+    put_n(14, this->free_slot);
+}
+
+/**
+ * Size of each entry in a column's mini-page.
+ * @param col_num
+ * @return number of bytes per record
+ */
+u16 PaxPage::column_width(uint col_num) const {
+    switch (this->column_attributes[col_num].get_data_type()) {
+        case ColumnAttribute::DataType::INT:
+            return sizeof(int32_t);
+        case ColumnAttribute::DataType::TEXT:
+            return 2 * sizeof(u16);  // size and offset of the text
+        case ColumnAttribute::DataType::BOOLEAN:
+            return sizeof(uint8_t);
+        default:
+            throw DbRelationError("Only know how to store INT, TEXT, and BOOLEAN");
+    }
+}
+
+/**
+ * Where a column's mini-page starts when the mini-pages have the given capacity.
+ * For col_num of num_columns, it is the end of the last mini-page.
+ * @param col_num
+ * @param capacity
+ * @return offset in the block
+ */
+u16 PaxPage::column_offset(uint col_num, u16 capacity) const {
+    uint width = sizeof(uint8_t);  // the status mini-page comes first
+    for (uint i = 0; i < col_num; i++)
+        width += column_width(i);
+    return (u16) (HEADER_SZ + capacity * width);
+}
+
+/**
+ * Address of a record's entry in a column's mini-page.
+ * @param col_num
+ * @param record_id
+ * @return pointer into the block
+ */
+char *PaxPage::entry(uint col_num, RecordID record_id) const {
+    return (char *) this->address(
+            (u16) (column_offset(col_num, this->capacity) + (record_id - 1) * column_width(col_num)));
+}
+
+/**
+ * Check the status mini-page for the given record.
+ * @param record_id
+ * @return true if the record is there and has not been deleted
+ */
+bool PaxPage::is_live(RecordID record_id) const {
+    if (record_id == 0 || record_id > this->num_records)
+        return false;
+    return *(uint8_t *) this->address((u16) (HEADER_SZ + record_id - 1)) != 0;
+}
+
+/**
+ * Get the number of bytes between the end of the mini-pages and the text.
+ * @return number of bytes
+ */
+u16 PaxPage::contiguous_bytes() const {
+    u16 mini_pages = column_offset(this->num_columns, this->capacity);
+    if (this->end_free < mini_pages)
+        return 0;
+    return this->end_free - mini_pages + 1U;
+}
+
+/**
+ * Check that the given row matches our columns and figure out how much text it has.
+ * @param data  the record, marshaled as a row
+ * @return total size of the TEXT values
+ * @throws DbRelationError if the record does not match our columns
+ */
+u16 PaxPage::text_bytes(const Dbt *data) const {
+    const char *bytes = (const char *) data->get_data();
+    uint size = data->get_size();
+    u16 fixed, texts;
+    row_layout(fixed, texts);
+    uint text_start = fixed + texts * sizeof(u16), end = text_start;
+    bool matches = size >= text_start;
+    for (uint i = 0; matches && i < texts; i++) {
+        u16 text_end = *(u16 *) (bytes + fixed + i * sizeof(u16));
+        uint next = text_end & ~RowFormat::TOASTED_END;
+        matches = next >= end && next <= size
+                  && ((text_end & RowFormat::TOASTED_END) == 0 || next - end == RowFormat::TOAST_POINTER_SZ);
+        end = next;
+    }
+    if (!matches || end != size)
+        throw DbRelationError("record does not match the PAX block's columns");
+    return (u16) (end - text_start);
+}
+
+/**
+ * Figure out how much text the given record has in the block.
+ * @param record_id
+ * @return total size of its TEXT values
+ */
+u16 PaxPage::text_bytes(RecordID record_id) const {
+    uint text_size = 0;
+    for (uint col_num = 0; col_num < this->num_columns; col_num++)
+        if (this->column_attributes[col_num].get_data_type() == ColumnAttribute::DataType::TEXT)
+            text_size += stored_size(*(u16 *) entry(col_num, record_id));
+    return (u16) text_size;
+}
+
+/**
+ * How many bytes of the free space a TEXT value takes.
+ * @param text_size  size from the row
+ * @return the text size, or the size of the pointer if the text is out of line
+ */
+u16 PaxPage::stored_size(u16 text_size) {
+    return text_size == RowFormat::TOASTED ? (u16) RowFormat::TOAST_POINTER_SZ : text_size;
+}
+
+/**
+ * Figure out where things are in a marshaled row: the fixed-width columns, then a directory of the end offset of
+ * each TEXT value, then the text (see RowFormat).
+ * @param fixed  set to the size of the fixed-width columns (so where the directory starts)
+ * @param texts  set to the number of TEXT columns
+ */
+void PaxPage::row_layout(u16 &fixed, u16 &texts) const {
+    fixed = texts = 0;
+    for (uint col_num = 0; col_num < this->num_columns; col_num++)
+        if (this->column_attributes[col_num].get_data_type() == ColumnAttribute::DataType::TEXT)
+            texts++;
+        else
+            fixed += column_width(col_num);
+}
+
+/**
+ * Split up a row into the mini-pages for the given record id, putting its text into the free space.
+ * Assumes the room is there (and contiguous).
+ * @param record_id
+ * @param data       the record, marshaled as a row
+ */
+void PaxPage::store(RecordID record_id, const Dbt *data) {
+    const char *bytes = (const char *) data->get_data();
+    u16 fixed, texts;
+    row_layout(fixed, texts);
+    uint offset = 0, directory = fixed, begin = fixed + texts * sizeof(u16);
+    for (uint col_num = 0; col_num < this->num_columns; col_num++) {
+        char *value = entry(col_num, record_id);
+        if (this->column_attributes[col_num].get_data_type() == ColumnAttribute::DataType::TEXT) {
+            u16 text_end = *(u16 *) (bytes + directory);
+            directory += sizeof(u16);
+            u16 end = text_end & ~RowFormat::TOASTED_END;
+            u16 stored = (u16) (end - begin);
+            this->end_free -= stored;
+            u16 loc = this->end_free + 1U;
+            memcpy(this->address(loc), bytes + begin, stored);
+            begin = end;
+            *(u16 *) value = (text_end & RowFormat::TOASTED_END) ? RowFormat::TOASTED : stored;
+            *(u16 *) (value + 2) = loc;
+        } else {
+            u16 width = column_width(col_num);
+            memcpy(value, bytes + offset, width);
+            offset += width;
+        }
+    }
+    *(uint8_t *) this->address((u16) (HEADER_SZ + record_id - 1)) = 1;
+}
+
+/**
+ * Spread out the mini-pages to make room for more records, sizing them for the average record so far.
+ * @param text_size  amount of text in the record about to be added (which also has to fit)
+ * @throws DbBlockNoRoomError if there isn't room for even one more record
+ */
+void PaxPage::grow(u16 text_size) {
+    uint room = unused_bytes();
+    uint width = column_offset(this->num_columns, 1) - HEADER_SZ;  // mini-page bytes per record
+    if (width + text_size > room)
+        throw DbBlockNoRoomError("not enough room for new record");
+
+    uint text_used = get_block_size() - 1U - this->end_free - this->fragmented;
+    uint average = width + (this->num_live > 0 ? text_used / this->num_live : text_size);
+    uint wanted = (get_block_size() - HEADER_SZ) / average;
+    uint most = this->capacity + (room - text_size) / width;
+    // grow by at least a quarter, but no more than double, so one odd record doesn't throw us off
+    uint new_capacity = this->capacity + this->capacity / 4U + 1U;
+    if (wanted > new_capacity)
+        new_capacity = wanted;
+    if (new_capacity > 2U * this->capacity + 8U)
+        new_capacity = 2U * this->capacity + 8U;
+    if (new_capacity > most)
+        new_capacity = most;
+    if (new_capacity > UINT16_MAX)
+        new_capacity = UINT16_MAX;
+
+    if (column_offset(this->num_columns, (u16) new_capacity) > this->end_free + 1U)
+        compact();
+    for (uint col_num = this->num_columns; col_num-- > 0;)  // last first, so nothing is overwritten
+        memmove(this->address(column_offset(col_num, (u16) new_capacity)),
+                this->address(column_offset(col_num, this->capacity)),
+                this->capacity * column_width(col_num));
+    this->capacity = (u16) new_capacity;
+    put_header();
+}
+
+/**
+ * Squeeze out all the fragmented bytes by repacking the text of every live record against the end
+ * of the block. The mini-pages don't move.
+ */
+void PaxPage::compact() {
+    char packed[DbBlock::MAX_BLOCK_SZ];
+    u16 end = (u16) (get_block_size() - 1);
+    for (RecordID record_id = 1; record_id <= this->num_records; record_id++) {
+        if (!is_live(record_id))
+            continue;
+        for (uint col_num = 0; col_num < this->num_columns; col_num++) {
+            if (this->column_attributes[col_num].get_data_type() != ColumnAttribute::DataType::TEXT)
+                continue;
+            char *value = entry(col_num, record_id);
+            u16 text_size = stored_size(*(u16 *) value);
+            end -= text_size;
+            memcpy(packed + end + 1, this->address(*(u16 *) (value + 2)), text_size);
+            *(u16 *) (value + 2) = (u16) (end + 1U);
+        }
+    }
+    memcpy(this->address((u16) (end + 1U)), packed + end + 1, get_block_size() - 1U - end);
+    this->end_free = end;
+    this->fragmented = 0;
+    put_header();
+}
+
+/**
+ * Get 2-byte integer at given offset in block.
+ */
+u16 PaxPage::get_n(u16 offset) const {
+    return *(u16 *) this->address(offset);
+}
+
+/**
+ * Put a 2-byte integer at given offset in block.
+ * @param offset number of bytes into the page
+ * @param n
+ */
+void PaxPage::put_n(u16 offset, u16 n) {
+    *(u16 *) this->address(offset) = n;
+}
+
+/**
+ * Make a void* pointer for a given offset into the data block.
+ * @param offset
+ * @return
+ */
+void *PaxPage::address(u16 offset) const {
+    return (void *) ((char *) this->block.get_data() + offset);
+}
+
+/**
+ * Test helper. Marshal an (INT, TEXT, BOOLEAN) row the way HeapTable does.
+ * @param bytes  where to put it (big enough)
+ * @param a
+ * @param b
+ * @return the record
+ */
+static Dbt test_pax_record(char *bytes, int32_t a, string b) {
+    *(int32_t *) bytes = a;
+    *(uint8_t *) (bytes + 4) = (uint8_t) (a % 2 == 0);
+    *(u16 *) (bytes + 5) = (u16) (7 + b.size());
+    memcpy(bytes + 7, b.c_str(), b.size());
+    return Dbt(bytes, (u_int32_t) (7 + b.size()));
+}
+
+/**
+ * Test helper. Check that a record is there with the given values, as a whole and by column.
+ */
+static bool test_pax_check(const PaxPage &page, RecordID id, int32_t a, string b) {
+    char bytes[DbBlock::BLOCK_SZ];
+    Dbt expected = test_pax_record(bytes, a, b);
+    u16 size;
+    const char *actual = page.view(id, size);
+    if (actual == nullptr || size != expected.get_size() || memcmp(actual, bytes, size) != 0)
+        return false;
+    actual = page.view_column(id, 0, size);
+    if (size != 4 || *(int32_t *) actual != a)
+        return false;
+    actual = page.view_column(id, 1, size);
+    if (size != b.size() || string(actual, size) != b)
+        return false;
+    actual = page.view_column(id, 2, size);
+    return size == 1 && *(uint8_t *) actual == (a % 2 == 0);
+}
+
+/**
+ * Testing function for PaxPage.
+ * @return true if testing succeeded, false otherwise
+ */
+bool test_pax_page() {
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::BOOLEAN));
+    char blank_space[DbBlock::BLOCK_SZ];
+    Dbt block_dbt(blank_space, sizeof(blank_space));
+    PaxPage page(block_dbt, 1, column_attributes, true);
+    if (!PaxPage::is_pax(block_dbt))
+        return assertion_failure("new block not marked as PAX");
+    char bytes[DbBlock::BLOCK_SZ];
+
+    // add, view, view_column
+    Dbt record = test_pax_record(bytes, 12, "hello");
+    if (page.add(&record) != 1)
+        return assertion_failure("add id 1");
+    record = test_pax_record(bytes, 13, "goodbye");
+    if (page.add(&record) != 2)
+        return assertion_failure("add id 2");
+    if (!test_pax_check(page, 1, 12, "hello") || !test_pax_check(page, 2, 13, "goodbye"))
+        return assertion_failure("view back");
+    Dbt *got = page.get(2);
+    if (got == nullptr || got->get_size() != 7 + 7 || *(int32_t *) got->get_data() != 13)
+        return assertion_failure("get back");
+    delete got;
+
+    // put (bigger and smaller)
+    record = test_pax_record(bytes, 14, "hello again, this is longer");
+    page.put(1, record);
+    if (!test_pax_check(page, 1, 14, "hello again, this is longer") || !test_pax_check(page, 2, 13, "goodbye"))
+        return assertion_failure("expanding put");
+    record = test_pax_record(bytes, 16, "");
+    page.put(1, record);
+    if (!test_pax_check(page, 1, 16, "") || !test_pax_check(page, 2, 13, "goodbye"))
+        return assertion_failure("contracting put");
+
+    // del and id reuse
+    page.del(1);
+    u16 size;
+    if (page.view(1, size) != nullptr || page.view_column(1, 0, size) != nullptr || page.get(1) != nullptr)
+        return assertion_failure("view of deleted record was not null");
+    if (page.size() != 1)
+        return assertion_failure("size() after del", page.size());
+    try {
+        page.put(1, record);
+        return assertion_failure("put of deleted record");
+    } catch (DbBlockError &e) {
+        // expected
+    }
+    record = test_pax_record(bytes, 18, "reused");
+    if (page.add(&record) != 1 || !test_pax_check(page, 1, 18, "reused"))
+        return assertion_failure("add did not reuse deleted id");
+
+    // records that don't match the columns
+    try {
+        Dbt short_record(bytes, 5);
+        page.add(&short_record);
+        return assertion_failure("mismatched record was accepted");
+    } catch (DbRelationError &e) {
+        // expected
+    }
+    try {
+        page.set_marked(1, true);
+        return assertion_failure("PAX record marked");
+    } catch (DbBlockError &e) {
+        // expected
+    }
+
+    // fill it up, which spreads out the mini-pages a number of times
+    page.clear();
+    RecordID id = 0;
+    try {
+        while (true) {
+            int32_t a = (int32_t) id * 3;
+            record = test_pax_record(bytes, a, string((size_t) (id % 50), (char) ('a' + id % 26)));
+            if (page.add(&record) != ++id)
+                return assertion_failure("fill add id", id);
+        }
+    } catch (DbBlockNoRoomError &e) {
+        // page is full
+    }
+    if (id < 100 || page.get_capacity() < id)
+        return assertion_failure("fill count", id, page.get_capacity());
+    for (RecordID i = 1; i <= id; i++)
+        if (!test_pax_check(page, i, (int32_t) (i - 1) * 3, string((size_t) ((i - 1) % 50), (char) ('a' + (i - 1) % 26))))
+            return assertion_failure("fill data", i);
+
+    // free up text from every other record, then a big one needs a compaction
+    for (RecordID i = 1; i <= id; i += 2)
+        page.del(i);
+    string big(400, 'z');
+    record = test_pax_record(bytes, 1000, big);
+    if (page.add(&record) != 1 || !test_pax_check(page, 1, 1000, big))
+        return assertion_failure("add after del did not compact");
+    for (RecordID i = 2; i <= id; i += 2)
+        if (!test_pax_check(page, i, (int32_t) (i - 1) * 3, string((size_t) ((i - 1) % 50), (char) ('a' + (i - 1) % 26))))
+            return assertion_failure("compaction lost data", i);
+
+    // read back from the bytes
+    PaxPage reread(block_dbt, 1, column_attributes);
+    if (reread.size() != page.size() || !test_pax_check(reread, 1, 1000, big))
+        return assertion_failure("reread");
+
+    // the deleted ids are reused lowest first, picking up where the last add left off, even in a reread block
+    record = test_pax_record(bytes, 3000, "again");
+    if (reread.add(&record) != 3 || reread.add(&record) != 5)
+        return assertion_failure("free slot after reread");
+    reread.del(2);
+    if (reread.add(&record) != 2 || reread.add(&record) != 7 || !test_pax_check(reread, 4, 9, string(3, 'd')))
+        return assertion_failure("free slot after del");
+
+    // a slotted page is not PAX
+    char slotted_space[DbBlock::BLOCK_SZ];
+    Dbt slotted_dbt(slotted_space, sizeof(slotted_space));
+    SlottedPage slotted(slotted_dbt, 1, true, true);
+    if (PaxPage::is_pax(slotted_dbt))
+        return assertion_failure("slotted page marked as PAX");
+    return true;
+}
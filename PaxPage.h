@@ -0,0 +1,151 @@
+/**
+ * @file PaxPage.h - Implementation of DbBlock with the columns of each record stored apart.
+ * PaxPage: DbBlock
+ *
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include "storage_engine.h"
+
+/**
+ * @class PaxPage - column-grouped (PAX) implementation of DbBlock.
+ *
+ *      Manage a database block that contains several records, with the values of each column kept
+        together in their own mini-page instead of the values of each record kept together.
+        Modeled after PAX from Ailamaki, et al., "Weaving Relations for Cache Performance", VLDB 2001.
+
+        Records come in (and go out, with get and view) marshaled the way HeapTable marshals a row (see RowFormat),
+        and the block splits them up by column, so it has to be given the table's column attributes.
+        Record ids are handed out sequentially starting with 1, except that the ids of deleted records are
+        handed out again first. Ids of live records never change.
+            Bytes 0x00 - Ox01: number of records (including deleted ones)
+            Bytes 0x02 - 0x03: offset to end of free space
+            Bytes 0x04 - 0x05: number of fragmented bytes (freed by del/put but not yet compacted)
+            Bytes 0x06 - 0x07: flags (always includes PAX_LAYOUT)
+            Bytes 0x08 - 0x09: number of live (undeleted) records
+            Bytes 0x0A - 0x0B: capacity, the number of records the mini-pages have room for
+            Bytes 0x0C - 0x0D: number of columns
+            Bytes 0x0E - 0x0F: free slot, the lowest record id that may be deleted (0 if none are), so add
+                               doesn't have to look through all the records for one to reuse
+        Then come the mini-pages, each an array with capacity entries: first a status byte per record
+        (non-zero if live), then one mini-page per column in column order. INT entries are the 4-byte value,
+        BOOLEAN entries are the 1-byte value, and TEXT entries are the 2-byte size and 2-byte offset of the
+        text, which is kept in the free space at the end of the block (just like SlottedPage records).
+        A TEXT value that HeapTable has put out of line (marked RowFormat::TOASTED_END in the row) gets the
+        RowFormat::TOASTED size, and its pointer is kept in place of the text.
+
+        The mini-pages are sized from the average record seen so far; when they fill up they are spread out
+        to make room for more records. Text freed by del/put is compacted only when the room is needed.
+ *
+ */
+class PaxPage : public DbBlock {
+public:
+    /**
+     * Page header flag marking a block as a PaxPage. (SlottedPage never sets this bit.)
+     */
+    static const uint16_t PAX_LAYOUT = 0x8000;
+
+    PaxPage(Dbt &block, BlockID block_id, const ColumnAttributes &column_attributes, bool is_new = false);
+
+    virtual ~PaxPage();
+
+    PaxPage(const PaxPage &other) = delete;
+
+    PaxPage(PaxPage &&temp) = delete;
+
+    PaxPage &operator=(const PaxPage &other) = delete;
+
+    PaxPage &operator=(PaxPage &&temp) = delete;
+
+    virtual RecordID add(const Dbt *data);
+
+    virtual Dbt *get(RecordID record_id) const;
+
+    virtual const char *view(RecordID record_id, u_int16_t &size) const;
+
+    virtual void put(RecordID record_id, const Dbt &data);
+
+    virtual void del(RecordID record_id);
+
+    virtual RecordIDs *ids(void) const;
+
+    virtual void clear();
+
+    virtual u_int16_t size() const;
+
+    virtual u_int16_t unused_bytes() const;
+
+    /**
+     * Look at one column of a record in place, touching only that column's mini-page.
+     * @param record_id  which record to look at
+     * @param col_num    which column (in the order of the table's column attributes)
+     * @param size       set to the number of bytes in the value (for TEXT, just the characters)
+     * @returns          pointer to the value within this block, or nullptr if the record has been deleted
+     */
+    virtual const char *view_column(RecordID record_id, uint col_num, u_int16_t &size) const;
+
+    /**
+     * Get the number of records the mini-pages currently have room for.
+     * @returns  capacity in records
+     */
+    virtual u_int16_t get_capacity() const { return this->capacity; }
+
+    /**
+     * Check if a block read from a file is laid out as a PaxPage.
+     * @param block  the block's memory
+     * @returns      true if it is a PaxPage, false if it is (presumably) a SlottedPage
+     */
+    static bool is_pax(const Dbt &block);
+
+protected:
+    static const uint16_t HEADER_SZ = 16;  // size of the block header (before the mini-pages)
+
+    const ColumnAttributes &column_attributes;
+    uint16_t num_records;
+    uint16_t end_free;
+    uint16_t fragmented;
+    uint16_t flags;
+    uint16_t num_live;
+    uint16_t capacity;
+    uint16_t num_columns;
+    uint16_t free_slot;
+    mutable char *row_buffer;  // where view puts records back together (allocated on first use)
+
+    void put_header();
+
+    uint16_t column_width(uint col_num) const;
+
+    uint16_t column_offset(uint col_num, uint16_t capacity) const;
+
+    char *entry(uint col_num, RecordID record_id) const;
+
+    bool is_live(RecordID record_id) const;
+
+    uint16_t contiguous_bytes() const;
+
+    uint16_t text_bytes(const Dbt *data) const;
+
+    uint16_t text_bytes(RecordID record_id) const;
+
+    static uint16_t stored_size(uint16_t text_size);
+
+    void row_layout(uint16_t &fixed, uint16_t &texts) const;
+
+    void store(RecordID record_id, const Dbt *data);
+
+    void grow(uint16_t text_size);
+
+    virtual void compact();
+
+    uint16_t get_n(uint16_t offset) const;
+
+    void put_n(uint16_t offset, uint16_t n);
+
+    void *address(uint16_t offset) const;
+
+    friend bool test_pax_page();
+};
+
+bool test_pax_page();
@@ -0,0 +1,31 @@
+/**
+ * @file RowFormat.h - Layout of a marshaled row, shared by HeapTable (which marshals rows) and PaxPage (which
+ * splits them up by column).
+ * RowFormat
+ *
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @class RowFormat - the parts of a marshaled row's layout that the blocks keeping it need to know
+ *
+ *      A marshaled row has the fixed-width (INT and BOOLEAN) columns first, in column order, then a directory
+        with the 2-byte offset of the end of each TEXT value, then the TEXT values one after another.
+        A TEXT value too big to keep in the row is kept out of line in the table's TOAST file (see HeapTable),
+        and the row has just a pointer to it.
+ */
+class RowFormat {
+public:
+    /**
+     * Flag on a TEXT column's end offset in a marshaled row that means the value is in the TOAST file. In place of
+     * the text, the row then has a TOAST_POINTER_SZ pointer: 4-byte length, 4-byte block id and 2-byte record id
+     * of the first chunk. (A PAX block keeps the value's size instead of its end, and marks it with TOASTED.)
+     */
+    static const uint16_t TOASTED_END = 0x8000;
+    static const uint16_t TOASTED = 0xFFFF;
+    static const unsigned int TOAST_POINTER_SZ = 10;
+};
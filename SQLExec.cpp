@@ -4,6 +4,8 @@
  * @see "Seattle University, CPSC5300, Spring 2022"
  */
 #include "SQLExec.h"
+#include <algorithm>
+#include <chrono>
 #include <vector>
 #include "EvalPlan.h"
 
@@ -69,22 +71,70 @@ QueryResult *SQLExec::execute(const SQLStatement *statement) {
     }
 
     try {
+        QueryResult *result;
         switch (statement->type()) {
             case kStmtCreate:
-                return create((const CreateStatement *) statement);
+                result = create((const CreateStatement *) statement);
+                break;
             case kStmtDrop:
-                return drop((const DropStatement *) statement);
+                result = drop((const DropStatement *) statement);
+                break;
             case kStmtShow:
-                return show((const ShowStatement *) statement);
+                result = show((const ShowStatement *) statement);
+                break;
             case kStmtInsert:
-                return insert((const InsertStatement *) statement);
+                result = insert((const InsertStatement *) statement);
+                break;
             case kStmtDelete:
-                return del((const DeleteStatement *) statement);
+                result = del((const DeleteStatement *) statement);
+                break;
+            case kStmtUpdate:
+                result = update((const UpdateStatement *) statement);
+                break;
             case kStmtSelect:
-                return select((const SelectStatement *) statement);
+                result = select((const SelectStatement *) statement);
+                break;
             default:
                 return new QueryResult("not implemented");
         }
+        // write out the zones and blocks the statement changed (they are only marked dirty until now)
+        Tables::checkpoint_tables();
+        SQLExec::indices->checkpoint();
+        if (_BUFFER_POOL != nullptr)
+            _BUFFER_POOL->checkpoint();
+        return result;
+    } catch (DbRelationError &e) {
+        throw SQLExecError(string("DbRelationError: ") + e.what());
+    }
+}
+
+QueryResult *SQLExec::vacuum(Identifier table_name) {
+    if (SQLExec::tables == nullptr) {
+        SQLExec::tables = new Tables();
+        SQLExec::indices = new Indices();
+    }
+
+    try {
+        HeapTable *table = dynamic_cast<HeapTable *>(&SQLExec::tables->get_table(table_name));
+        if (table == nullptr)
+            throw SQLExecError("can't vacuum " + table_name);
+        auto start = chrono::steady_clock::now();
+        table->open();
+        BlockID blocks = table->get_file().get_last_block_id();
+        map<Handle, Handle> moved;
+        BlockID reclaimed = table->vacuum(moved);
+        for (auto const &index_name: SQLExec::indices->get_index_names(table_name)) {
+            DbIndex &index = SQLExec::indices->get_index(table_name, index_name);
+            for (auto const &handles: moved)
+                index.move(handles.first, handles.second);
+        }
+        table->checkpoint();
+        if (_BUFFER_POOL != nullptr)
+            _BUFFER_POOL->checkpoint();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return new QueryResult("vacuumed " + table_name + ": " + to_string(reclaimed) + " of " + to_string(blocks)
+                               + " blocks reclaimed, " + to_string(moved.size()) + " rows moved, in "
+                               + to_string(ms) + " ms");
     } catch (DbRelationError &e) {
         throw SQLExecError(string("DbRelationError: ") + e.what());
     }
@@ -210,11 +260,15 @@ QueryResult *SQLExec::del(const DeleteStatement *statement) {
     EvalPlan *optimized = plan->optimize();
     delete plan;
     EvalPipeline pipeline = optimized->pipeline();
+    Handles *handles = new Handles();  // collect them all before deleting any
+    Handle handle;
+    while (pipeline.second->next(handle))
+        handles->push_back(handle);
+    delete pipeline.second;
     delete optimized;
 
     //delete handle
     IndexNames index_names = SQLExec::indices->get_index_names(table_name);
-    Handles *handles = pipeline.second;
     uint rows = 0;
     uint indices = index_names.size();
     for (auto const& handle: *handles) {
@@ -229,6 +283,110 @@ QueryResult *SQLExec::del(const DeleteStatement *statement) {
     return new QueryResult("successful deleted " + to_string(rows) + " rows from " + table_name); 
 }
 
+QueryResult *SQLExec::update(const UpdateStatement *statement) {
+    //get table name from SQL query
+    Identifier table_name = statement->table->name;
+    //get Table from Relation
+    DbRelation &table = SQLExec::tables->get_table(table_name);
+
+    //new values from the SET clause (only integer and string type), each of its column's type
+    ValueDict new_values;
+    ColumnNames table_columns = table.get_column_names();
+    ColumnAttributes column_attributes = table.get_column_attributes();
+    for (auto const &clause: *statement->updates) {
+        Identifier column_name = clause->column;
+        auto column = find(table_columns.begin(), table_columns.end(), column_name);
+        if (column == table_columns.end())
+            throw SQLExecError("unknown column " + column_name);
+        ColumnAttribute::DataType data_type = column_attributes[column - table_columns.begin()].get_data_type();
+        switch (clause->value->type) {
+            case kExprLiteralString:
+                if (data_type != ColumnAttribute::TEXT)
+                    throw SQLExecError("column " + column_name + " can't be set to a string");
+                new_values[column_name] = Value(clause->value->name);
+                break;
+            case kExprLiteralInt:
+                if (data_type != ColumnAttribute::INT)
+                    throw SQLExecError("column " + column_name + " can't be set to an integer");
+                new_values[column_name] = Value(int32_t(clause->value->ival));
+                break;
+            default:
+                throw SQLExecError("column " + column_name + " can only be set to an integer or a string");
+        }
+    }
+
+    EvalPlan *plan = new EvalPlan(table);
+    if (statement->where != nullptr)
+        plan = new EvalPlan(get_where_conjunction(statement->where), plan);
+    EvalPlan *optimized = plan->optimize();
+    delete plan;
+    EvalPipeline pipeline = optimized->pipeline();
+    Handles *handles = new Handles();  // collect them all before updating any
+    Handle handle;
+    while (pipeline.second->next(handle))
+        handles->push_back(handle);
+    delete pipeline.second;
+    delete optimized;
+
+    //an updated row keeps its handle, so only the indices on a column being set need their entries changed
+    vector<DbIndex *> changed_indices;
+    for (auto const &index_name: SQLExec::indices->get_index_names(table_name)) {
+        DbIndex &index = SQLExec::indices->get_index(table_name, index_name);
+        for (auto const &column_name: index.get_key_columns())
+            if (new_values.find(column_name) != new_values.end()) {
+                changed_indices.push_back(&index);
+                break;
+            }
+    }
+
+    ColumnNames set_columns;
+    for (auto const &column: new_values)
+        set_columns.push_back(column.first);
+    uint rows = 0;
+    for (auto const &handle: *handles) {
+        if (changed_indices.empty()) {
+            table.update(handle, &new_values);
+            rows++;
+            continue;
+        }
+        ValueDict *old_values = table.project(handle, &set_columns);
+        size_t removed = 0, added = 0;
+        try {
+            for (; removed < changed_indices.size(); removed++)
+                changed_indices[removed]->del(handle);
+            table.update(handle, &new_values);
+        } catch (...) {
+            // the row is as it was, so its entries go back as they were
+            for (size_t i = 0; i < removed; i++)
+                changed_indices[i]->insert(handle);
+            delete old_values;
+            delete handles;
+            throw;
+        }
+        try {
+            for (; added < changed_indices.size(); added++)
+                changed_indices[added]->insert(handle);
+        } catch (...) {
+            // a new key is already another row's in a unique index, so the row goes back to how it was
+            for (size_t i = 0; i < added; i++)
+                changed_indices[i]->del(handle);
+            table.update(handle, old_values);
+            for (auto const &index: changed_indices)
+                index->insert(handle);
+            delete old_values;
+            delete handles;
+            throw;
+        }
+        delete old_values;
+        rows++;
+    }
+    delete handles;
+    string message = "successfully updated " + to_string(rows) + " rows in " + table_name;
+    if (!changed_indices.empty())
+        message += " and " + to_string(changed_indices.size()) + " indices";
+    return new QueryResult(message);
+}
+
 QueryResult *SQLExec::select(const SelectStatement *statement) {
     //get table name from SQL query
     Identifier table_name = statement->fromTable->name;
@@ -64,6 +64,15 @@ public:
      */
     static QueryResult *execute(const hsql::SQLStatement *statement);
 
+    /**
+     * Vacuum a table: pack its rows into as few blocks as they fit in, and cut the rest off the end of its file
+     * (see HeapTable::vacuum). Any indices on the table are pointed at the rows that moved. This is a command of
+     * its own (VACUUM table_name), since the parser doesn't know it.
+     * @param table_name  the table
+     * @returns           the result, saying how many blocks were reclaimed and how long it took (freed by caller)
+     */
+    static QueryResult *vacuum(Identifier table_name);
+
 protected:
     // the one place in the system that holds the _tables table and _indices table
     static Tables *tables;
@@ -94,6 +103,8 @@ protected:
 
     static QueryResult *del(const hsql::DeleteStatement *statement);
 
+    static QueryResult *update(const hsql::UpdateStatement *statement);
+
     static QueryResult *select(const hsql::SelectStatement *statement);
     
     static ValueDict* get_where_conjunction(const hsql::Expr *expr);
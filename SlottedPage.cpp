@@ -14,27 +14,50 @@ typedef uint16_t u16;
  * @param block
  * @param block_id
  * @param is_new
+ * @param deferred_compaction  for a new block, whether to compact on demand rather than on every del/put
  */
-SlottedPage::SlottedPage(Dbt &block, BlockID block_id, bool is_new) : DbBlock(block, block_id, is_new) {
+SlottedPage::SlottedPage(Dbt &block, BlockID block_id, bool is_new, bool deferred_compaction) : DbBlock(block,
+                                                                                                       block_id,
+                                                                                                       is_new) {
     if (is_new) {
         this->num_records = 0;
-        this->end_free = DbBlock::BLOCK_SZ - 1;
+        this->end_free = (u16) (get_block_size() - 1);
+        this->fragmented = 0;
+        this->flags = deferred_compaction ? DEFERRED_COMPACTION : 0;
+        this->num_live = 0;
+        this->free_slot = 0;
         put_header();
     } else {
         get_header(this->num_records, this->end_free);
+        this->fragmented = get_n(4);
+        this->flags = get_n(6);
+        this->num_live = get_n(8);
+        this->free_slot = get_n(10);
     }
 }
 
 /**
- * Add a new record to the block.
+ * Add a new record to the block. Reuses the id of a deleted record, if there is one.
  * @param data
  * @return the new block's id
  */
 RecordID SlottedPage::add(const Dbt *data) {
-    if (!has_room((u16) data->get_size()))
-        throw DbBlockNoRoomError("not enough room for new record");
-    u16 id = ++this->num_records;
     u16 size = (u16) data->get_size();
+    uint header = this->free_slot == 0 ? 4U : 0U;  // a reused id already has its record header
+    if (size + header > unused_bytes())
+        throw DbBlockNoRoomError("not enough room for new record");
+    if (size + header > contiguous_bytes())
+        compact();  // the room is there, but it is fragmented
+    RecordID id;
+    if (this->free_slot != 0) {
+        u16 next_free, loc;
+        id = this->free_slot;
+        get_header(next_free, loc, id);
+        this->free_slot = next_free;
+    } else {
+        id = ++this->num_records;
+    }
+    this->num_live++;
     this->end_free -= size;
     u16 loc = this->end_free + 1U;
     put_header();
@@ -53,7 +76,22 @@ Dbt *SlottedPage::get(RecordID record_id) const {
     get_header(size, loc, record_id);
     if (loc == 0)
         return nullptr;  // this is just a tombstone, record has been deleted
-    return new Dbt(this->address(loc), size);
+    return new Dbt(this->address(loc), size & ~MARKED);
+}
+
+/**
+ * Look at a record where it sits in the block.
+ * @param record_id
+ * @param size       set to the record's size
+ * @return the bits of the record as stored in the block, or nullptr if it has been deleted (not to be freed)
+ */
+const char *SlottedPage::view(RecordID record_id, u16 &size) const {
+    u16 loc;
+    get_header(size, loc, record_id);
+    if (loc == 0)
+        return nullptr;  // this is just a tombstone, record has been deleted
+    size &= ~MARKED;
+    return (const char *) this->address(loc);
 }
 
 /**
@@ -61,11 +99,38 @@ Dbt *SlottedPage::get(RecordID record_id) const {
  * @param record_id   record to replace
  * @param data        new contents of record_id
  * @throws DbBlockNoRoomError if it won't fit
+ * @throws DbBlockError if the record has been deleted
  */
 void SlottedPage::put(RecordID record_id, const Dbt &data) {
     u16 size, loc;
     get_header(size, loc, record_id);
+    if (loc == 0)
+        throw DbBlockError("can't put a deleted record");
+    u16 mark = size & MARKED;  // stays with the record
+    size &= ~MARKED;
     u16 new_size = (u16) data.get_size();
+    if (is_deferred()) {
+        if (new_size <= size) {
+            // shrink in place, the leftover tail is now fragmented
+            memcpy(this->address(loc), data.get_data(), new_size);
+            this->fragmented += size - new_size;
+        } else {
+            if (!has_room(new_size - size))
+                throw DbBlockNoRoomError("not enough room for enlarged record");
+            // write the new version into free space, the old version is now fragmented
+            this->fragmented += size;
+            if (new_size > contiguous_bytes()) {
+                put_header(record_id, 0, 0);
+                compact();
+            }
+            this->end_free -= new_size;
+            loc = this->end_free + 1U;
+            memcpy(this->address(loc), data.get_data(), new_size);
+        }
+        put_header(record_id, new_size | mark, loc);
+        put_header();
+        return;
+    }
     if (new_size > size) {
         u16 extra = new_size - size;
         if (!has_room(extra))
@@ -77,22 +142,37 @@ void SlottedPage::put(RecordID record_id, const Dbt &data) {
         slide(loc + new_size, loc + size);
     }
     get_header(size, loc, record_id);
-    put_header(record_id, new_size, loc);
+    put_header(record_id, new_size | mark, loc);
 }
 
 /**
  * Delete a record from the page.
  *
- * Mark the given id as deleted by changing its size to zero and its location to 0.
- * Compact the rest of the data in the block. But keep the record ids the same for everyone.
+ * Mark the given id as deleted by changing its location to 0 and push it onto the free list (kept in the
+ * size field) so add() can hand the id out again.
+ * Compact the rest of the data in the block (or, in deferred-compaction mode, just count the record's
+ * bytes as fragmented). But keep the record ids the same for everyone.
  *
  * @param record_id  record to delete
  */
 void SlottedPage::del(RecordID record_id) {
     u16 size, loc;
     get_header(size, loc, record_id);
-    put_header(record_id, 0, 0);  // 0 is the tombstone sentinel
-    slide(loc, loc + size);
+    if (loc == 0)
+        return;  // already deleted
+    size &= ~MARKED;
+    put_header(record_id, this->free_slot, 0);  // 0 location is the tombstone sentinel
+    this->free_slot = record_id;
+    this->num_live--;
+    if (!is_deferred()) {
+        slide(loc, loc + size);
+    } else if (loc == this->end_free + 1U) {
+        this->end_free += size;  // record was right next to the free space, so it is free already
+        put_header();
+    } else {
+        this->fragmented += size;
+        put_header();
+    }
 }
 
 /**
@@ -115,23 +195,43 @@ RecordIDs *SlottedPage::ids(void) const {
  */
 void SlottedPage::clear() {
     this->num_records = 0;
-    this->end_free = DbBlock::BLOCK_SZ - 1;
+    this->end_free = (u16) (get_block_size() - 1);
+    this->fragmented = 0;
+    this->num_live = 0;
+    this->free_slot = 0;
     put_header();
 }
 
 /**
- * Count of non-deleted records
+ * Count of non-deleted records (kept in the block header).
  * @return number of current records
  */
 u16 SlottedPage::size() const {
+    return this->num_live;
+}
+
+/**
+ * Mark or unmark a record (kept in the top bit of its size).
+ * @param record_id  which record
+ * @param marked     true to mark it
+ */
+void SlottedPage::set_marked(RecordID record_id, bool marked) {
     u16 size, loc;
-    u16 count = 0;
-    for (RecordID record_id = 1; record_id <= this->num_records; record_id++) {
-        get_header(size, loc, record_id);
-        if (loc != 0)
-            count++;
-    }
-    return count;
+    get_header(size, loc, record_id);
+    if (loc == 0)
+        throw DbBlockError("can't mark a deleted record");
+    put_header(record_id, marked ? size | MARKED : size & ~MARKED, loc);
+}
+
+/**
+ * Check if a record is marked.
+ * @param record_id  which record
+ * @return           true if it is there and marked
+ */
+bool SlottedPage::is_marked(RecordID record_id) const {
+    u16 size, loc;
+    get_header(size, loc, record_id);
+    return loc != 0 && (size & MARKED) != 0;
 }
 
 
@@ -142,8 +242,9 @@ u16 SlottedPage::size() const {
  * @param id    the id of the header to fetch
  */
 void SlottedPage::get_header(u_int16_t &size, u_int16_t &loc, RecordID id) const {
-    size = get_n((u16) 4 * id);
-    loc = get_n((u16) (4 * id + 2));
+    u16 offset = id == 0 ? (u16) 0 : (u16) (HEADER_SZ + 4 * (id - 1));
+    size = get_n(offset);
+    loc = get_n((u16) (offset + 2));
 }
 
 /**
@@ -154,18 +255,24 @@ void SlottedPage::get_header(u_int16_t &size, u_int16_t &loc, RecordID id) const
  */
 void SlottedPage::put_header(RecordID id, u16 size, u16 loc) {
     if (id == 0) { // called the put_header() version and using the default params
-        size = this->num_records;
-        loc = this->end_free;
+        put_n(0, this->num_records);
+        put_n(2, this->end_free);
+        put_n(4, this->fragmented);
+        put_n(6, this->flags);
+        put_n(8, this->num_live);
+        put_n(10, this->free_slot);
+        return;
     }
-    put_n((u16) 4 * id, size);
-    put_n((u16) (4 * id + 2), loc);
+    u16 offset = (u16) (HEADER_SZ + 4 * (id - 1));
+    put_n(offset, size);
+    put_n((u16) (offset + 2), loc);
 }
 
 /**
  * Calculate if we have room to store a record with given size. The size should include the 4 bytes
  * for the header, too, if this is an add.
  * @param size   size of the new record (not including the header space needed)
- * @return       true if there is enough room, false otherwise
+ * @return       true if there is enough room (possibly after compaction), false otherwise
  */
 bool SlottedPage::has_room(u16 size) const {
     return size + (u16)4 <= this->unused_bytes();
@@ -173,16 +280,22 @@ bool SlottedPage::has_room(u16 size) const {
 
 /**
  * Get the number of bytes not currently used to store data or for overhead.
+ * Includes fragmented bytes, which can be reclaimed by compaction.
  * @return number of bytes
  */
 u16 SlottedPage::unused_bytes() const {
-    u16 headers = (u16) (4 * (this->num_records + 1));
-    u16 unused;
-    if (this->end_free <= headers)
-        unused = 0;
-    else
-        unused = this->end_free - headers;
-    return unused;
+    return contiguous_bytes() + this->fragmented;
+}
+
+/**
+ * Get the number of bytes between the record headers and the record data.
+ * @return number of bytes
+ */
+u16 SlottedPage::contiguous_bytes() const {
+    u16 headers = (u16) (HEADER_SZ + 4 * this->num_records);
+    if (this->end_free < headers)
+        return 0;
+    return this->end_free - headers + 1U;
 }
 
 /**
@@ -209,20 +322,40 @@ void SlottedPage::slide(u_int16_t start, u_int16_t end) {
     memmove(to, from, bytes);
 
     // fix up headers to the right
-    RecordIDs *record_ids = ids();
-    for (auto const &record_id : *record_ids) {
+    for (RecordID record_id = 1; record_id <= this->num_records; record_id++) {
         u16 size, loc;
         get_header(size, loc, record_id);
-        if (loc <= start) {
+        if (loc != 0 && loc <= start) {
             loc += shift;
             put_header(record_id, size, loc);
         }
     }
-    delete record_ids;
     this->end_free += shift;
     put_header();
 }
 
+/**
+ * Squeeze out all the fragmented bytes by repacking every live record against the end of the block.
+ * One pass over the record headers and one copy of the data.
+ */
+void SlottedPage::compact() {
+    char packed[DbBlock::MAX_BLOCK_SZ];
+    u16 end = (u16) (get_block_size() - 1);
+    for (RecordID record_id = 1; record_id <= this->num_records; record_id++) {
+        u16 size, loc;
+        get_header(size, loc, record_id);
+        if (loc == 0)
+            continue;
+        end -= size & ~MARKED;
+        memcpy(packed + end + 1, this->address(loc), size & ~MARKED);
+        put_header(record_id, size, (u16) (end + 1U));
+    }
+    memcpy(this->address((u16) (end + 1U)), packed + end + 1, get_block_size() - 1U - end);
+    this->end_free = end;
+    this->fragmented = 0;
+    put_header();
+}
+
 /**
  * Get 2-byte integer at given offset in block.
  */
@@ -351,6 +484,12 @@ bool test_slotted_page() {
     get_dbt = slot.get(1);
     if (get_dbt != nullptr)
         return assertion_failure("get of deleted record was not null");
+    u16 view_size;
+    if (slot.view(1, view_size) != nullptr)
+        return assertion_failure("view of deleted record was not null");
+    const char *view = slot.view(2, view_size);
+    if (view == nullptr || string(view, view_size) != string(rec2, sizeof(rec2)))
+        return assertion_failure("view of record 2");
 
     // try adding something too big
     rec2_dbt = Dbt(nullptr, DbBlock::BLOCK_SZ - 10); // too big, but only because we have a record in there
@@ -364,6 +503,22 @@ bool test_slotted_page() {
         return assertion_failure("wrong type thrown when add too big");
     }
 
+    // the deleted id gets handed out again (and record 2 keeps its id)
+    if (slot.size() != 1)
+        return assertion_failure("size() after del", slot.size());
+    rec1_dbt = Dbt(rec1, sizeof(rec1));
+    id = slot.add(&rec1_dbt);
+    if (id != 1 || slot.size() != 2)
+        return assertion_failure("add did not reuse deleted id", id, slot.size());
+    view = slot.view(2, view_size);
+    if (view == nullptr || string(view, view_size) != string(rec2, sizeof(rec2)))
+        return assertion_failure("view of record 2 after id reuse");
+    slot.del(2);
+    slot.del(1);
+    rec2_dbt = Dbt(rec2, sizeof(rec2));
+    if (slot.size() != 0 || slot.add(&rec2_dbt) != 1 || slot.add(&rec1_dbt) != 2)
+        return assertion_failure("free ids not reused most recent first");
+
     // more volume
     string gettysburg = "Four score and seven years ago our fathers brought forth on this continent, a new nation, conceived in Liberty, and dedicated to the proposition that all men are created equal.";
     int32_t n = -1;
@@ -399,10 +554,103 @@ bool test_slotted_page() {
             if (memcmp(stored, data, total_size) != 0)
                 return assertion_failure("more volume wrong data", block_id - 1, id);
             delete record;
+            u16 size;
+            const char *viewed = slot.view(id, size);
+            if (size != total_size || memcmp(viewed, data, total_size) != 0)
+                return assertion_failure("more volume wrong view", block_id - 1, id);
         }
         delete ids;
         delete[] (char *) slot.block.get_data();  // this is why we need to be a friend--just convenient
     }
+
+    // deferred compaction: deletes just leave holes until an add needs the room
+    Dbt deferred_dbt(new char[DbBlock::BLOCK_SZ], DbBlock::BLOCK_SZ);
+    SlottedPage deferred(deferred_dbt, 1, true, true);
+    RecordID n_added = 0;
+    try {
+        while (true) {
+            deferred.add(&dbt);
+            n_added++;
+        }
+    } catch (DbBlockNoRoomError &exc) {
+        // page is full
+    }
+    for (RecordID id = 1; id <= n_added; id += 2)
+        deferred.del(id);
+    if (deferred.fragmented_bytes() == 0)
+        return assertion_failure("deferred del compacted the page");
+    deferred = SlottedPage(deferred_dbt, 1);  // header survives a re-read
+    if (deferred.fragmented_bytes() == 0 || !deferred.is_deferred())
+        return assertion_failure("deferred header not persisted");
+    uint big_size = 2 * total_size;  // bigger than any one hole
+    char *big = new char[big_size];
+    memset(big, 'x', big_size);
+    Dbt big_dbt(big, big_size);
+    RecordID big_id = deferred.add(&big_dbt);
+    if (deferred.fragmented_bytes() != 0)
+        return assertion_failure("deferred add did not compact");
+    if (big_id % 2 != 1 || deferred.size() != n_added / 2 + 1)
+        return assertion_failure("deferred add did not reuse a deleted id", big_id, deferred.size());
+    for (RecordID id = 2; id <= n_added; id += 2) {
+        u16 size;
+        const char *viewed = deferred.view(id, size);
+        if (size != total_size || memcmp(viewed, data, total_size) != 0)
+            return assertion_failure("deferred data lost in compaction", id);
+    }
+    u16 size;
+    const char *viewed = deferred.view(big_id, size);
+    if (size != big_size || memcmp(viewed, big, big_size) != 0)
+        return assertion_failure("deferred add after compaction");
+
+    // deferred put: shrink in place, then grow back into the free space
+    Dbt small_dbt(data, 10);
+    deferred.put(2, small_dbt);
+    viewed = deferred.view(2, size);
+    if (size != 10 || memcmp(viewed, data, 10) != 0 || deferred.fragmented_bytes() != total_size - 10)
+        return assertion_failure("deferred put shrink");
+    deferred.put(2, dbt);
+    viewed = deferred.view(2, size);
+    if (size != total_size || memcmp(viewed, data, total_size) != 0)
+        return assertion_failure("deferred put grow");
+    viewed = deferred.view(4, size);
+    if (size != total_size || memcmp(viewed, data, total_size) != 0)
+        return assertion_failure("deferred put grow moved a neighbor");
+
+    // a mark stays with its record through put and compaction, and goes with del
+    deferred.set_marked(4, true);
+    if (!deferred.is_marked(4) || deferred.is_marked(2) || deferred.is_marked(1))
+        return assertion_failure("marked");
+    deferred.put(4, small_dbt);
+    viewed = deferred.view(4, size);
+    if (!deferred.is_marked(4) || size != 10 || memcmp(viewed, data, 10) != 0)
+        return assertion_failure("marked put");
+    deferred.put(4, dbt);
+    deferred.compact();
+    viewed = deferred.view(4, size);
+    if (!deferred.is_marked(4) || size != total_size || memcmp(viewed, data, total_size) != 0)
+        return assertion_failure("marked compaction");
+    deferred.set_marked(4, false);
+    if (deferred.is_marked(4))
+        return assertion_failure("unmarked");
+    deferred.set_marked(4, true);
+    deferred.del(4);
+    if (deferred.is_marked(4) || deferred.get(4) != nullptr)
+        return assertion_failure("marked del");
+    try {
+        deferred.set_marked(4, true);
+        return assertion_failure("deleted record marked");
+    } catch (DbBlockError &e) {
+        // expected
+    }
+    try {
+        deferred.put(4, small_dbt);
+        return assertion_failure("put of deleted record");
+    } catch (DbBlockError &e) {
+        // expected
+    }
+    delete[] big;
+    delete[] (char *) deferred_dbt.get_data();
+
     delete[] data;
     return true;
 }
@@ -17,18 +17,35 @@
  *      Manage a database block that contains several records.
         Modeled after slotted-page from Database Systems Concepts, 6ed, Figure 10-9.
 
-        Record id are handed out sequentially starting with 1 as records are added with add().
-        Each record has a header which is a fixed offset from the beginning of the block:
-            Bytes 0x00 - Ox01: number of records
+        Record id are handed out sequentially starting with 1 as records are added with add(), except that
+        the ids of deleted records are handed out again first. Ids of live records never change.
+        The block header is followed by a record header for each record, at a fixed offset from the beginning
+        of the block:
+            Bytes 0x00 - Ox01: number of records (including deleted ones)
             Bytes 0x02 - 0x03: offset to end of free space
-            Bytes 0x04 - 0x05: size of record 1
-            Bytes 0x06 - 0x07: offset to record 1
+            Bytes 0x04 - 0x05: number of fragmented bytes (freed by del/put but not yet compacted)
+            Bytes 0x06 - 0x07: flags (e.g., DEFERRED_COMPACTION; 0x8000 is never set, it marks a PaxPage)
+            Bytes 0x08 - 0x09: number of live (undeleted) records
+            Bytes 0x0A - 0x0B: first free (deleted) record id, or 0 if none
+            Bytes 0x0C - 0x0D: size of record 1
+            Bytes 0x0E - 0x0F: offset to record 1
             etc.
+        A deleted record's header has an offset of 0 and, in place of its size, the next free record id.
+        A record can be marked (see set_marked) by setting the top bit of its size, which a record never needs,
+        since even the biggest block has its header.
+
+        In deferred-compaction mode, del() and put() just leave the dead bytes where they are and count them
+        as fragmented. The data is compacted all at once, and only when add() or put() needs the room.
  *
  */
 class SlottedPage : public DbBlock {
 public:
-    SlottedPage(Dbt &block, BlockID block_id, bool is_new = false);
+    /**
+     * Page header flag: compact on demand rather than on every del/put.
+     */
+    static const uint16_t DEFERRED_COMPACTION = 0x0001;
+
+    SlottedPage(Dbt &block, BlockID block_id, bool is_new = false, bool deferred_compaction = false);
 
     // Big 5 - use the defaults
     virtual ~SlottedPage() {}
@@ -37,6 +54,8 @@ public:
 
     virtual Dbt *get(RecordID record_id) const;
 
+    virtual const char *view(RecordID record_id, u_int16_t &size) const;
+
     virtual void put(RecordID record_id, const Dbt &data);
 
     virtual void del(RecordID record_id);
@@ -49,10 +68,26 @@ public:
 
     virtual u_int16_t unused_bytes() const;
 
+    virtual void set_marked(RecordID record_id, bool marked);
+
+    virtual bool is_marked(RecordID record_id) const;
+
+    /**
+     * Get the number of bytes freed by del/put that are waiting for the next compaction.
+     * @returns  number of fragmented bytes
+     */
+    virtual u_int16_t fragmented_bytes() const { return this->fragmented; }
 
 protected:
+    static const uint16_t HEADER_SZ = 12;  // size of the block header (before the record headers)
+    static const uint16_t MARKED = 0x8000;  // record header size flag of a marked record
+
     uint16_t num_records;
     uint16_t end_free;
+    uint16_t fragmented;
+    uint16_t flags;
+    uint16_t num_live;
+    uint16_t free_slot;
 
     void get_header(uint16_t &size, uint16_t &loc, RecordID id = 0) const;
 
@@ -60,8 +95,14 @@ protected:
 
     bool has_room(uint16_t size) const;
 
+    uint16_t contiguous_bytes() const;
+
+    bool is_deferred() const { return (this->flags & DEFERRED_COMPACTION) != 0; }
+
     virtual void slide(uint16_t start, uint16_t end);
 
+    virtual void compact();
+
     uint16_t get_n(uint16_t offset) const;
 
     void put_n(uint16_t offset, uint16_t n);
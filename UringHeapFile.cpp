@@ -0,0 +1,655 @@
+/**
+ * @file UringHeapFile.cpp - implementation of UringHeapFile
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "UringHeapFile.h"
+#include "BufferPool.h"
+
+using namespace std;
+
+static const uint HEADER_MAGIC = 0x00, HEADER_BLOCK_SZ = 0x04, HEADER_LAST = 0x08, HEADER_FLAGS = 0x0C,
+        HEADER_SZ = 0x10;
+
+/**
+ * Throw a DbException (like Berkeley DB would) for a failed system call.
+ * @param what  what we were trying to do
+ */
+static void system_failure(string what) {
+    int error = errno;
+    throw DbException((what + ": " + strerror(error)).c_str(), error);
+}
+
+/**
+ * @class UringHeapFile::Ring - an io_uring submission and completion queue, set up with the raw system calls
+ * (so there is nothing to link with), doing READV and WRITEV requests (so any kernel with io_uring will do).
+ */
+class UringHeapFile::Ring {
+public:
+    /**
+     * Set up a ring.
+     * @param entries  number of submission queue entries (the kernel rounds it up to a power of two)
+     * @returns        the ring, or null if the kernel won't give us one
+     */
+    static Ring *setup(uint entries);
+
+    ~Ring();
+
+    /**
+     * Queue a request (submitted by the next enter).
+     * @param opcode     IORING_OP_READV or IORING_OP_WRITEV
+     * @param fd         file to read or write
+     * @param iov        the one buffer to read into or write from (has to stay put until the request completes)
+     * @param offset     where in the file
+     * @param user_data  handed back with the completion
+     */
+    void queue(uint8_t opcode, int fd, struct iovec *iov, uint64_t offset, uint64_t user_data);
+
+    /**
+     * Submit the queued requests and wait for some completions.
+     * @param wait_for  number of completions to wait for (0 to just submit)
+     */
+    void enter(uint wait_for);
+
+    /**
+     * Take the next completion, if there is one.
+     * @param user_data  set to the request's user data
+     * @param res        set to the request's result (bytes transferred, or -errno)
+     * @returns          false if there are no completions waiting
+     */
+    bool completion(uint64_t &user_data, int32_t &res);
+
+private:
+    int fd;
+    uint to_submit;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_sz, cq_ring_sz;
+    struct io_uring_sqe *sqes;
+    size_t sqes_sz;
+    unsigned sq_entries;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    Ring() : fd(-1), to_submit(0), sq_ring(MAP_FAILED), cq_ring(MAP_FAILED), sq_ring_sz(0), cq_ring_sz(0),
+             sqes((struct io_uring_sqe *) MAP_FAILED), sqes_sz(0), sq_entries(0), sq_head(nullptr), sq_tail(nullptr),
+             sq_mask(nullptr), sq_array(nullptr), cq_head(nullptr), cq_tail(nullptr), cq_mask(nullptr),
+             cqes(nullptr) {}
+};
+
+UringHeapFile::Ring *UringHeapFile::Ring::setup(uint entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+        return nullptr;
+    Ring *ring = new Ring();
+    ring->fd = fd;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_ring_sz = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_sz = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+        ring->sq_ring_sz = ring->cq_ring_sz = max(ring->sq_ring_sz, ring->cq_ring_sz);
+    ring->sq_ring = mmap(nullptr, ring->sq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                         IORING_OFF_SQ_RING);
+    if (ring->sq_ring != MAP_FAILED)
+        ring->cq_ring = single_mmap ? ring->sq_ring : mmap(nullptr, ring->cq_ring_sz, PROT_READ | PROT_WRITE,
+                                                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    ring->sqes_sz = params.sq_entries * sizeof(struct io_uring_sqe);
+    if (ring->cq_ring != MAP_FAILED)
+        ring->sqes = (struct io_uring_sqe *) mmap(nullptr, ring->sqes_sz, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        delete ring;
+        return nullptr;
+    }
+
+    char *sq = (char *) ring->sq_ring, *cq = (char *) ring->cq_ring;
+    ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+    ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    return ring;
+}
+
+UringHeapFile::Ring::~Ring() {
+    if (this->sqes != MAP_FAILED)
+        munmap(this->sqes, this->sqes_sz);
+    if (this->cq_ring != MAP_FAILED && this->cq_ring != this->sq_ring)
+        munmap(this->cq_ring, this->cq_ring_sz);
+    if (this->sq_ring != MAP_FAILED)
+        munmap(this->sq_ring, this->sq_ring_sz);
+    ::close(this->fd);
+}
+
+void UringHeapFile::Ring::queue(uint8_t opcode, int fd, struct iovec *iov, uint64_t offset, uint64_t user_data) {
+    unsigned tail = *this->sq_tail;
+    if (tail - __atomic_load_n(this->sq_head, __ATOMIC_ACQUIRE) >= this->sq_entries)
+        enter(0);  // full, so hand what's there to the kernel first
+    unsigned index = tail & *this->sq_mask;
+    struct io_uring_sqe *sqe = &this->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) iov;
+    sqe->len = 1;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    this->sq_array[index] = index;
+    __atomic_store_n(this->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    this->to_submit++;
+}
+
+void UringHeapFile::Ring::enter(uint wait_for) {
+    do {
+        if (this->to_submit == 0 && wait_for == 0)
+            return;
+        long submitted = syscall(__NR_io_uring_enter, this->fd, this->to_submit, wait_for,
+                                 wait_for > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if (submitted < 0) {
+            if (errno == EINTR)
+                continue;
+            system_failure("io_uring_enter");
+        }
+        this->to_submit -= (uint) submitted;
+    } while (this->to_submit > 0);
+}
+
+bool UringHeapFile::Ring::completion(uint64_t &user_data, int32_t &res) {
+    unsigned head = *this->cq_head;
+    if (head == __atomic_load_n(this->cq_tail, __ATOMIC_ACQUIRE))
+        return false;
+    struct io_uring_cqe *cqe = &this->cqes[head & *this->cq_mask];
+    user_data = cqe->user_data;
+    res = cqe->res;
+    __atomic_store_n(this->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Constructor
+ * @param name
+ * @param block_size         size of blocks if the file gets created (an existing file keeps its own block size)
+ * @param layout             layout of blocks if the file gets created (an existing file keeps its own layout)
+ * @param column_attributes  columns of the records, needed for PAX blocks
+ * @param queue_depth        most reads or writes to have in flight at once (0 for synchronous reads and writes)
+ * @param direct             whether to use O_DIRECT, if the file gets created (an existing file keeps its own)
+ */
+UringHeapFile::UringHeapFile(string name, uint block_size, BlockLayout layout,
+                             const ColumnAttributes &column_attributes, uint queue_depth, bool direct)
+        : HeapFile(name, block_size, layout, column_attributes), path(path_for(name)), fd(-1),
+          queue_depth(queue_depth), direct(direct), direct_io(false), ring(nullptr), staging(), bounce(),
+          slot_block(), slot_iov(), free_slots(), in_flight(), transfers_pending(0), transfer_failed(false) {
+}
+
+UringHeapFile::~UringHeapFile() {
+    close();  // before HeapFile's destructor, which would write our blocks back through Berkeley DB
+}
+
+/**
+ * Where the file for a given name goes (in the database environment's directory).
+ * @param name
+ * @return      path of the file
+ */
+string UringHeapFile::path_for(string name) {
+    const char *home = nullptr;
+    _DB_ENV->get_home(&home);
+    return string(home == nullptr ? "." : home) + "/" + name + ".blk";
+}
+
+bool UringHeapFile::exists(string name) {
+    struct stat buf;
+    return stat(path_for(name).c_str(), &buf) == 0;
+}
+
+/**
+ * Create physical file.
+ */
+void UringHeapFile::create(void) {
+    db_open(DB_CREATE | DB_EXCL);
+    DbBlock *page = get_new(); // force one page to exist
+    delete page;
+}
+
+/**
+ * Delete the physical file.
+ */
+void UringHeapFile::drop(void) {
+    close();
+    if (unlink(this->path.c_str()) != 0)
+        system_failure("remove " + this->path);
+    fsm_drop();
+}
+
+/**
+ * Open physical file.
+ */
+void UringHeapFile::open(void) {
+    db_open();
+}
+
+/**
+ * Close the physical file, writing back any of its blocks still in the buffer pool.
+ */
+void UringHeapFile::close(void) {
+    if (this->closed)
+        return;
+    if (this->pool != nullptr)
+        this->pool->discard(this);
+    wait();
+    write_header();
+    delete this->ring;
+    this->ring = nullptr;
+    ::close(this->fd);
+    this->fd = -1;
+    this->fsm.close(0);
+    this->closed = true;
+}
+
+/**
+ * Allocate a new block for the file.
+ * @return the new empty DbBlock that is managing the records in this block and its block id.
+ */
+DbBlock *UringHeapFile::get_new(void) {
+    DbBlock *block = HeapFile::get_new();
+    write_header();
+    return block;
+}
+
+/**
+ * Get a block from the file, waiting for it first if it is being prefetched.
+ * @param block_id
+ * @return          the given slotted page or PAX page (freed by caller)
+ */
+DbBlock *UringHeapFile::get(BlockID block_id) {
+    if (block_id == 0 || block_id > this->last)
+        throw DbRelationError("no such block in " + this->name);
+    settle(block_id);
+    return HeapFile::get(block_id);
+}
+
+/**
+ * Write a block back to the file (or mark it dirty in the buffer pool), waiting first if it is being prefetched.
+ * @param block
+ */
+void UringHeapFile::put(DbBlock *block) {
+    settle(block->get_block_id());
+    HeapFile::put(block);
+}
+
+/**
+ * Start reading all the blocks in order, keeping a queue's worth of reads going ahead of the scan.
+ * @return the scan (freed by caller)
+ */
+HeapFile::BlockScan *UringHeapFile::scan_blocks() {
+    return new PrefetchScan(*this);
+}
+
+DbBlock *UringHeapFile::PrefetchScan::next() {
+    BlockID last = this->uring.get_last_block_id();
+    if (this->block_id >= last)
+        return nullptr;
+    if (this->ahead < last && this->ahead <= this->block_id + this->uring.queue_depth / 2) {
+        vector<BlockID> block_ids;
+        for (BlockID block_id = max(this->ahead, this->block_id) + 1;
+             block_id <= last && block_id <= this->block_id + this->uring.queue_depth; block_id++)
+            block_ids.push_back(block_id);
+        if (!block_ids.empty()) {
+            this->uring.prefetch(block_ids);
+            this->ahead = block_ids.back();
+        }
+    }
+    return this->file.get(++this->block_id);
+}
+
+void UringHeapFile::prefetch(const vector<BlockID> &block_ids) {
+    for (auto const &block_id: block_ids) {
+        if (block_id == 0 || block_id > this->last || this->in_flight.find(block_id) != this->in_flight.end()
+            || (this->pool != nullptr && this->pool->contains(this, block_id)))
+            continue;
+        off_t offset = (off_t) block_id * this->block_size;
+        if (this->ring == nullptr || this->pool == nullptr) {
+            // nowhere to read it to ahead of time, so just get the kernel started on it
+            posix_fadvise(this->fd, offset, this->block_size, POSIX_FADV_WILLNEED);
+            continue;
+        }
+        while (this->free_slots.empty())
+            reap(1);
+        uint slot = this->free_slots.back();
+        this->free_slots.pop_back();
+        this->slot_block[slot] = block_id;
+        this->slot_iov[slot].iov_base = this->staging.data() + (size_t) slot * this->block_size;
+        this->slot_iov[slot].iov_len = this->block_size;
+        this->ring->queue(IORING_OP_READV, this->fd, &this->slot_iov[slot], offset, slot);
+        this->in_flight[block_id] = slot;
+    }
+    reap(0);
+}
+
+void UringHeapFile::wait() {
+    while (!this->in_flight.empty())
+        reap(1);
+}
+
+/**
+ * Open (or create) the file and set up its ring.
+ * @param flags  DB_CREATE and DB_EXCL, as for Berkeley DB
+ */
+void UringHeapFile::db_open(uint flags) {
+    if (!this->closed)
+        return;
+    int open_flags = O_RDWR;
+    if (flags & DB_CREATE)
+        open_flags |= O_CREAT;
+    if (flags & DB_EXCL)
+        open_flags |= O_EXCL;
+    this->fd = ::open(this->path.c_str(), open_flags, 0644);
+    if (this->fd < 0)
+        system_failure("open " + this->path);
+    if (flags & DB_CREATE) {
+        this->last = 0;
+    } else {
+        char header[HEADER_SZ];
+        if (pread(this->fd, header, HEADER_SZ, 0) != HEADER_SZ || *(uint32_t *) (header + HEADER_MAGIC) != MAGIC) {
+            ::close(this->fd);
+            this->fd = -1;
+            throw DbRelationError(this->path + " is not a uring heap file");
+        }
+        this->block_size = *(uint32_t *) (header + HEADER_BLOCK_SZ);
+        this->last = *(uint32_t *) (header + HEADER_LAST);
+        this->direct = (*(uint32_t *) (header + HEADER_FLAGS) & DIRECT_FILE) != 0;
+    }
+    this->closed = false;
+    this->reserved = this->last;  // the header has the blocks in use, so any reserved past them get reserved again
+    this->next_extent = this->extent_first;
+    if (flags & DB_CREATE)
+        write_header();
+    // not every file system does O_DIRECT (tmpfs doesn't), in which case we go through the page cache after all
+    this->direct_io = this->direct && fcntl(this->fd, F_SETFL, fcntl(this->fd, F_GETFL) | O_DIRECT) == 0;
+
+    this->bounce.resize(this->block_size);
+    this->staging.resize((size_t) this->queue_depth * this->block_size);
+    this->slot_block.assign(this->queue_depth, 0);
+    this->slot_iov.resize(this->queue_depth);
+    this->free_slots.clear();
+    for (uint slot = this->queue_depth; slot > 0; slot--)
+        this->free_slots.push_back(slot - 1);
+    this->in_flight.clear();
+    this->transfers_pending = 0;
+    this->transfer_failed = false;
+    this->ring = this->queue_depth > 0 ? Ring::setup(this->queue_depth) : nullptr;
+    if (this->pool != nullptr) {
+        this->pool_file_id = this->pool->file_id(this->path);
+        this->pool->checkpoint(this);
+    }
+
+    fsm_open(flags);
+    if (this->last > 0) {
+        // new blocks have to match the ones already there
+        DbBlock *first = get(1);
+        this->layout = PaxPage::is_pax(*first->get_block()) ? PAX : SLOTTED_PAGE;
+        delete first;
+    }
+}
+
+/**
+ * Cut the file short after a given block, with the header saying so. Prefetches are waited for first, so none of
+ * the blocks cut off land in the buffer pool afterwards.
+ * @param block_id  block to be the last one (at least 1)
+ * @return          number of blocks in use that were cut off
+ */
+BlockID UringHeapFile::truncate(BlockID block_id) {
+    wait();
+    BlockID cut = HeapFile::truncate(block_id);
+    write_header();
+    return cut;
+}
+
+/**
+ * Shrink the file to just the header and the blocks up to a given one.
+ * @param block_id  last block to keep
+ */
+void UringHeapFile::cut_after(BlockID block_id) {
+    if (ftruncate(this->fd, (off_t) (block_id + 1) * this->block_size) != 0)
+        system_failure("truncate " + this->path);
+}
+
+/**
+ * Read a block from the file (waiting for it).
+ * @param block_id
+ * @param block     set to the block's memory
+ * @param into      where to put the block, or null for page_buffer
+ */
+void UringHeapFile::read_block(BlockID block_id, Dbt &block, char *into) {
+    if (into == nullptr) {
+        this->page_buffer.resize(this->block_size);
+        into = this->page_buffer.data();
+    }
+    transfer(false, block_id, into);
+    block.set_data(into);
+    block.set_size(this->block_size);
+}
+
+/**
+ * Write a block to the file (waiting for it).
+ * @param block_id
+ * @param bytes     the block
+ */
+void UringHeapFile::write_block(BlockID block_id, const char *bytes) {
+    settle(block_id);
+    transfer(true, block_id, (char *) bytes);
+}
+
+/**
+ * Write a batch of blocks, submitting up to the queue depth of them at once.
+ * @param blocks  block id and bytes of each
+ */
+void UringHeapFile::write_blocks(const vector<pair<BlockID, const char *>> &blocks) {
+    if (this->ring == nullptr) {
+        HeapFile::write_blocks(blocks);
+        return;
+    }
+    wait();  // so the prefetches aren't using up the completion queue (and none is of a block being written)
+    vector<struct iovec> iov(min((size_t) this->queue_depth, blocks.size()));
+    for (size_t i = 0; i < blocks.size(); i += this->queue_depth) {
+        for (size_t j = 0; j < iov.size() && i + j < blocks.size(); j++) {
+            iov[j].iov_base = (void *) blocks[i + j].second;
+            iov[j].iov_len = this->block_size;
+            this->ring->queue(IORING_OP_WRITEV, this->fd, &iov[j], (uint64_t) blocks[i + j].first * this->block_size,
+                              TRANSFER);
+            this->transfers_pending++;
+        }
+        finish_transfers();
+    }
+}
+
+/**
+ * Write the header (block 0) with the block size and the last block id.
+ */
+void UringHeapFile::write_header() {
+    // a whole aligned block's worth, as O_DIRECT wants
+    AlignedBuffer header(AlignedBuffer::ALIGNMENT);
+    memset(header.data(), 0, AlignedBuffer::ALIGNMENT);
+    *(uint32_t *) (header.data() + HEADER_MAGIC) = MAGIC;
+    *(uint32_t *) (header.data() + HEADER_BLOCK_SZ) = this->block_size;
+    *(uint32_t *) (header.data() + HEADER_LAST) = this->last;
+    *(uint32_t *) (header.data() + HEADER_FLAGS) = this->direct ? DIRECT_FILE : 0;
+    if (pwrite(this->fd, header.data(), AlignedBuffer::ALIGNMENT, 0) != AlignedBuffer::ALIGNMENT)
+        system_failure("write header of " + this->path);
+}
+
+/**
+ * Wait for a block if it is being prefetched.
+ * @param block_id
+ */
+void UringHeapFile::settle(BlockID block_id) {
+    while (this->in_flight.find(block_id) != this->in_flight.end())
+        reap(1);
+}
+
+/**
+ * Submit whatever is queued, wait for some completions, and deal with all the completions there are:
+ * prefetched blocks go into the buffer pool (unless the pool already has the block), and TRANSFER
+ * requests are counted off.
+ * @param wait_for  number of completions to wait for (0 to not wait)
+ */
+void UringHeapFile::reap(uint wait_for) {
+    if (this->ring == nullptr)
+        return;
+    this->ring->enter(wait_for);
+    uint64_t user_data;
+    int32_t res;
+    while (this->ring->completion(user_data, res)) {
+        if (user_data == TRANSFER) {
+            this->transfers_pending--;
+            if (res != (int32_t) this->block_size)
+                this->transfer_failed = true;
+            continue;
+        }
+        uint slot = (uint) user_data;
+        BlockID block_id = this->slot_block[slot];
+        this->in_flight.erase(block_id);
+        if (res == (int32_t) this->block_size && !this->pool->contains(this, block_id)) {
+            try {
+                uint frame = this->pool->pin(this, block_id, false);
+                memcpy(this->pool->get_data(frame), this->slot_iov[slot].iov_base, this->block_size);
+                this->pool->unpin(frame);
+            } catch (DbRelationError &e) {
+                // every frame is pinned, so the block will be read again when it is wanted
+            }
+        }
+        this->slot_block[slot] = 0;
+        this->free_slots.push_back(slot);
+    }
+}
+
+/**
+ * Read or write a block, waiting for it.
+ * @param write     true to write, false to read
+ * @param block_id
+ * @param bytes     the block's memory
+ */
+void UringHeapFile::transfer(bool write, BlockID block_id, char *bytes) {
+    if (this->direct_io && !AlignedBuffer::is_aligned(bytes)) {
+        if (write)
+            memcpy(this->bounce.data(), bytes, this->block_size);
+        transfer(write, block_id, this->bounce.data());
+        if (!write)
+            memcpy(bytes, this->bounce.data(), this->block_size);
+        return;
+    }
+    off_t offset = (off_t) block_id * this->block_size;
+    if (this->ring == nullptr) {
+        ssize_t n = write ? pwrite(this->fd, bytes, this->block_size, offset)
+                          : pread(this->fd, bytes, this->block_size, offset);
+        if (n < 0)
+            system_failure((write ? "write " : "read ") + this->path);
+        if ((uint) n != this->block_size)
+            throw DbException((this->path + ": short " + (write ? "write" : "read")).c_str(), EIO);
+        return;
+    }
+    struct iovec iov;
+    iov.iov_base = bytes;
+    iov.iov_len = this->block_size;
+    this->ring->queue(write ? IORING_OP_WRITEV : IORING_OP_READV, this->fd, &iov, offset, TRANSFER);
+    this->transfers_pending++;
+    finish_transfers();
+}
+
+/**
+ * Wait for all the TRANSFER requests to complete.
+ * @throws DbException if any of them didn't transfer a whole block
+ */
+void UringHeapFile::finish_transfers() {
+    while (this->transfers_pending > 0)
+        reap(1);
+    if (this->transfer_failed) {
+        this->transfer_failed = false;
+        throw DbException((this->path + ": short read or write").c_str(), EIO);
+    }
+}
+
+/**
+ * Test UringHeapFile, through io_uring (if the kernel has it) and synchronously, with and without O_DIRECT,
+ * and with and without the buffer pool: blocks go in and come back out, read one at a time, prefetched, and
+ * scanned.
+ * @return true if the tests all succeeded
+ */
+bool test_uring_heap_file() {
+    const uint N_BLOCKS = 100;
+    struct {
+        uint depth;
+        bool direct;
+        bool pooled;
+    } modes[] = {{UringHeapFile::DEFAULT_QUEUE_DEPTH, false, true}, {0, false, true},
+                 {UringHeapFile::DEFAULT_QUEUE_DEPTH, true, true}, {UringHeapFile::DEFAULT_QUEUE_DEPTH, true, false}};
+    BufferPool *pool = _BUFFER_POOL;
+    for (auto const &mode: modes) {
+        uint depth = mode.depth;
+        _BUFFER_POOL = mode.pooled ? pool : nullptr;  // files pick up the pool when they are constructed
+        UringHeapFile file("_test_uring_heap_file", DbBlock::BLOCK_SZ, HeapFile::SLOTTED_PAGE, ColumnAttributes(),
+                           depth, mode.direct);
+        UringHeapFile reopened("_test_uring_heap_file", 8192, HeapFile::SLOTTED_PAGE, ColumnAttributes(), depth);
+        _BUFFER_POOL = pool;
+        file.create();
+        if (!UringHeapFile::exists("_test_uring_heap_file") || UringHeapFile::exists("_test_uring_heap_file_not"))
+            return assertion_failure("uring file exists");
+        if (depth == 0 && file.is_async())
+            return assertion_failure("uring file with no queue");
+        char bytes[100];
+        for (BlockID block_id = 1; block_id <= N_BLOCKS; block_id++) {
+            DbBlock *block = block_id == 1 ? file.get(1) : file.get_new();
+            memset(bytes, 'a' + block_id % 26, sizeof(bytes));
+            Dbt data(bytes, sizeof(bytes) - block_id % 50);
+            block->add(&data);
+            file.put(block);
+            delete block;
+        }
+        file.close();
+
+        reopened.open();  // block size and O_DIRECT come from the file
+        if (reopened.get_block_size() != DbBlock::BLOCK_SZ || reopened.get_last_block_id() != N_BLOCKS
+            || reopened.is_direct() != mode.direct)
+            return assertion_failure("uring file header", depth);
+        vector<BlockID> block_ids;
+        for (BlockID block_id = N_BLOCKS / 2; block_id <= N_BLOCKS; block_id++)
+            block_ids.push_back(block_id);
+        reopened.prefetch(block_ids);
+        reopened.wait();
+        if (reopened.is_async() && mode.pooled && pool != nullptr && !pool->contains(&reopened, N_BLOCKS))
+            return assertion_failure("uring prefetch", depth);
+        HeapFile::BlockScan *blocks = reopened.scan_blocks();
+        BlockID n = 0;
+        for (DbBlock *block = blocks->next(); block != nullptr; block = blocks->next()) {
+            u_int16_t size;
+            const char *record = block->view(1, size);
+            if (block->get_block_id() != ++n || record == nullptr || size != sizeof(bytes) - n % 50
+                || record[size - 1] != (char) ('a' + n % 26))
+                return assertion_failure("uring block", n, depth);
+            delete block;
+        }
+        delete blocks;
+        if (n != N_BLOCKS)
+            return assertion_failure("uring scan count", n, depth);
+        if (reopened.find_free_block(1000) == 0)
+            return assertion_failure("uring free-space map", depth);
+        reopened.drop();
+        if (UringHeapFile::exists("_test_uring_heap_file"))
+            return assertion_failure("uring file dropped", depth);
+    }
+    return true;
+}
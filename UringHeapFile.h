@@ -0,0 +1,185 @@
+/**
+ * @file UringHeapFile.h - Heap file kept in a plain file read and written through io_uring.
+ * UringHeapFile: HeapFile
+ *
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <sys/uio.h>
+#include "HeapFile.h"
+#include "BufferPool.h"
+
+/**
+ * @class UringHeapFile - heap file whose blocks live in a plain file that is read and written with io_uring
+ *
+ *      The blocks are kept in <name>.blk in the database environment's directory, one after another at
+        multiples of the block size. Block 0 is a header rather than a block of records:
+            Bytes 0x00 - 0x03: MAGIC
+            Bytes 0x04 - 0x07: block size
+            Bytes 0x08 - 0x0B: number of blocks in use (the last block id)
+            Bytes 0x0C - 0x0F: flags (DIRECT_FILE if the file is read and written with O_DIRECT)
+        Blocks go through the buffer pool as for HeapFile. Reads the pool has to wait for, and writes, are
+        done through an io_uring ring of the file's queue depth; a batch of writes (as from a checkpoint) is
+        submitted together, up to the queue depth at a time.
+        prefetch starts reads of blocks that are about to be wanted without waiting for them: each goes into
+        a staging slot, and is put into the buffer pool when it completes, which is noticed the next time the
+        file submits or waits for anything (and get waits for a block that is on its way). A scan keeps about
+        a queue's worth of blocks in flight ahead of the block it is on.
+        If io_uring isn't there (an old kernel, or one that doesn't allow it) or the queue depth is 0, reads
+        and writes are done with pread and pwrite instead and prefetch just advises the kernel.
+        A file created direct is opened with O_DIRECT from then on, so its blocks are cached only in the buffer
+        pool and not in the operating system's page cache as well. All the memory it reads into or writes from
+        is then aligned (the buffer pool's frames, its staging slots, or a bounce buffer for anything else).
+        If the file system won't do O_DIRECT, the file is read and written through the page cache after all.
+        Everything else (block layout, free-space map) is as for HeapFile. Blocks can't be compressed.
+ */
+class UringHeapFile : public HeapFile {
+public:
+    /**
+     * Marks the header of a UringHeapFile.
+     */
+    static const uint32_t MAGIC = 0x46484c42;  // "BLHF"
+
+    /**
+     * Number of reads and writes a file keeps in flight at once unless told otherwise.
+     */
+    static const uint DEFAULT_QUEUE_DEPTH = 32;
+
+    /**
+     * Header flag of a file that is read and written with O_DIRECT.
+     */
+    static const uint32_t DIRECT_FILE = 0x1;
+
+    UringHeapFile(std::string name, uint block_size = DbBlock::BLOCK_SZ, BlockLayout layout = SLOTTED_PAGE,
+                  const ColumnAttributes &column_attributes = ColumnAttributes(),
+                  uint queue_depth = DEFAULT_QUEUE_DEPTH, bool direct = false);
+
+    virtual ~UringHeapFile();
+
+    UringHeapFile(const UringHeapFile &other) = delete;
+
+    UringHeapFile(UringHeapFile &&temp) = delete;
+
+    UringHeapFile &operator=(const UringHeapFile &other) = delete;
+
+    UringHeapFile &operator=(UringHeapFile &&temp) = delete;
+
+    virtual void create(void);
+
+    virtual void drop(void);
+
+    virtual void open(void);
+
+    virtual void close(void);
+
+    virtual DbBlock *get_new(void);
+
+    virtual DbBlock *get(BlockID block_id);
+
+    virtual void put(DbBlock *block);
+
+    virtual BlockScan *scan_blocks();
+
+    virtual BlockID truncate(BlockID block_id);
+
+    /**
+     * Start reading some blocks into the buffer pool without waiting for them. Blocks already in the pool or
+     * on their way are skipped. If there are more than the queue depth, this waits for room as it goes.
+     * @param block_ids  blocks that are about to be wanted
+     */
+    virtual void prefetch(const std::vector<BlockID> &block_ids);
+
+    /**
+     * Wait for all the prefetched blocks to be read in.
+     */
+    virtual void wait();
+
+    /**
+     * Check if reads and writes are going through io_uring.
+     * @return false if the file is closed or is doing synchronous reads and writes instead
+     */
+    virtual bool is_async() const { return ring != nullptr; }
+
+    /**
+     * Check if the file was created direct.
+     * @return true if it was (only known for certain once the file is open)
+     */
+    virtual bool is_direct() const { return direct; }
+
+    /**
+     * Check if reads and writes are bypassing the operating system's page cache.
+     * @return true if the file is open with O_DIRECT
+     */
+    virtual bool is_direct_io() const { return direct_io; }
+
+    /**
+     * Check if there is a UringHeapFile for the given name (as opposed to another kind of file or none).
+     * @param name  name the file would have been constructed with
+     * @returns     true if there is one
+     */
+    static bool exists(std::string name);
+
+protected:
+    class Ring;
+
+    /**
+     * @class UringHeapFile::PrefetchScan - reads all the blocks in order, prefetching a queue's worth ahead
+     */
+    class PrefetchScan : public BlockScan {
+    public:
+        explicit PrefetchScan(UringHeapFile &file) : BlockScan(file), uring(file), ahead(0) {}
+
+        virtual DbBlock *next();
+
+    protected:
+        UringHeapFile &uring;
+        BlockID ahead;  // last block prefetched
+    };
+
+    static const uint64_t TRANSFER = ~(uint64_t) 0;  // user data of requests that are waited for (not prefetches)
+
+    std::string path;
+    int fd;
+    uint queue_depth;
+    bool direct;                     // created direct (DIRECT_FILE)
+    bool direct_io;                  // open with O_DIRECT
+    Ring *ring;                      // null when doing synchronous reads and writes
+    AlignedBuffer staging;           // a block for each slot
+    AlignedBuffer bounce;            // a block, for reading into or writing from memory that isn't aligned
+    std::vector<BlockID> slot_block;  // block each slot is reading (0 if the slot is free)
+    std::vector<struct iovec> slot_iov;
+    std::vector<uint> free_slots;
+    std::unordered_map<BlockID, uint> in_flight;  // block id -> slot
+    uint transfers_pending;          // TRANSFER requests submitted but not completed
+    bool transfer_failed;            // whether one of them didn't transfer a whole block
+
+    static std::string path_for(std::string name);
+
+    virtual void db_open(uint flags = 0);
+
+    virtual void cut_after(BlockID block_id);
+
+    virtual void read_block(BlockID block_id, Dbt &block, char *into);
+
+    virtual void write_block(BlockID block_id, const char *bytes);
+
+    virtual void write_blocks(const std::vector<std::pair<BlockID, const char *>> &blocks);
+
+    virtual void write_header();
+
+    virtual void settle(BlockID block_id);
+
+    virtual void reap(uint wait_for);
+
+    virtual void transfer(bool write, BlockID block_id, char *bytes);
+
+    virtual void finish_transfers();
+
+    friend class PrefetchScan;
+};
+
+bool test_uring_heap_file();
@@ -0,0 +1,359 @@
+/**
+ * @file ZoneMap.cpp - implementation of ZoneMap
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#include <algorithm>
+#include <cstring>
+#include "ZoneMap.h"
+#include "SlottedPage.h"
+
+using namespace std;
+
+const char ZoneMap::ZONE_EMPTY;
+const char ZoneMap::ZONE_ROWS;
+
+/**
+ * Constructor
+ * @param name               name of the heap file the zones are for (the side file is <name>.zone.db)
+ * @param column_names       the rows' columns
+ * @param column_attributes  their types
+ */
+ZoneMap::ZoneMap(string name, const ColumnNames &column_names, const ColumnAttributes &column_attributes)
+        : name(name), dbfilename(name + ".zone.db"), column_names(column_names), data_types(), offsets(),
+          zone_size(1), zones(), dirty(), closed(true), db(_DB_ENV, 0) {
+    for (auto const &column_attribute: column_attributes) {
+        ColumnAttribute::DataType data_type = column_attribute.get_data_type();
+        this->data_types.push_back(data_type);
+        this->offsets.push_back(this->zone_size);
+        if (data_type == ColumnAttribute::INT)
+            this->zone_size += 2 * sizeof(int32_t);
+        else if (data_type == ColumnAttribute::BOOLEAN)
+            this->zone_size += 2 * sizeof(uint8_t);
+        else
+            this->zone_size += 2 * (1 + TEXT_PREFIX_SZ);
+    }
+}
+
+/**
+ * Make a new, empty side file (of a new heap file).
+ */
+void ZoneMap::create() {
+    if (!this->closed)
+        return;
+    this->db.set_re_len(this->zone_size);
+    db_open(DB_CREATE | DB_EXCL);
+    this->zones.clear();
+}
+
+/**
+ * Open the side file and read in the zones of the heap file's blocks, if it isn't open already.
+ * @param blocks  how many blocks the heap file has
+ * @return        false if there wasn't a side file, so one was made, with every block's zone empty
+ */
+bool ZoneMap::open(BlockID blocks) {
+    if (!this->closed)
+        return true;
+    bool found = true;
+    try {
+        Db probe(_DB_ENV, 0);
+        probe.open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, 0, 0644);
+        probe.close(0);
+    } catch (DbException &e) {
+        found = false;
+    }
+    if (!found) {
+        this->db.set_re_len(this->zone_size);
+        db_open(DB_CREATE);
+        reset(blocks);
+        return false;
+    }
+    db_open(0);
+    this->zones.assign(blocks * this->zone_size, ZONE_EMPTY);
+    for (uint32_t block_id = 1; block_id <= blocks; block_id++) {
+        Dbt key(&block_id, sizeof(block_id));
+        Dbt data;
+        if (this->db.get(nullptr, &key, &data, 0) == 0 && data.get_size() == this->zone_size)
+            memcpy(zone(block_id), data.get_data(), this->zone_size);
+    }
+    return true;
+}
+
+/**
+ * Close the side file.
+ */
+void ZoneMap::close() {
+    if (this->closed)
+        return;
+    flush();
+    this->db.close(0);
+    this->closed = true;
+}
+
+/**
+ * Delete the side file.
+ */
+void ZoneMap::drop() {
+    close();
+    try {
+        Db db(_DB_ENV, 0);
+        db.remove(this->dbfilename.c_str(), nullptr, 0);
+    } catch (DbException &e) {
+        // table made before there were zone maps
+    }
+}
+
+/**
+ * Start over with every block's zone empty.
+ * @param blocks  how many blocks the heap file has now (the zones of any after them are thrown away)
+ */
+void ZoneMap::reset(BlockID blocks) {
+    for (uint32_t block_id = blocks + 1; block_id <= this->zones.size() / this->zone_size; block_id++) {
+        Dbt key(&block_id, sizeof(block_id));
+        this->db.del(nullptr, &key, 0);
+    }
+    this->zones.assign(blocks * this->zone_size, ZONE_EMPTY);
+    this->dirty.clear();
+    for (BlockID block_id = 1; block_id <= blocks; block_id++)
+        this->dirty.push_back(block_id);
+}
+
+/**
+ * Widen a block's zone to take in a row. It gets written out with the next flush.
+ * @param block_id  the row's block
+ * @param row       the row (every column has to be there)
+ */
+void ZoneMap::add(BlockID block_id, const ValueDict &row) {
+    char *bytes = zone(block_id);
+    bool empty = bytes[0] == ZONE_EMPTY;
+    bool changed = empty;
+    for (uint col_num = 0; col_num < this->column_names.size(); col_num++) {
+        const Value &value = row.at(this->column_names[col_num]);
+        char *low = bytes + this->offsets[col_num];
+        if (this->data_types[col_num] == ColumnAttribute::INT) {
+            int32_t n = value.n;
+            char *high = low + sizeof(int32_t);
+            if (empty || n < *(int32_t *) low) {
+                *(int32_t *) low = n;
+                changed = true;
+            }
+            if (empty || n > *(int32_t *) high) {
+                *(int32_t *) high = n;
+                changed = true;
+            }
+        } else if (this->data_types[col_num] == ColumnAttribute::BOOLEAN) {
+            uint8_t n = (uint8_t) value.n;
+            char *high = low + sizeof(uint8_t);
+            if (empty || n < *(uint8_t *) low) {
+                *(uint8_t *) low = n;
+                changed = true;
+            }
+            if (empty || n > *(uint8_t *) high) {
+                *(uint8_t *) high = n;
+                changed = true;
+            }
+        } else {
+            string text = prefix(value.s);
+            char *high = low + 1 + TEXT_PREFIX_SZ;
+            if (empty || text < get_text(low)) {
+                put_text(text, low);
+                changed = true;
+            }
+            if (empty || text > get_text(high)) {
+                put_text(text, high);
+                changed = true;
+            }
+        }
+    }
+    bytes[0] = ZONE_ROWS;
+    if (changed && (this->dirty.empty() || this->dirty.back() != block_id))  // rows mostly go in a block at a time
+        this->dirty.push_back(block_id);
+}
+
+/**
+ * Empty a block's zone, once the block has no rows. It gets written out with the next flush.
+ * @param block_id  the block
+ */
+void ZoneMap::clear(BlockID block_id) {
+    char *bytes = zone(block_id);
+    if (bytes[0] == ZONE_EMPTY)
+        return;
+    bytes[0] = ZONE_EMPTY;
+    this->dirty.push_back(block_id);
+}
+
+/**
+ * Write out the zones changed since the last flush.
+ */
+void ZoneMap::flush() {
+    if (this->dirty.empty())
+        return;
+    sort(this->dirty.begin(), this->dirty.end());
+    this->dirty.erase(unique(this->dirty.begin(), this->dirty.end()), this->dirty.end());
+    for (uint32_t block_id: this->dirty) {
+        Dbt key(&block_id, sizeof(block_id));
+        Dbt data(zone(block_id), this->zone_size);
+        this->db.put(nullptr, &key, &data, 0);
+    }
+    this->dirty.clear();
+}
+
+/**
+ * Check which blocks might have rows that satisfy a where clause.
+ * @param where   column values to match (columns the map doesn't have are left for the rows to be checked on)
+ * @param blocks  how many blocks the heap file has
+ * @return        for each block id less one, false if the block certainly has no such rows
+ */
+vector<bool> ZoneMap::might_match(const ValueDict *where, BlockID blocks) const {
+    vector<bool> candidates(blocks, true);
+    if (where == nullptr)
+        return candidates;
+    struct Term {
+        uint col_num;
+        const Value *value;
+        string text;
+    };
+    vector<Term> terms;
+    for (auto const &column: *where) {
+        auto found = find(this->column_names.begin(), this->column_names.end(), column.first);
+        if (found == this->column_names.end())
+            continue;
+        uint col_num = (uint) (found - this->column_names.begin());
+        if (column.second.data_type != this->data_types[col_num])
+            return vector<bool>(blocks, false);  // no row has a value of the wrong type
+        terms.push_back(Term{col_num, &column.second, prefix(column.second.s)});
+    }
+
+    BlockID known = min(blocks, (BlockID) (this->zones.size() / this->zone_size));
+    for (BlockID block_id = 1; block_id <= known; block_id++) {
+        const char *bytes = this->zones.data() + (block_id - 1) * this->zone_size;
+        bool in = bytes[0] != ZONE_EMPTY;
+        for (auto term = terms.begin(); in && term != terms.end(); term++) {
+            const char *low = bytes + this->offsets[term->col_num];
+            ColumnAttribute::DataType data_type = this->data_types[term->col_num];
+            if (data_type == ColumnAttribute::INT) {
+                int32_t n = term->value->n;
+                in = *(const int32_t *) low <= n && n <= *(const int32_t *) (low + sizeof(int32_t));
+            } else if (data_type == ColumnAttribute::BOOLEAN) {
+                uint8_t n = (uint8_t) term->value->n;
+                in = *(const uint8_t *) low <= n && n <= *(const uint8_t *) (low + sizeof(uint8_t));
+            } else {
+                in = get_text(low) <= term->text && term->text <= get_text(low + 1 + TEXT_PREFIX_SZ);
+            }
+        }
+        candidates[block_id - 1] = in;
+    }
+    return candidates;
+}
+
+/**
+ * Find a block's zone, making room for it (empty) if it is past the ones there are so far.
+ * @param block_id  the block
+ * @return          its zone
+ */
+char *ZoneMap::zone(BlockID block_id) {
+    if (block_id * this->zone_size > this->zones.size())
+        this->zones.resize(block_id * this->zone_size, ZONE_EMPTY);
+    return this->zones.data() + (block_id - 1) * this->zone_size;
+}
+
+/**
+ * Open the side file.
+ * @param flags  BerkDb flags
+ */
+void ZoneMap::db_open(uint flags) {
+    this->db.open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags, 0644);
+    this->dirty.clear();
+    this->closed = false;
+}
+
+/**
+ * The part of a TEXT value its bounds are kept on. Cutting values short keeps them in the same order (or makes
+ * them equal), so a value outside the bounds of the prefixes is outside the bounds of the values.
+ * @param text  the value
+ * @return      its first TEXT_PREFIX_SZ bytes
+ */
+string ZoneMap::prefix(const string &text) {
+    return text.size() <= TEXT_PREFIX_SZ ? text : text.substr(0, TEXT_PREFIX_SZ);
+}
+
+string ZoneMap::get_text(const char *bytes) {
+    return string(bytes + 1, min((uint) (uint8_t) bytes[0], TEXT_PREFIX_SZ));
+}
+
+void ZoneMap::put_text(const string &text, char *bytes) {
+    bytes[0] = (char) text.size();
+    memcpy(bytes + 1, text.data(), text.size());
+}
+
+bool test_zone_map() {
+    ColumnNames column_names = {"a", "b", "c"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::BOOLEAN)};
+    ZoneMap zones("_test_zone_map", column_names, column_attributes);
+    zones.drop();  // in case an earlier run left one
+    if (zones.open(3))
+        return assertion_failure("new side file");
+    ValueDict row;
+    for (int i = 0; i < 10; i++) {
+        row["a"] = Value(i);
+        row["b"] = Value(i < 5 ? "apple" + to_string(i) : "zucchini and more " + to_string(i));
+        row["c"] = Value(0);
+        row["c"].data_type = ColumnAttribute::BOOLEAN;
+        zones.add(i < 5 ? 1 : 2, row);
+    }
+    zones.flush();
+
+    ValueDict where;
+    where["a"] = Value(7);
+    vector<bool> expected = {false, true, false, true};  // block 3 is empty; block 4 isn't known of, so could be
+    if (zones.might_match(&where, 4) != expected)
+        return assertion_failure("INT bounds");
+    where["a"] = Value(-1);
+    if (zones.might_match(&where, 3) != vector<bool>(3, false))
+        return assertion_failure("INT outside");
+    where.clear();
+    where["b"] = Value("apple3");
+    expected = {true, false, false};
+    if (zones.might_match(&where, 3) != expected)
+        return assertion_failure("TEXT bounds");
+    where["b"] = Value("zucchini and less");  // same prefix as values in block 2, so it might be there
+    expected = {false, true, false};
+    if (zones.might_match(&where, 3) != expected)
+        return assertion_failure("TEXT prefix");
+    where["b"] = Value("banana");
+    if (zones.might_match(&where, 3) != vector<bool>(3, false))
+        return assertion_failure("TEXT between");
+    where.clear();
+    where["c"] = Value(1);
+    where["c"].data_type = ColumnAttribute::BOOLEAN;
+    if (zones.might_match(&where, 3) != vector<bool>(3, false))
+        return assertion_failure("BOOLEAN bounds");
+    where["c"] = Value(1);  // an INT, which no BOOLEAN column has
+    if (zones.might_match(&where, 3) != vector<bool>(3, false))
+        return assertion_failure("wrong type");
+    if (zones.might_match(nullptr, 3) != vector<bool>(3, true))
+        return assertion_failure("no where clause");
+
+    // zones come back as they were written, and an emptied block matches nothing
+    zones.clear(1);
+    zones.close();
+    if (!zones.open(3))
+        return assertion_failure("existing side file");
+    where.clear();
+    where["a"] = Value(7);
+    expected = {false, true, false};
+    if (zones.might_match(&where, 3) != expected)
+        return assertion_failure("reopened");
+    where["a"] = Value(2);
+    if (zones.might_match(&where, 3) != vector<bool>(3, false))
+        return assertion_failure("cleared");
+    zones.reset(1);
+    zones.flush();
+    where["a"] = Value(7);
+    expected = {false, true, true};  // only block 1 is known of now
+    if (zones.might_match(&where, 3) != expected)
+        return assertion_failure("reset");
+    zones.drop();
+    return true;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file ZoneMap.h - Per-block bounds on the values of a table's columns, for passing over blocks in scans.
+ * ZoneMap
+ *
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include "db_cxx.h"
+#include "storage_engine.h"
+
+/**
+ * @class ZoneMap - the smallest and biggest value of each column among the rows of each block of a heap file
+ *
+ *      Each block's zone is a fixed-length record in a Berkeley DB RecNo side file (<name>.zone.db, record number
+        the block id), read in whole when the map is opened and written out by flush (or close) as it changes:
+            state:     ZONE_EMPTY if the block has no rows (also what a missing record means), else ZONE_ROWS
+            bounds:    for each column in order, its smallest value then its biggest
+                       INT:      4 bytes each
+                       BOOLEAN:  1 byte each
+                       TEXT:     1-byte length then the first TEXT_PREFIX_SZ bytes, each (so the bounds are on
+                                 the values' prefixes, which is all a check for equality needs)
+        Zones only ever widen as rows are added; deleting rows leaves them as they are (still true, just not as
+        tight) until the block has no rows left. So a block whose zone doesn't take in a value has no row with it.
+        There are no NULLs in this engine, so a zone has no null flag; the state says whether there are any rows.
+        Like the free-space map, the zone map is kept in step only by whoever has the file open, and blocks past
+        the ones it knows of are never passed over.
+ */
+class ZoneMap {
+public:
+    static const char ZONE_EMPTY = 0;
+    static const char ZONE_ROWS = 1;
+    static const uint TEXT_PREFIX_SZ = 8;
+
+    /**
+     * Constructor
+     * @param name               name of the heap file the zones are for (the side file is <name>.zone.db)
+     * @param column_names       the rows' columns
+     * @param column_attributes  their types
+     */
+    ZoneMap(std::string name, const ColumnNames &column_names, const ColumnAttributes &column_attributes);
+
+    virtual ~ZoneMap() {}
+
+    ZoneMap(const ZoneMap &other) = delete;
+
+    ZoneMap &operator=(const ZoneMap &other) = delete;
+
+    /**
+     * Make a new, empty side file (of a new heap file).
+     */
+    virtual void create();
+
+    /**
+     * Open the side file and read in the zones of the heap file's blocks, if it isn't open already.
+     * @param blocks  how many blocks the heap file has
+     * @return        false if there wasn't a side file, so one was made, with every block's zone empty
+     *                (the caller has to work the zones out from the blocks, see reset and add)
+     */
+    virtual bool open(BlockID blocks);
+
+    virtual void close();
+
+    /**
+     * Delete the side file.
+     */
+    virtual void drop();
+
+    virtual bool is_open() const { return !this->closed; }
+
+    /**
+     * Start over with every block's zone empty.
+     * @param blocks  how many blocks the heap file has now (the zones of any after them are thrown away)
+     */
+    virtual void reset(BlockID blocks);
+
+    /**
+     * Widen a block's zone to take in a row. It gets written out with the next flush.
+     * @param block_id  the row's block
+     * @param row       the row (every column has to be there)
+     */
+    virtual void add(BlockID block_id, const ValueDict &row);
+
+    /**
+     * Empty a block's zone, once the block has no rows. It gets written out with the next flush.
+     * @param block_id  the block
+     */
+    virtual void clear(BlockID block_id);
+
+    /**
+     * Write out the zones changed since the last flush.
+     */
+    virtual void flush();
+
+    /**
+     * Check which blocks might have rows that satisfy a where clause.
+     * @param where   column values to match (columns the map doesn't have are left for the rows to be checked on)
+     * @param blocks  how many blocks the heap file has
+     * @return        for each block id less one, false if the block certainly has no such rows
+     */
+    virtual std::vector<bool> might_match(const ValueDict *where, BlockID blocks) const;
+
+protected:
+    std::string name;
+    std::string dbfilename;
+    ColumnNames column_names;
+    std::vector<ColumnAttribute::DataType> data_types;
+    std::vector<uint> offsets;  // where each column's bounds are in a zone
+    uint zone_size;
+    std::vector<char> zones;    // zone_size bytes for each block, in block order
+    std::vector<BlockID> dirty;
+    bool closed;
+    Db db;
+
+    char *zone(BlockID block_id);
+
+    void db_open(uint flags);
+
+    static std::string prefix(const std::string &text);
+
+    static std::string get_text(const char *bytes);
+
+    static void put_text(const std::string &text, char *bytes);
+};
+
+bool test_zone_map();
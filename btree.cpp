@@ -5,16 +5,9 @@
  */
 #include "btree.h"
 
-BTreeIndex::BTreeIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique) : DbIndex(relation,
-                                                                                                              name,
-                                                                                                              key_columns,
-                                                                                                              unique),
-                                                                                                      closed(true),
-                                                                                                      stat(nullptr),
-                                                                                                      root(nullptr),
-                                                                                                      file(relation.get_table_name() +
-                                                                                                           "-" + name),
-                                                                                                      key_profile() {
+BTreeIndex::BTreeIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique, uint block_size)
+        : DbIndex(relation, name, key_columns, unique), closed(true), stat(nullptr), root(nullptr),
+          file(relation.get_table_name() + "-" + name, block_size), key_profile() {
     if (!unique)
         throw DbRelationError("BTree index must have unique key");
     build_key_profile();
@@ -31,8 +24,9 @@ void BTreeIndex::create() {
     stat = new BTreeStat(file, STAT, STAT + 1, key_profile);
     root = new BTreeLeaf(file, stat->get_root_id(), key_profile, true);
     closed = false;
-    Handles *table_rows = relation.select();
-    for (auto const &row: *table_rows)
+    DbHandleIterator *table_rows = relation.scan();
+    Handle row;
+    while (table_rows->next(row))
         insert(row);
     delete table_rows;
 }
@@ -51,7 +45,7 @@ void BTreeIndex::open() {
             root = new BTreeLeaf(file, stat->get_root_id(), key_profile, false);
         else
             root = new BTreeInterior(file, stat->get_root_id(), key_profile, false);
-        closed = true;
+        closed = false;
     }
 }
 
@@ -71,7 +65,9 @@ void BTreeIndex::close() {
 // names in the index. Returns a list of row handles.
 Handles *BTreeIndex::lookup(ValueDict *key_dict) const {
     KeyValue *key = tkey(key_dict);
-    return _lookup(root, stat->get_height(), key);
+    Handles *handles = _lookup(root, stat->get_height(), key);
+    delete key;
+    return handles;
 }
 
 // Recursive call from lookup method above
@@ -84,11 +80,16 @@ Handles *BTreeIndex::_lookup(BTreeNode *node, uint height, const KeyValue *key)
             handles->push_back(dynamic_cast<BTreeLeaf*>(node)->find_eq(key));
         }
         catch(...) {}
+        if (node != root)
+            delete node;
         return handles;
     }
     else
     {
-        return _lookup(dynamic_cast<BTreeInterior*>(node)->find(key, height), height - 1, key);
+        BTreeNode *child = dynamic_cast<BTreeInterior*>(node)->find(key, height);
+        if (node != root)
+            delete node;
+        return _lookup(child, height - 1, key);
     }
 }
 
@@ -100,7 +101,7 @@ Handles *BTreeIndex::range(ValueDict *min_key, ValueDict *max_key) const {
 // Insert a row with the given handle. Row must exist in relation already.
 void BTreeIndex::insert(Handle handle) {
     open();
-    ValueDict *key = relation.project(handle);
+    ValueDict *key = relation.project(handle, &key_columns);
     KeyValue *tkey = this->tkey(key);
     Insertion insertion = _insert(root, stat->get_height(), tkey, handle);
     if (!BTreeNode::insertion_is_none(insertion)) {
@@ -126,16 +127,56 @@ Insertion BTreeIndex::_insert(BTreeNode *node, uint height, const KeyValue *key,
         return leaf->insert(key, handle);
     } else {
         auto *interior = dynamic_cast<BTreeInterior *>(node);
-        Insertion insertion = _insert(interior->find(key, height), height - 1, key, handle);
+        BTreeNode *child = interior->find(key, height);
+        Insertion insertion = _insert(child, height - 1, key, handle);
+        delete child;
         if (!BTreeNode::insertion_is_none(insertion))
             insertion = interior->insert(&insertion.second, insertion.first);
         return insertion;
     }
 }
 
+// Delete the entry for a row (which must still be in the relation, to get its key from). Leaves that lose keys
+// aren't merged; they just have fewer of them.
 void BTreeIndex::del(Handle handle) {
-    throw DbRelationError("Don't know how to delete from a BTree index yet");
-    // Implementation not required for Milestone 6
+    open();
+    ValueDict *key = relation.project(handle, &key_columns);
+    KeyValue *tkey = this->tkey(key);
+    delete key;
+    BTreeLeaf *leaf = find_leaf(tkey);
+    bool found = leaf->del(tkey, handle);
+    if (leaf != root)
+        delete leaf;
+    delete tkey;
+    if (!found)
+        throw DbRelationError("no index entry for the deleted row");
+}
+
+// Point the entry for a row that has moved (keeping its key) at the row's new handle.
+void BTreeIndex::move(Handle from, Handle to) {
+    open();
+    ValueDict *key = relation.project(to, &key_columns);
+    KeyValue *tkey = this->tkey(key);
+    delete key;
+    BTreeLeaf *leaf = find_leaf(tkey);
+    bool found = leaf->move(tkey, from, to);
+    if (leaf != root)
+        delete leaf;
+    delete tkey;
+    if (!found)
+        throw DbRelationError("no index entry for the moved row");
+}
+
+// Go down from the root to the leaf where a key is or would be (freed by caller unless it is the root).
+BTreeLeaf *BTreeIndex::find_leaf(const KeyValue *key) const {
+    BTreeNode *node = root;
+    for (uint height = stat->get_height(); height > 1; height--) {
+        BTreeNode *child = dynamic_cast<BTreeInterior *>(node)->find(key, height);
+        if (node != root)
+            delete node;
+        node = child;
+    }
+    return dynamic_cast<BTreeLeaf *>(node);
 }
 
 KeyValue *BTreeIndex::tkey(const ValueDict *key) const {
@@ -184,8 +225,6 @@ bool test_btree() {
     column_names.push_back("a");
     BTreeIndex index(table, "fooindex", column_names, true);
     index.create();
-    return true;  // FIXME
-
 
     ValueDict lookup;
     lookup["a"] = 12;
@@ -253,6 +292,9 @@ bool test_btree() {
         return false;
     }
     delete handles;
+    index.drop();
+    table.drop();
+    return true;  // FIXME: range isn't done yet
 
     // test range
     ValueDict minkey, maxkey;
@@ -10,7 +10,8 @@
 
 class BTreeIndex : public DbIndex {
 public:
-    BTreeIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique);
+    BTreeIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique,
+               uint block_size = DbBlock::BLOCK_SZ);
 
     virtual ~BTreeIndex();
 
@@ -30,6 +31,8 @@ public:
 
     virtual void del(Handle handle);
 
+    virtual void move(Handle from, Handle to);
+
     virtual KeyValue *tkey(const ValueDict *key) const; // pull out the key values from the ValueDict in order
 
 protected:
@@ -45,6 +48,8 @@ protected:
     Handles *_lookup(BTreeNode *node, uint height, const KeyValue *key) const;
 
     Insertion _insert(BTreeNode *node, uint height, const KeyValue *key, Handle handle);
+
+    BTreeLeaf *find_leaf(const KeyValue *key) const;
 };
 
 bool test_btree();
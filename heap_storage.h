@@ -1,7 +1,12 @@
 /**
  * @file heap_storage.h - Implementation of storage_engine with a heap file structure.
  * SlottedPage: DbBlock
+ * PaxPage: DbBlock
+ * LZCodec
+ * BufferPool
  * HeapFile: DbFile
+ * MmapHeapFile: HeapFile
+ * UringHeapFile: HeapFile
  * HeapTable: DbRelation
  *
  * @author Kevin Lundeen
@@ -9,6 +14,12 @@
  */
 #pragma once
 #include "SlottedPage.h"
+#include "PaxPage.h"
+#include "LZCodec.h"
+#include "BufferPool.h"
 #include "HeapFile.h"
+#include "MmapHeapFile.h"
+#include "UringHeapFile.h"
+#include "ZoneMap.h"
 #include "HeapTable.h"
 
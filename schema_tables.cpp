@@ -49,6 +49,7 @@ bool is_acceptable_data_type(std::string dt) {
  */
 const Identifier Tables::TABLE_NAME = "_tables";
 Columns *Tables::columns_table = nullptr;
+HeapTable::StorageEngine Tables::new_table_engine = HeapTable::BERKELEY_DB;
 std::map<Identifier, DbRelation *> Tables::table_cache;
 
 // get the column name for _tables column
@@ -155,15 +156,29 @@ DbRelation &Tables::get_table(Identifier table_name) {
     if (Tables::table_cache.find(table_name) != Tables::table_cache.end())
         return *Tables::table_cache[table_name];
 
-    // otherwise assume it is a HeapTable (for now)
+    // otherwise assume it is a HeapTable (for now), kept by whichever engine already has a file for it
     ColumnNames column_names;
     ColumnAttributes column_attributes;
     get_columns(table_name, column_names, column_attributes);
-    DbRelation *table = new HeapTable(table_name, column_names, column_attributes);
+    HeapTable::StorageEngine engine = HeapTable::BERKELEY_DB;
+    if (MmapHeapFile::exists(table_name))
+        engine = HeapTable::MMAP;
+    else if (UringHeapFile::exists(table_name))
+        engine = HeapTable::URING;  // the file itself says whether it is direct
+    else if (!HeapFile::exists(table_name))
+        engine = Tables::new_table_engine;
+    DbRelation *table = new HeapTable(table_name, column_names, column_attributes, DbBlock::BLOCK_SZ,
+                                      HeapFile::SLOTTED_PAGE, false, engine);
     Tables::table_cache[table_name] = table;
     return *table;
 }
 
+// Checkpoint every table in the cache.
+void Tables::checkpoint_tables() {
+    for (auto const &cached: Tables::table_cache)
+        cached.second->checkpoint();
+}
+
 
 /*
  * ****************************
@@ -405,7 +420,14 @@ DbIndex &Indices::get_index(Identifier table_name, Identifier index_name) {
     if (is_hash) {
         index = new DummyIndex(table, index_name, column_names, is_unique);  // FIXME - change to HashIndex
     } else {
-        index = new BTreeIndex(table, index_name, column_names, is_unique);
+        // the index's blocks are the size of its table's (whatever size the table's file was made with)
+        uint block_size = DbBlock::BLOCK_SZ;
+        HeapTable *heap_table = dynamic_cast<HeapTable *>(&table);
+        if (heap_table != nullptr) {
+            heap_table->open();
+            block_size = heap_table->get_file().get_block_size();
+        }
+        index = new BTreeIndex(table, index_name, column_names, is_unique, block_size);
     }
     Indices::index_cache[cache_key] = index;
     return *index;
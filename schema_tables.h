@@ -60,6 +60,17 @@ public:
      */
     static DbRelation &get_table(Identifier table_name);
 
+    /**
+     * Checkpoint every table instantiated so far (see DbRelation::checkpoint).
+     */
+    static void checkpoint_tables();
+
+    /**
+     * Storage engine get_table uses for a table that doesn't have a file yet (one that is being created).
+     * A table that already has one keeps using whatever engine made it.
+     */
+    static HeapTable::StorageEngine new_table_engine;
+
 protected:
     // hard-coded columns for _tables table
     static ColumnNames &COLUMN_NAMES();
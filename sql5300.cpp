@@ -3,7 +3,10 @@
  * @author Kevin Lundeen
  * @see "Seattle University, cpsc4300/5300, Spring 2022"
  */
+#include <algorithm>
+#include <cctype>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include "db_cxx.h"
@@ -11,6 +14,7 @@
 #include "ParseTreeToString.h"
 #include "SQLExec.h"
 #include "btree.h"
+#include "storage_bench.h"
 
 using namespace std;
 using namespace hsql;
@@ -20,19 +24,36 @@ using namespace hsql;
  */
 void initialize_environment(char *envHome);
 
+/*
+ * choose the storage engine for new tables (and remember it for the database environment)
+ */
+bool choose_storage(string name);
+
+/*
+ * check if a line is one of the shell's own commands (not SQL), which are case-insensitive and may be followed by
+ * a semicolon, and if so set rest to whatever comes after the command word (trimmed)
+ */
+bool shell_command(const string &query, const string &command, string &rest);
+
 
 /**
  * Main entry point of the sql5300 program
  * @args dbenvpath  the path to the BerkeleyDB database environment
+ * @args engine     optional storage engine for new tables in this environment from now on (bdb, mmap, uring,
+ *                  or direct)
  */
 int main(int argc, char *argv[]) {
 
     // Open/create the db environment
-    if (argc != 2) {
-        cerr << "Usage: cpsc5300: dbenvpath" << endl;
+    if (argc != 2 && argc != 3) {
+        cerr << "Usage: cpsc5300: dbenvpath [bdb|mmap|uring|direct]" << endl;
         return EXIT_FAILURE;
     }
     initialize_environment(argv[1]);
+    if (argc == 3 && !choose_storage(argv[2])) {
+        cerr << "(sql5300: no storage engine " << argv[2] << ")" << endl;
+        return EXIT_FAILURE;
+    }
 
     // Enter the SQL shell loop
     while (true) {
@@ -41,13 +62,47 @@ int main(int argc, char *argv[]) {
         getline(cin, query);
         if (query.length() == 0)
             continue;  // blank line -- just skip
-        if (query == "quit")
+        string rest;
+        if (shell_command(query, "quit", rest) && rest.empty()) {
+            _BUFFER_POOL->checkpoint();
             break;  // only way to get out
-        if (query == "test") {
+        }
+        if (shell_command(query, "test", rest) && rest.empty()) {
             cout << "test_heap_storage: " << (test_heap_storage() ? "ok" : "failed") << endl;
             cout << "test_btree: " << (test_btree() ? "ok" : "failed") << endl;
             continue;
         }
+        if (shell_command(query, "bench", rest) && rest.empty()) {
+            run_storage_benchmarks();
+            continue;
+        }
+        if (shell_command(query, "checkpoint", rest) && rest.empty()) {
+            ulong writes = _BUFFER_POOL->get_writes();
+            _BUFFER_POOL->checkpoint();
+            cout << "(wrote " << _BUFFER_POOL->get_writes() - writes << " blocks)" << endl;
+            continue;
+        }
+        if (shell_command(query, "vacuum", rest)) {
+            if (rest.empty()) {
+                cout << "Error: vacuum needs a table name" << endl;
+                continue;
+            }
+            try {
+                QueryResult *result = SQLExec::vacuum(rest);
+                cout << *result << endl;
+                delete result;
+            } catch (SQLExecError &e) {
+                cout << "Error: " << e.what() << endl;
+            }
+            continue;
+        }
+        if (shell_command(query, "storage", rest) && !rest.empty()) {
+            if (choose_storage(rest))
+                cout << "(new tables will be kept in " << rest << " files)" << endl;
+            else
+                cout << "(no storage engine " << rest << ")" << endl;
+            continue;
+        }
 
         // parse and execute
         SQLParserResult *parse = SQLParser::parseSQLString(query);
@@ -73,6 +128,51 @@ int main(int argc, char *argv[]) {
 }
 
 DbEnv *_DB_ENV;
+BufferPool *_BUFFER_POOL;
+
+/*
+ * names of the storage engines, in HeapTable::StorageEngine order
+ */
+static const char *STORAGE_ENGINES[] = {"bdb", "mmap", "uring", "direct"};
+static const int N_STORAGE_ENGINES = sizeof(STORAGE_ENGINES) / sizeof(STORAGE_ENGINES[0]);
+
+/*
+ * file in the database environment's directory naming its storage engine for new tables
+ */
+static string storage_filename() {
+    const char *home = nullptr;
+    _DB_ENV->get_home(&home);
+    return string(home == nullptr ? "." : home) + "/sql5300.storage";
+}
+
+bool choose_storage(string name) {
+    for (int engine = 0; engine < N_STORAGE_ENGINES; engine++)
+        if (name == STORAGE_ENGINES[engine]) {
+            Tables::new_table_engine = (HeapTable::StorageEngine) engine;
+            ofstream(storage_filename()) << name << endl;
+            return true;
+        }
+    return false;
+}
+
+bool shell_command(const string &query, const string &command, string &rest) {
+    const char *space = " \t\r\n";
+    size_t begin = query.find_first_not_of(space), end = query.find_last_not_of(space);
+    if (begin == string::npos)
+        return false;
+    string line = query.substr(begin, end - begin + 1);
+    if (line.back() == ';')
+        line = line.substr(0, line.find_last_not_of(space, line.length() - 2) + 1);
+    size_t word_end = min(line.find_first_of(space), line.length());
+    if (word_end != command.length())
+        return false;
+    for (size_t i = 0; i < word_end; i++)
+        if (tolower(line[i]) != command[i])
+            return false;
+    size_t rest_begin = line.find_first_not_of(space, word_end);
+    rest = rest_begin == string::npos ? "" : line.substr(rest_begin);
+    return true;
+}
 
 void initialize_environment(char *envHome) {
     cout << "(sql5300: running with database environment at " << envHome << ")" << endl;
@@ -87,5 +187,11 @@ void initialize_environment(char *envHome) {
         exit(1);
     }
     _DB_ENV = env;
+    _BUFFER_POOL = new BufferPool();
     initialize_schema_tables();
+
+    // pick up the storage engine this environment was last told to use
+    string name;
+    if (ifstream(storage_filename()) >> name && choose_storage(name))
+        cout << "(sql5300: new tables will be kept in " << name << " files)" << endl;
 }
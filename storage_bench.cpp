@@ -0,0 +1,1036 @@
+/**
+ * @file storage_bench.cpp - micro-benchmarks for the storage engine
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include "storage_bench.h"
+#include "btree.h"
+
+using namespace std;
+typedef uint16_t u16;
+
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"  // gcc can't tell these replace the global new/delete
+#endif
+
+/*
+ * Count every heap allocation so the benchmarks can report allocations per row.
+ * (Replacing the global operator new is the only portable way to see them.) This is linked into sql5300, where
+ * parallel selects allocate from worker threads, so the count is atomic; relaxed is enough for a tally.
+ */
+static atomic<unsigned long> allocation_count(0);
+
+static unsigned long allocations_so_far() {
+    return allocation_count.load(memory_order_relaxed);
+}
+
+void *operator new(size_t size) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+/**
+ * Stopwatch for the benchmarks.
+ */
+class BenchTimer {
+public:
+    BenchTimer() : start(chrono::steady_clock::now()) {}
+
+    double elapsed_ns() const {
+        return (double) chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    }
+
+protected:
+    chrono::steady_clock::time_point start;
+};
+
+// Fill a list of in-memory pages with copies of the given record.
+static void bench_fill_pages(vector<SlottedPage *> &pages, const Dbt &record, uint n_pages,
+                             bool deferred_compaction = false) {
+    for (BlockID block_id = 1; block_id <= n_pages; block_id++) {
+        Dbt block(new char[DbBlock::BLOCK_SZ], DbBlock::BLOCK_SZ);
+        SlottedPage *page = new SlottedPage(block, block_id, true, deferred_compaction);
+        try {
+            while (true)
+                page->add(&record);
+        } catch (DbBlockNoRoomError &e) {
+            // page is full
+        }
+        pages.push_back(page);
+    }
+}
+
+// Free the in-memory pages made by bench_fill_pages.
+static void bench_free_pages(vector<SlottedPage *> &pages) {
+    for (auto const &page: pages) {
+        delete[] (char *) page->get_data();
+        delete page;
+    }
+    pages.clear();
+}
+
+// A typical (INT, TEXT) row, marshaled.
+static const string BENCH_TEXT = "Four score and seven years ago our fathers brought forth on this continent, a new nation";
+
+static Dbt bench_record(char *bytes) {
+    const uint text_start = sizeof(int32_t) + sizeof(u16);
+    *(int32_t *) bytes = 1863;
+    *(u16 *) (bytes + sizeof(int32_t)) = (u16) (text_start + BENCH_TEXT.size());
+    memcpy(bytes + text_start, BENCH_TEXT.c_str(), BENCH_TEXT.size());
+    return Dbt(bytes, (u_int32_t) (text_start + BENCH_TEXT.size()));
+}
+
+void bench_record_access() {
+    const uint N_PAGES = 256, REPS = 20;
+    string text = BENCH_TEXT;
+    char bytes[128];
+    Dbt record = bench_record(bytes);
+
+    vector<SlottedPage *> pages;
+    bench_fill_pages(pages, record, N_PAGES);
+    vector<RecordIDs *> page_ids;
+    unsigned long rows = 0;
+    for (auto const &page: pages) {
+        page_ids.push_back(page->ids());
+        rows += page_ids.back()->size();
+    }
+    rows *= REPS;
+
+    // copy path: SlottedPage::get
+    unsigned long checksum = 0;
+    unsigned long allocations = allocations_so_far();
+    BenchTimer get_timer;
+    for (uint rep = 0; rep < REPS; rep++)
+        for (uint i = 0; i < N_PAGES; i++)
+            for (auto const &record_id: *page_ids[i]) {
+                Dbt *data = pages[i]->get(record_id);
+                checksum += *(int32_t *) data->get_data() + data->get_size();
+                delete data;
+            }
+    double get_ns = get_timer.elapsed_ns();
+    unsigned long get_allocations = allocations_so_far() - allocations;
+
+    // zero-copy path: SlottedPage::view
+    allocations = allocations_so_far();
+    BenchTimer view_timer;
+    for (uint rep = 0; rep < REPS; rep++)
+        for (uint i = 0; i < N_PAGES; i++)
+            for (auto const &record_id: *page_ids[i]) {
+                u16 size;
+                const char *data = pages[i]->view(record_id, size);
+                checksum -= *(int32_t *) data + size;
+            }
+    double view_ns = view_timer.elapsed_ns();
+    unsigned long view_allocations = allocations_so_far() - allocations;
+
+    cout << "record access (" << rows << " rows" << (checksum == 0 ? "" : ", CHECKSUM MISMATCH") << "):" << endl;
+    cout << "  get:  " << (double) get_allocations / rows << " allocations/row, " << get_ns / rows << " ns/row"
+         << endl;
+    cout << "  view: " << (double) view_allocations / rows << " allocations/row, " << view_ns / rows << " ns/row"
+         << endl;
+
+    for (auto const &ids: page_ids)
+        delete ids;
+    bench_free_pages(pages);
+
+    // full table scan through HeapTable::select (allocations beyond the returned handles)
+    ColumnNames column_names;
+    column_names.push_back("a");
+    column_names.push_back("b");
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    HeapTable table("_bench_record_access", column_names, column_attributes);
+    table.create();
+    ValueDict row;
+    row["b"] = Value(text);
+    const int N_ROWS = 20000;
+    for (int i = 0; i < N_ROWS; i++) {
+        row["a"] = Value(i);
+        table.insert(&row);
+    }
+    allocations = allocations_so_far();
+    BenchTimer scan_timer;
+    Handles *handles = table.select();
+    double scan_ns = scan_timer.elapsed_ns();
+    unsigned long scan_allocations = allocations_so_far() - allocations;
+    cout << "  table scan: " << (double) scan_allocations / handles->size() << " allocations/row, "
+         << scan_ns / handles->size() << " ns/row" << endl;
+    delete handles;
+    table.drop();
+}
+
+void bench_page_delete() {
+    const uint N_PAGES = 2048;
+    char bytes[128];
+    Dbt record = bench_record(bytes);
+    cout << "mass delete (" << N_PAGES << " full 4K pages):" << endl;
+    for (int deferred = 0; deferred <= 1; deferred++) {
+        vector<SlottedPage *> pages;
+        bench_fill_pages(pages, record, N_PAGES, deferred != 0);
+        unsigned long rows = 0;
+        BenchTimer timer;
+        for (auto const &page: pages) {
+            RecordIDs *ids = page->ids();
+            for (auto const &record_id: *ids)
+                page->del(record_id);
+            rows += ids->size();
+            delete ids;
+        }
+        double ns = timer.elapsed_ns();
+        cout << (deferred ? "  deferred compaction: " : "  eager compaction:    ") << ns / rows << " ns/delete, "
+             << rows / (ns / 1e9) << " deletes/s" << endl;
+        bench_free_pages(pages);
+    }
+}
+
+void bench_page_size() {
+    const int N_ROWS = 20000, N_LOOKUPS = 500;
+    ColumnNames column_names;
+    column_names.push_back("a");
+    column_names.push_back("b");
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    ColumnNames key_columns;
+    key_columns.push_back("a");
+
+    cout << "block size (" << N_ROWS << " rows, " << N_LOOKUPS << " index lookups):" << endl;
+    for (uint block_size = DbBlock::BLOCK_SZ; block_size <= DbBlock::MAX_BLOCK_SZ; block_size *= 2) {
+        HeapTable table("_bench_page_size", column_names, column_attributes, block_size);
+        table.create();
+        ValueDict row;
+        row["b"] = Value(BENCH_TEXT);
+        for (int i = 0; i < N_ROWS; i++) {
+            row["a"] = Value(i);
+            table.insert(&row);
+        }
+        BTreeIndex index(table, "_bench_page_size_index", key_columns, true, block_size);
+        index.create();
+
+        unsigned long checksum = 0;
+        BenchTimer scan_timer;
+        Handles *handles = table.select();
+        for (auto const &handle: *handles) {
+            ValueDict *result = table.project(handle);
+            checksum += (*result)["a"].n;
+            delete result;
+        }
+        double scan_ns = scan_timer.elapsed_ns();
+        delete handles;
+
+        ValueDict key;
+        BenchTimer lookup_timer;
+        for (int i = 0; i < N_LOOKUPS; i++) {
+            key["a"] = Value((i * 7919) % N_ROWS);
+            handles = index.lookup(&key);
+            checksum += handles->size();
+            delete handles;
+        }
+        double lookup_ns = lookup_timer.elapsed_ns();
+
+        cout << "  " << block_size / 1024 << "K: " << scan_ns / N_ROWS << " ns/row scanned, "
+             << lookup_ns / N_LOOKUPS << " ns/lookup"
+             << (checksum == (unsigned long) N_ROWS * (N_ROWS - 1) / 2 + N_LOOKUPS ? "" : ", CHECKSUM MISMATCH")
+             << endl;
+        index.drop();
+        table.drop();
+    }
+}
+
+void bench_pax_scan() {
+    const int N_ROWS = 10000, N_TEXT = 6;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    column_names.push_back("id");
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    for (int i = 0; i < N_TEXT; i++) {
+        column_names.push_back("t" + to_string(i));
+        column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    }
+    column_names.push_back("flag");
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::BOOLEAN));
+    ColumnNames one_column;
+    one_column.push_back("id");
+
+    cout << "block layout (" << N_ROWS << " rows of INT, " << N_TEXT << " x TEXT, BOOLEAN):" << endl;
+    for (int pax = 0; pax <= 1; pax++) {
+        HeapTable table("_bench_pax_scan", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                        pax ? HeapFile::PAX : HeapFile::SLOTTED_PAGE);
+        table.create();
+        ValueDict row;
+        for (int i = 0; i < N_TEXT; i++)
+            row["t" + to_string(i)] = Value(BENCH_TEXT.substr(0, 20 + 10 * i));
+        for (int i = 0; i < N_ROWS; i++) {
+            row["id"] = Value(i);
+            row["flag"] = Value(i % 2 == 0);
+            table.insert(&row);
+        }
+        Handles *handles = table.select();
+
+        unsigned long checksum = 0;
+        BenchTimer one_timer;
+        for (auto const &handle: *handles) {
+            ValueDict *result = table.project(handle, &one_column);
+            checksum += (*result)["id"].n;
+            delete result;
+        }
+        double one_ns = one_timer.elapsed_ns();
+
+        BenchTimer all_timer;
+        for (auto const &handle: *handles) {
+            ValueDict *result = table.project(handle);
+            checksum -= (*result)["id"].n;
+            delete result;
+        }
+        double all_ns = all_timer.elapsed_ns();
+
+        ValueDict where;
+        where["id"] = Value(N_ROWS / 2);
+        BenchTimer where_timer;
+        Handles *selected = table.select(&where);
+        double where_ns = where_timer.elapsed_ns();
+        checksum += selected->size() - 1;
+        delete selected;
+
+        cout << (pax ? "  PAX:          " : "  slotted page: ") << one_ns / N_ROWS << " ns/row for one column, "
+             << all_ns / N_ROWS << " ns/row for all columns, " << where_ns / N_ROWS << " ns/row for select where"
+             << (checksum == 0 ? "" : ", CHECKSUM MISMATCH") << endl;
+        delete handles;
+        table.drop();
+    }
+}
+
+void bench_page_compression() {
+    const int N_ROWS = 20000, DECODE_REPS = 20;
+    ColumnNames column_names;
+    column_names.push_back("a");
+    column_names.push_back("b");
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+
+    cout << "page compression (" << N_ROWS << " rows of INT, TEXT):" << endl;
+    for (int compressed = 0; compressed <= 1; compressed++) {
+        HeapTable table("_bench_page_compression", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                        HeapFile::SLOTTED_PAGE, compressed != 0);
+        table.create();
+        ValueDict row;
+        for (int i = 0; i < N_ROWS; i++) {
+            row["a"] = Value(i);
+            row["b"] = Value(BENCH_TEXT.substr((size_t) (i % 7), 40 + i % 40));
+            table.insert(&row);
+        }
+        BenchTimer scan_timer;
+        Handles *handles = table.select();
+        unsigned long checksum = 0;
+        for (auto const &handle: *handles) {
+            ValueDict *result = table.project(handle);
+            checksum += (*result)["a"].n;
+            delete result;
+        }
+        double scan_ns = scan_timer.elapsed_ns();
+        delete handles;
+        cout << (compressed ? "  compressed:   " : "  uncompressed: ") << scan_ns / N_ROWS << " ns/row scanned"
+             << (checksum == (unsigned long) N_ROWS * (N_ROWS - 1) / 2 ? "" : ", CHECKSUM MISMATCH") << endl;
+
+        if (!compressed) {
+            // what LZCodec does with these blocks
+            HeapFile file("_bench_page_compression");
+            file.open();
+            vector<string> encoded;
+            unsigned long raw_bytes = 0, encoded_bytes = 0;
+            char bytes[DbBlock::MAX_BLOCK_SZ];
+            DbBlockScan *blocks = file.scan_blocks();
+            for (DbBlock *block = blocks->next(); block != nullptr; block = blocks->next()) {
+                uint size = LZCodec::compress((const char *) block->get_data(), block->get_block_size(), bytes,
+                                              block->get_block_size());
+                encoded.push_back(string(bytes, size));
+                raw_bytes += block->get_block_size();
+                encoded_bytes += size;
+                delete block;
+            }
+            delete blocks;
+            BenchTimer decode_timer;
+            for (int rep = 0; rep < DECODE_REPS; rep++)
+                for (auto const &page: encoded)
+                    checksum += LZCodec::decompress(page.data(), (uint) page.size(), bytes, DbBlock::BLOCK_SZ);
+            double decode_ns = decode_timer.elapsed_ns();
+            cout << "  " << encoded.size() << " blocks, compression ratio " << (double) raw_bytes / encoded_bytes
+                 << ", " << decode_ns / (DECODE_REPS * encoded.size()) << " ns to decode a block" << endl;
+            file.close();
+        }
+        table.drop();
+    }
+}
+
+void bench_buffer_pool() {
+    const int N_ROWS = 20000, N_LOOKUPS = 200000, HOT_BLOCKS = 16;
+    ColumnNames column_names;
+    column_names.push_back("a");
+    column_names.push_back("b");
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+
+    cout << "buffer pool (" << N_ROWS << " rows, " << N_LOOKUPS << " projects of rows in " << HOT_BLOCKS
+         << " hot blocks):" << endl;
+    BufferPool *pool = _BUFFER_POOL;
+    for (int pooled = 0; pooled <= 1; pooled++) {
+        _BUFFER_POOL = pooled ? pool : nullptr;  // files pick up the pool when they are constructed
+        HeapTable table("_bench_buffer_pool", column_names, column_attributes);
+        _BUFFER_POOL = pool;
+        table.create();
+        ValueDict row;
+        for (int i = 0; i < N_ROWS; i++) {
+            row["a"] = Value(i);
+            row["b"] = Value(BENCH_TEXT.substr((size_t) (i % 7), 40 + i % 40));
+            table.insert(&row);
+        }
+        Handles *handles = table.select();
+        Handles hot;
+        for (auto const &handle: *handles)
+            if (handle.first <= (BlockID) HOT_BLOCKS)
+                hot.push_back(handle);
+        delete handles;
+
+        ulong hits = pool != nullptr ? pool->get_hits() : 0, misses = pool != nullptr ? pool->get_misses() : 0;
+        unsigned long checksum = 0;
+        BenchTimer timer;
+        for (int i = 0; i < N_LOOKUPS; i++) {
+            ValueDict *result = table.project(hot[i % hot.size()]);
+            checksum += (*result)["a"].n;
+            delete result;
+        }
+        double ns = timer.elapsed_ns();
+        cout << (pooled ? "  through the pool: " : "  straight to file: ") << ns / N_LOOKUPS << " ns/project";
+        if (pooled && pool != nullptr)
+            cout << ", " << pool->get_hits() - hits << " hits, " << pool->get_misses() - misses << " misses";
+        cout << (checksum > 0 ? "" : ", CHECKSUM MISMATCH") << endl;
+        table.drop();
+    }
+}
+
+void bench_mmap_file() {
+    const int N_ROWS = 20000, N_LOOKUPS = 20000;
+    ColumnNames column_names;
+    column_names.push_back("a");
+    column_names.push_back("b");
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+
+    cout << "storage engine (" << N_ROWS << " rows, " << N_LOOKUPS << " point lookups):" << endl;
+    for (int mmapped = 0; mmapped <= 1; mmapped++) {
+        HeapTable table("_bench_mmap_file", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                        HeapFile::SLOTTED_PAGE, false, mmapped ? HeapTable::MMAP : HeapTable::BERKELEY_DB);
+        table.create();
+        ValueDict row;
+        for (int i = 0; i < N_ROWS; i++) {
+            row["a"] = Value(i);
+            row["b"] = Value(BENCH_TEXT.substr((size_t) (i % 7), 40 + i % 40));
+            table.insert(&row);
+        }
+        BenchTimer scan_timer;
+        Handles *handles = table.select();
+        unsigned long checksum = 0;
+        for (auto const &handle: *handles) {
+            ValueDict *result = table.project(handle);
+            checksum += (*result)["a"].n;
+            delete result;
+        }
+        double scan_ns = scan_timer.elapsed_ns();
+
+        unsigned int seed = 5300;
+        BenchTimer lookup_timer;
+        for (int i = 0; i < N_LOOKUPS; i++) {
+            seed = seed * 1103515245 + 12345;
+            ValueDict *result = table.project((*handles)[(seed >> 8) % handles->size()]);
+            checksum += (*result)["a"].n;
+            delete result;
+        }
+        double lookup_ns = lookup_timer.elapsed_ns();
+        delete handles;
+        cout << (mmapped ? "  mmap:        " : "  Berkeley DB: ") << scan_ns / N_ROWS << " ns/row scanned, "
+             << lookup_ns / N_LOOKUPS << " ns/lookup" << (checksum > 0 ? "" : ", CHECKSUM MISMATCH") << endl;
+        table.drop();
+    }
+}
+
+void bench_scan() {
+    const int N_ROWS = 50000;
+    ColumnNames column_names;
+    column_names.push_back("a");
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+
+    HeapTable table("_bench_scan", column_names, column_attributes);
+    table.create();
+    ValueDict row;
+    for (int i = 0; i < N_ROWS; i++) {
+        row["a"] = Value(i);
+        table.insert(&row);
+    }
+    cout << "handles for a full scan (" << N_ROWS << " rows):" << endl;
+
+    unsigned long allocations = allocations_so_far();
+    BenchTimer select_timer;
+    Handles *handles = table.select();
+    unsigned long rows = handles->size();
+    double select_ns = select_timer.elapsed_ns();
+    unsigned long select_allocations = allocations_so_far() - allocations;
+    size_t select_bytes = handles->capacity() * sizeof(Handle);
+    delete handles;
+    cout << "  select: " << select_ns / N_ROWS << " ns/row, " << select_allocations << " allocations, "
+         << select_bytes << " bytes of handles held" << (rows == N_ROWS ? "" : ", COUNT MISMATCH") << endl;
+
+    allocations = allocations_so_far();
+    BenchTimer scan_timer;
+    DbHandleIterator *iterator = table.scan();
+    Handle handle;
+    rows = 0;
+    while (iterator->next(handle))
+        rows++;
+    delete iterator;
+    double scan_ns = scan_timer.elapsed_ns();
+    unsigned long scan_allocations = allocations_so_far() - allocations;
+    cout << "  scan:   " << scan_ns / N_ROWS << " ns/row, " << scan_allocations << " allocations, "
+         << "one block's record ids held" << (rows == N_ROWS ? "" : ", COUNT MISMATCH") << endl;
+    table.drop();
+}
+
+void bench_bulk_scan() {
+    const BlockID N_BLOCKS = 800;  // fits in the buffer pool, so the second pass is all warm
+    HeapFile file("_bench_bulk_scan");
+    file.create();
+    for (BlockID block_id = 1; block_id <= N_BLOCKS; block_id++) {
+        DbBlock *block = block_id == 1 ? file.get(1) : file.get_new();
+        Dbt data((void *) BENCH_TEXT.data(), 100);
+        while (block->unused_bytes() > 200)
+            block->add(&data);
+        file.put(block);
+        delete block;
+    }
+    file.close();
+
+    cout << "full scan of the blocks of a file (" << N_BLOCKS << " blocks):" << endl;
+    for (int bulk = 0; bulk <= 1; bulk++) {
+        HeapFile reopened("_bench_bulk_scan");  // nothing of it in the buffer pool
+        reopened.open();
+        for (int pass = 0; pass < 2; pass++) {
+            unsigned long records = 0;
+            BenchTimer timer;
+            HeapFile::BlockScan *blocks = bulk ? reopened.scan_blocks() : new HeapFile::BlockScan(reopened);
+            for (DbBlock *block = blocks->next(); block != nullptr; block = blocks->next()) {
+                records += block->size();
+                delete block;
+            }
+            delete blocks;
+            double ns = timer.elapsed_ns();
+            cout << (bulk ? "  bulk cursor,   " : "  get per block, ") << (pass ? "warm: " : "cold: ")
+                 << ns / N_BLOCKS << " ns/block" << (records > 0 ? "" : ", COUNT MISMATCH") << endl;
+        }
+        reopened.close();
+    }
+    HeapFile dropping("_bench_bulk_scan");
+    dropping.open();
+    dropping.drop();
+}
+
+void bench_write_behind() {
+    const int N_ROWS = 20000;
+    ColumnNames column_names;
+    column_names.push_back("a");
+    column_names.push_back("b");
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+
+    BufferPool *pool = _BUFFER_POOL;
+    if (pool == nullptr)
+        return;
+    cout << "inserting " << N_ROWS << " rows:" << endl;
+    for (int behind = 0; behind <= 1; behind++) {
+        HeapTable table("_bench_write_behind", column_names, column_attributes);
+        table.create();
+        table.get_file().set_write_behind(behind);
+        ValueDict row;
+        pool->checkpoint();
+        ulong writes = pool->get_writes();
+        BenchTimer timer;
+        for (int i = 0; i < N_ROWS; i++) {
+            row["a"] = Value(i);
+            row["b"] = Value(BENCH_TEXT.substr((size_t) (i % 7), 40 + i % 40));
+            table.insert(&row);
+        }
+        pool->checkpoint();
+        double ns = timer.elapsed_ns();
+        cout << (behind ? "  write-behind:  " : "  write-through: ") << ns / N_ROWS << " ns/row, "
+             << pool->get_writes() - writes << " blocks written for " << table.get_file().get_last_block_id()
+             << " blocks" << endl;
+        table.drop();
+    }
+}
+
+void bench_uring_scan() {
+    const BlockID N_BLOCKS = 4000;  // more than the buffer pool holds
+    cout << "full scan of the blocks of a plain file (" << N_BLOCKS << " blocks, none in the buffer pool):" << endl;
+    struct {
+        uint depth;
+        bool direct;
+    } modes[] = {{0, false}, {4, false}, {UringHeapFile::DEFAULT_QUEUE_DEPTH, false}, {0, true},
+                 {UringHeapFile::DEFAULT_QUEUE_DEPTH, true}};
+    for (auto const &mode: modes) {
+        uint depth = mode.depth;
+        UringHeapFile file("_bench_uring_scan", DbBlock::BLOCK_SZ, HeapFile::SLOTTED_PAGE, ColumnAttributes(), depth,
+                           mode.direct);
+        file.create();
+        Dbt data((void *) BENCH_TEXT.data(), 100);
+        for (BlockID block_id = 1; block_id <= N_BLOCKS; block_id++) {
+            DbBlock *block = block_id == 1 ? file.get(1) : file.get_new();
+            while (block->unused_bytes() > 200)
+                block->add(&data);
+            file.put(block);
+            delete block;
+        }
+        file.close();
+
+        UringHeapFile reopened("_bench_uring_scan", DbBlock::BLOCK_SZ, HeapFile::SLOTTED_PAGE, ColumnAttributes(),
+                               depth);
+        reopened.open();
+        unsigned long records = 0;
+        BenchTimer timer;
+        HeapFile::BlockScan *blocks = reopened.scan_blocks();
+        for (DbBlock *block = blocks->next(); block != nullptr; block = blocks->next()) {
+            records += block->size();
+            delete block;
+        }
+        delete blocks;
+        double ns = timer.elapsed_ns();
+        cout << "  queue depth " << depth << (reopened.is_async() ? " (io_uring" : " (pread")
+             << (reopened.is_direct_io() ? ", O_DIRECT): " : "): ") << ns / N_BLOCKS << " ns/block"
+             << (records > 0 ? "" : ", COUNT MISMATCH") << endl;
+        reopened.drop();
+    }
+}
+
+void bench_extents() {
+    const int N_BLOCKS = 5000;
+    cout << "allocating " << N_BLOCKS << " new blocks:" << endl;
+    for (int extents = 0; extents <= 1; extents++) {
+        HeapFile file("_bench_extents");
+        if (!extents)
+            file.set_extents(1, 1);
+        file.create();
+        BenchTimer timer;
+        for (int i = 0; i < N_BLOCKS; i++)
+            delete file.get_new();
+        if (_BUFFER_POOL != nullptr)
+            _BUFFER_POOL->checkpoint(&file);
+        double ns = timer.elapsed_ns();
+        cout << (extents ? "  extents of " + to_string(HeapFile::EXTENT_FIRST) + " to "
+                           + to_string(HeapFile::EXTENT_MOST) + ": " : "  a block at a time: ")
+             << ns / N_BLOCKS << " ns/block" << endl;
+        file.drop();
+    }
+}
+
+void bench_insert_batch() {
+    const int N_ROWS = 50000;
+    ColumnNames column_names;
+    column_names.push_back("a");
+    column_names.push_back("b");
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    ValueDicts rows;
+    for (int i = 0; i < N_ROWS; i++) {
+        ValueDict *row = new ValueDict();
+        (*row)["a"] = Value(i);
+        (*row)["b"] = Value(BENCH_TEXT.substr((size_t) (i % 7), 40 + i % 40));
+        rows.push_back(row);
+    }
+
+    BufferPool *pool = _BUFFER_POOL;
+    cout << "inserting " << N_ROWS << " rows (write-through):" << endl;
+    for (int batch = 0; batch <= 1; batch++) {
+        HeapTable table("_bench_insert_batch", column_names, column_attributes);
+        table.create();
+        table.get_file().set_write_behind(false);
+        ulong writes = pool == nullptr ? 0 : pool->get_writes();
+        unsigned long allocations = allocations_so_far();
+        BenchTimer timer;
+        if (batch) {
+            delete table.insert_batch(rows);
+        } else {
+            for (auto const &row: rows)
+                table.insert(row);
+        }
+        double ns = timer.elapsed_ns();
+        cout << (batch ? "  insert_batch: " : "  insert:       ") << ns / N_ROWS << " ns/row, "
+             << (double) (allocations_so_far() - allocations) / N_ROWS << " allocations/row";
+        if (pool != nullptr)
+            cout << ", " << pool->get_writes() - writes << " blocks written for "
+                 << table.get_file().get_last_block_id() << " blocks";
+        cout << endl;
+        table.drop();
+    }
+    for (auto const &row: rows)
+        delete row;
+}
+
+void bench_row_codec() {
+    const int N_ROWS = 100000;
+    ColumnNames column_names = {"id", "name", "active", "score", "note"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::BOOLEAN),
+                                          ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable table("_bench_row_codec", column_names, column_attributes);
+    const HeapTable::RowCodec &codec = table.get_codec();
+    ValueDict row;
+    vector<char> records((size_t) N_ROWS * 128);
+    vector<uint> offsets;
+    uint offset = 0;
+    BenchTimer encode_timer;
+    for (int i = 0; i < N_ROWS; i++) {
+        row["id"] = Value(i);
+        row["name"] = Value(BENCH_TEXT.substr((size_t) (i % 7), 10 + i % 20));
+        row["active"] = Value(i % 2);
+        row["score"] = Value(i * 7);
+        row["note"] = Value(BENCH_TEXT.substr((size_t) (i % 11), 20 + i % 40));
+        offsets.push_back(offset);
+        offset += codec.encode(&row, records.data() + offset);
+    }
+    double encode_ns = encode_timer.elapsed_ns();
+    cout << "row codec (" << N_ROWS << " rows of INT, TEXT, BOOLEAN, INT, TEXT):" << endl;
+    cout << "  encode:            " << N_ROWS / (encode_ns / 1e9) << " rows/s" << endl;
+
+    ColumnNames score = {"score"};
+    ColumnNames note = {"note"};
+    struct {
+        const char *label;
+        const ColumnNames *column_names;
+    } decodes[] = {{"  decode all:        ", nullptr}, {"  decode score only: ", &score},
+                   {"  decode note only:  ", &note}};
+    for (auto const &decode: decodes) {
+        long check = 0;
+        BenchTimer timer;
+        for (auto const record: offsets) {
+            ValueDict *decoded = codec.decode(records.data() + record, decode.column_names);
+            check += (long) decoded->size();
+            delete decoded;
+        }
+        double ns = timer.elapsed_ns();
+        cout << decode.label << N_ROWS / (ns / 1e9) << " rows/s" << (check == 0 ? " (nothing decoded)" : "") << endl;
+    }
+}
+
+void bench_select_where() {
+    const int N_ROWS = 100000;
+    ColumnNames column_names = {"a", "b", "c"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::BOOLEAN)};
+    HeapTable table("_bench_select_where", column_names, column_attributes);
+    table.create();
+    ValueDicts rows;
+    for (int i = 0; i < N_ROWS; i++) {
+        ValueDict *row = new ValueDict();
+        (*row)["a"] = Value(i % 100);
+        (*row)["b"] = Value(BENCH_TEXT.substr((size_t) (i % 7), 40));
+        (*row)["c"] = Value(i % 2);
+        rows.push_back(row);
+    }
+    delete table.insert_batch(rows);
+    for (auto const &row: rows)
+        delete row;
+
+    cout << "select with a where clause (" << N_ROWS << " rows):" << endl;
+    ValueDict on_int, on_text;
+    on_int["a"] = Value(42);
+    on_text["b"] = Value(BENCH_TEXT.substr(3, 40));
+    struct {
+        const char *label;
+        const ValueDict *where;
+        unsigned long expected;
+    } wheres[] = {{"  where a = 42:   ", &on_int, N_ROWS / 100}, {"  where b = text: ", &on_text, N_ROWS / 7}};
+    for (auto const &where: wheres) {
+        unsigned long allocations = allocations_so_far();
+        BenchTimer timer;
+        Handles *handles = table.select(where.where);
+        double ns = timer.elapsed_ns();
+        unsigned long n = handles->size();
+        delete handles;
+        cout << where.label << ns / N_ROWS << " ns/row, " << (double) (allocations_so_far() - allocations) / N_ROWS
+             << " allocations/row" << (n == where.expected || n == where.expected + 1 ? "" : ", COUNT MISMATCH")
+             << endl;
+    }
+    table.drop();
+}
+
+void bench_project_batch() {
+    const int N_ROWS = 100000;
+    ColumnNames column_names = {"a", "b", "c"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::BOOLEAN)};
+    HeapTable table("_bench_project_batch", column_names, column_attributes);
+    table.create();
+    ValueDicts rows;
+    for (int i = 0; i < N_ROWS; i++) {
+        ValueDict *row = new ValueDict();
+        (*row)["a"] = Value(i);
+        (*row)["b"] = Value(BENCH_TEXT.substr((size_t) (i % 7), 40));
+        (*row)["c"] = Value(i % 2);
+        rows.push_back(row);
+    }
+    Handles *handles = table.insert_batch(rows);
+    for (auto const &row: rows)
+        delete row;
+    // every 7th row, wrapping around, so that rows of the same block are far apart in the list
+    Handles scattered;
+    for (size_t i = 0; i < handles->size(); i++)
+        scattered.push_back((*handles)[(i * 7) % handles->size()]);
+    delete handles;
+
+    cout << "projecting " << N_ROWS << " rows out of block order:" << endl;
+    for (int batch = 0; batch <= 1; batch++) {
+        unsigned long pins = _BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses();
+        BenchTimer timer;
+        ValueDicts *projected;
+        if (batch) {
+            projected = table.project(&scattered);
+        } else {
+            projected = new ValueDicts();
+            for (auto const &handle: scattered)
+                projected->push_back(table.project(handle));
+        }
+        double ns = timer.elapsed_ns();
+        bool in_order = true;
+        for (size_t i = 0; i < projected->size(); i++) {
+            in_order = in_order && (*(*projected)[i])["a"].n == (int) ((i * 7) % N_ROWS);
+            delete (*projected)[i];
+        }
+        delete projected;
+        cout << (batch ? "  project(handles):   " : "  project each handle: ") << ns / N_ROWS << " ns/row, "
+             << _BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses() - pins << " blocks got"
+             << (in_order ? "" : ", OUT OF ORDER") << endl;
+    }
+    table.drop();
+}
+
+void bench_update() {
+    const int N_ROWS = 20000;
+    ColumnNames column_names = {"a", "b", "c"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::BOOLEAN)};
+    cout << "updating " << N_ROWS << " rows:" << endl;
+    for (int way = 0; way < 3; way++) {
+        HeapTable table("_bench_update", column_names, column_attributes);
+        table.create();
+        ValueDicts rows;
+        for (int i = 0; i < N_ROWS; i++) {
+            ValueDict *row = new ValueDict();
+            (*row)["a"] = Value(i);
+            (*row)["b"] = Value(BENCH_TEXT.substr((size_t) (i % 7), 40));
+            (*row)["c"] = Value(i % 2);
+            rows.push_back(row);
+        }
+        Handles *handles = table.insert_batch(rows);
+        ValueDict new_values;
+        new_values["b"] = Value(BENCH_TEXT.substr(0, way == 2 ? 200 : 40));  // longer ones have to move
+        unsigned long moved = 0;
+        BenchTimer timer;
+        for (size_t i = 0; i < handles->size(); i++) {
+            Handle handle = (*handles)[i];
+            if (way == 0) {
+                table.del(handle);
+                (*rows[i])["b"] = new_values["b"];
+                (*handles)[i] = table.insert(rows[i]);
+                moved += (*handles)[i] != handle;
+            } else {
+                table.update(handle, &new_values);
+            }
+        }
+        double ns = timer.elapsed_ns();
+        cout << (way == 0 ? "  del + insert:           " : way == 1 ? "  update (same size):    "
+                                                                    : "  update (5x the TEXT):   ")
+             << ns / N_ROWS << " ns/row";
+        if (way == 0)
+            cout << ", " << moved << " handles changed";
+        cout << endl;
+        delete handles;
+        for (auto const &row: rows)
+            delete row;
+        table.drop();
+    }
+}
+
+void bench_parallel_select() {
+    const int N_ROWS = 100000, N_RUNS = 5;
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable table("_bench_parallel_select", column_names, column_attributes);
+    table.create();
+    string prefix = BENCH_TEXT + BENCH_TEXT;  // every row's b is the same but for its last letter
+    ValueDicts rows;
+    for (int i = 0; i < N_ROWS; i++) {
+        ValueDict *row = new ValueDict();
+        (*row)["a"] = Value(i);
+        (*row)["b"] = Value(prefix + (char) ('a' + i % 26));
+        rows.push_back(row);
+    }
+    delete table.insert_batch(rows);
+    for (auto const &row: rows)
+        delete row;
+    ValueDict where;
+    where["b"] = Value(prefix + 'z');
+    delete table.select(&where);  // so all the blocks are in the buffer pool
+    uint cores = thread::hardware_concurrency();
+    cout << "select where (" << N_ROWS << " rows, " << table.get_file().get_last_block_id() << " blocks, "
+         << cores << " cores, best of " << N_RUNS << "):" << endl;
+    double serial_ns = 0;
+    for (uint degree = 1; degree <= 8; degree *= 2) {
+        table.set_parallelism(degree);
+        double ns = 0;
+        size_t n = 0;
+        for (int run = 0; run < N_RUNS; run++) {
+            BenchTimer timer;
+            Handles *handles = table.select(&where);
+            double run_ns = timer.elapsed_ns();
+            if (run == 0 || run_ns < ns)
+                ns = run_ns;
+            n = handles->size();
+            delete handles;
+        }
+        if (degree == 1)
+            serial_ns = ns;
+        cout << "  " << degree << " worker" << (degree == 1 ? ": " : "s:") << "  " << ns / N_ROWS << " ns/row, "
+             << serial_ns / ns << "x, " << n << " rows" << (degree > cores ? " (more workers than cores)" : "")
+             << endl;
+    }
+    table.drop();
+}
+
+void bench_vacuum() {
+    const int N_ROWS = 100000;
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable table("_bench_vacuum", column_names, column_attributes);
+    table.create();
+    ValueDicts rows;
+    for (int i = 0; i < N_ROWS; i++) {
+        ValueDict *row = new ValueDict();
+        (*row)["a"] = Value(i);
+        (*row)["b"] = Value(BENCH_TEXT);
+        rows.push_back(row);
+    }
+    Handles *handles = table.insert_batch(rows);
+    for (auto const &row: rows)
+        delete row;
+    for (size_t i = 0; i < handles->size(); i++)
+        if (i % 4 != 0)
+            table.del((*handles)[i]);
+    delete handles;
+    cout << "vacuum (" << N_ROWS << " rows, three quarters deleted):" << endl;
+    for (int pass = 0; pass < 2; pass++) {
+        BlockID blocks = table.get_file().get_last_block_id();
+        BenchTimer timer;
+        handles = table.select();
+        double ns = timer.elapsed_ns();
+        cout << "  scan " << (pass == 0 ? "before" : "after ") << ": " << blocks << " blocks, " << ns / 1e6 << " ms, "
+             << handles->size() << " rows" << endl;
+        delete handles;
+        if (pass == 0) {
+            map<Handle, Handle> moved;
+            BenchTimer vacuum_timer;
+            BlockID reclaimed = table.vacuum(moved);
+            ns = vacuum_timer.elapsed_ns();
+            cout << "  vacuum:      " << reclaimed << " blocks reclaimed, " << moved.size() << " rows moved, "
+                 << ns / 1e6 << " ms" << endl;
+        }
+    }
+    table.drop();
+}
+
+void bench_zone_map() {
+    const int N_ROWS = 100000, N_SELECTS = 50;
+    ColumnNames column_names = {"a", "b", "c"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::INT),
+                                          ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable table("_bench_zone_map", column_names, column_attributes);
+    table.create();
+    ValueDicts rows;
+    for (int i = 0; i < N_ROWS; i++) {
+        ValueDict *row = new ValueDict();
+        (*row)["a"] = Value(i);                                  // in the order the rows went in
+        (*row)["b"] = Value((int) ((i * 7919L) % N_ROWS));       // the same values, all over the place
+        (*row)["c"] = Value(BENCH_TEXT);
+        rows.push_back(row);
+    }
+    delete table.insert_batch(rows);
+    for (auto const &row: rows)
+        delete row;
+    BlockID blocks = table.get_file().get_last_block_id();
+    cout << "zone map (" << N_ROWS << " rows, " << blocks << " blocks, " << N_SELECTS << " selects each):" << endl;
+    for (string column_name: {"a", "b"}) {
+        ValueDict where;
+        ulong wanted = 0, found = 0;
+        BenchTimer timer;
+        for (int i = 0; i < N_SELECTS; i++) {
+            where[column_name] = Value(i * (N_ROWS / N_SELECTS));
+            vector<bool> candidates = table.get_zone_map().might_match(&where, blocks);
+            wanted += count(candidates.begin(), candidates.end(), true);
+            Handles *handles = table.select(&where);
+            found += handles->size();
+            delete handles;
+        }
+        double ns = timer.elapsed_ns();
+        cout << "  " << (column_name == "a" ? "clustered a: " : "scattered b: ") << ns / N_SELECTS / 1e3
+             << " us/select, " << (double) wanted / N_SELECTS << " blocks read/select, " << found << " rows" << endl;
+    }
+    table.drop();
+}
+
+void run_storage_benchmarks() {
+    bench_record_access();
+    bench_page_delete();
+    bench_page_size();
+    bench_pax_scan();
+    bench_page_compression();
+    bench_buffer_pool();
+    bench_mmap_file();
+    bench_scan();
+    bench_bulk_scan();
+    bench_write_behind();
+    bench_uring_scan();
+    bench_extents();
+    bench_insert_batch();
+    bench_row_codec();
+    bench_select_where();
+    bench_project_batch();
+    bench_update();
+    bench_parallel_select();
+    bench_vacuum();
+    bench_zone_map();
+}
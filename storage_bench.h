@@ -0,0 +1,136 @@
+/**
+ * @file storage_bench.h - micro-benchmarks for the storage engine
+ *
+ * @author Kevin Lundeen
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include "heap_storage.h"
+
+/**
+ * Run all the storage engine benchmarks, printing results to cout.
+ * Invoked with "bench" from the SQL prompt.
+ */
+void run_storage_benchmarks();
+
+/**
+ * Compare reading records by copy (SlottedPage::get) with reading them in place (SlottedPage::view).
+ * Reports heap allocations and time per row for each.
+ */
+void bench_record_access();
+
+/**
+ * Compare deleting every record from full pages with eager compaction (slide on every del) and with
+ * deferred compaction (tombstone only).
+ */
+void bench_page_delete();
+
+/**
+ * Compare full table scans and BTree index lookups over tables built with each supported block size
+ * (4K, 8K, 16K, 32K).
+ */
+void bench_page_size();
+
+/**
+ * Compare projecting one column, projecting all columns, and selecting on one column for a wide table
+ * stored in SlottedPage blocks and in PaxPage blocks.
+ */
+void bench_pax_scan();
+
+/**
+ * Report the compression ratio and the cost of decoding a block with LZCodec, and compare full table scans
+ * of a table of repetitive TEXT with and without compressed blocks.
+ */
+void bench_page_compression();
+
+/**
+ * Compare projecting rows from a few hot blocks over and over with blocks got through the buffer pool and
+ * with every block read from Berkeley DB.
+ */
+void bench_buffer_pool();
+
+/**
+ * Compare full table scans and random point lookups of a table kept in a Berkeley DB heap file and in an
+ * mmap heap file.
+ */
+void bench_mmap_file();
+
+/**
+ * Compare a full table scan that collects all the handles (select) with one that goes a row at a time (scan).
+ */
+void bench_scan();
+
+/**
+ * Compare reading all the blocks of a Berkeley DB heap file with a get per block and with a bulk cursor,
+ * with none of the file in the buffer pool (cold) and with all of it there (warm).
+ */
+void bench_bulk_scan();
+
+/**
+ * Compare inserting a run of rows with every put written straight to Berkeley DB and with write-behind,
+ * counting the blocks written.
+ */
+void bench_write_behind();
+
+/**
+ * Compare full scans of the blocks of a UringHeapFile done with synchronous reads and with io_uring at a
+ * couple of queue depths (so with that many blocks prefetched ahead of the scan), through the page cache and
+ * with O_DIRECT.
+ */
+void bench_uring_scan();
+
+/**
+ * Compare allocating new blocks one at a time with reserving them in extents.
+ */
+void bench_extents();
+
+/**
+ * Compare inserting rows one at a time with inserting them all in one insert_batch (time, allocations, and
+ * blocks written with write-behind off).
+ */
+void bench_insert_batch();
+
+/**
+ * Measure how many rows a second a table's row codec encodes, and decodes (whole, or just one column before or
+ * after the TEXT columns).
+ */
+void bench_row_codec();
+
+/**
+ * Time selects with a where clause on an INT column and on a TEXT column (per row scanned, and allocations).
+ */
+void bench_select_where();
+
+/**
+ * Compare projecting a list of handles (in no particular block order) one at a time with projecting them all in
+ * one project(handles) (time, and blocks got from the buffer pool).
+ */
+void bench_project_batch();
+
+/**
+ * Compare updating rows with HeapTable::update (in place, or moved behind a forwarding stub when they grow) with
+ * deleting and inserting them again (which gives them new handles).
+ */
+void bench_update();
+
+/**
+ * Time a select whose where clause has to compare a long TEXT value in every row, with the table's blocks spread
+ * over 1, 2, 4, and 8 worker threads (HeapTable::set_parallelism), and the speedup of each over just one. Each
+ * is the best of several runs, and any with more workers than the machine has cores is flagged as such, since it
+ * can't be expected to speed up.
+ */
+void bench_parallel_select();
+
+/**
+ * Time a scan of a table with three quarters of its rows deleted, then HeapTable::vacuum on it, then the scan again
+ * (blocks before and after, and the time of each).
+ */
+void bench_vacuum();
+
+/**
+ * Compare selects on a column whose values go in order with the rows (so each block's zone takes in just a few of
+ * them, and the other blocks are passed over) with selects on one whose values are all over the place (so every
+ * block has to be looked at): time per select and blocks read.
+ */
+void bench_zone_map();
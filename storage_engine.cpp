@@ -5,13 +5,23 @@
  */
 #include <algorithm>
 #include "storage_engine.h"
+#include "BufferPool.h"
+
+DbBlock::~DbBlock() {
+    if (this->pool != nullptr)
+        this->pool->unpin(this->frame);
+}
+
+void DbBlock::set_marked(RecordID record_id, bool marked) {
+    throw DbBlockError("block can't mark records");
+}
 
 bool Value::operator==(const Value &other) const {
     if (this->data_type != other.data_type)
         return false;
-    if (this->data_type == ColumnAttribute::INT)
-        return this->n == other.n;
-    return this->s == other.s;
+    if (this->data_type == ColumnAttribute::TEXT)
+        return this->s == other.s;
+    return this->n == other.n;
 }
 
 bool Value::operator!=(const Value &other) const {
@@ -72,6 +82,51 @@ ValueDict *DbRelation::project(Handle handle, const ValueDict *where) {
     return this->project(handle, &t);
 }
 
+/**
+ * @class HandlesIterator - DbHandleIterator over a list of handles it owns
+ */
+class HandlesIterator : public DbHandleIterator {
+public:
+    explicit HandlesIterator(Handles *handles) : handles(handles), pos(0) {}
+
+    virtual ~HandlesIterator() { delete handles; }
+
+    virtual bool next(Handle &handle) {
+        if (pos >= handles->size())
+            return false;
+        handle = (*handles)[pos++];
+        return true;
+    }
+
+protected:
+    Handles *handles;
+    size_t pos;
+};
+
+// Insert each of a list of rows
+Handles *DbRelation::insert_batch(const ValueDicts &rows) {
+    Handles *handles = new Handles();
+    handles->reserve(rows.size());
+    for (auto const &row: rows)
+        handles->push_back(insert(row));
+    return handles;
+}
+
+// Scan by selecting all the rows at once
+DbHandleIterator *DbRelation::scan(const ValueDict *where) {
+    return new HandlesIterator(where == nullptr ? select() : select(where));
+}
+
+// Scan by selecting from all the rows of current_selection at once
+DbHandleIterator *DbRelation::scan(DbHandleIterator *current_selection, const ValueDict *where) {
+    Handles current;
+    Handle handle;
+    while (current_selection->next(handle))
+        current.push_back(handle);
+    delete current_selection;
+    return new HandlesIterator(select(&current, where));
+}
+
 // Do a projection for each of a list of handles
 ValueDicts *DbRelation::project(Handles *handles) {
     ValueDicts *ret = new ValueDicts();
@@ -28,6 +28,16 @@ typedef u_int32_t BlockID;
 typedef std::vector<RecordID> RecordIDs;
 typedef std::length_error DbBlockNoRoomError;
 
+/**
+ * @class DbBlockError - exception class for a DbBlock asked to do something it can't
+ */
+class DbBlockError : public std::runtime_error {
+public:
+    explicit DbBlockError(std::string s) : runtime_error(s) {}
+};
+
+class BufferPool;
+
 /**
  * @class DbBlock - abstract base class for blocks in our database files 
  * (DbBlock's belong to DbFile's.)
@@ -35,6 +45,7 @@ typedef std::length_error DbBlockNoRoomError;
  * Methods for putting/getting records in blocks:
  * 	add(data)
  * 	get(record_id)
+ * 	view(record_id, size)
  * 	put(record_id, data)
  * 	del(record_id)
  * 	ids()
@@ -46,16 +57,22 @@ typedef std::length_error DbBlockNoRoomError;
 class DbBlock {
 public:
     /**
-     * our blocks are 4kB
+     * our blocks are 4kB unless the DbFile was created with a different block size
      */
     static const uint BLOCK_SZ = 4096;
 
+    /**
+     * largest block size a DbFile can be created with (offsets within a block must fit in 16 bits)
+     */
+    static const uint MAX_BLOCK_SZ = 32768;
+
     /**
      * ctor/dtor (subclasses should handle the big-5)
      */
-    DbBlock(Dbt &block, BlockID block_id, bool is_new = false) : block(block), block_id(block_id) {}
+    DbBlock(Dbt &block, BlockID block_id, bool is_new = false)
+            : block(block), block_id(block_id), pool(nullptr), frame(0) {}
 
-    virtual ~DbBlock() {}
+    virtual ~DbBlock();
 
     /**
      * Add a new record to this block.
@@ -72,12 +89,22 @@ public:
      */
     virtual Dbt *get(RecordID record_id) const = 0;
 
+    /**
+     * Look at a record in place, without copying it or allocating anything.
+     * @param record_id  which record to look at
+     * @param size       set to the number of bytes in the record
+     * @returns          pointer to the record's bytes within this block (only valid while
+     *                   the block is held and unchanged), or nullptr if it has been deleted
+     */
+    virtual const char *view(RecordID record_id, u_int16_t &size) const = 0;
+
     /**
      * Change the data stored for a record in this block.
      * @param record_id  which record to update
      * @param data       the new data to store for the given record
      * @throws           DbBlockNoRoomError if insufficient room in the block
      *                   (old record is retained)
+     * @throws           DbBlockError if the record has been deleted
      */
     virtual void put(RecordID record_id, const Dbt &data) = 0;
 
@@ -110,6 +137,23 @@ public:
      */
     virtual u_int16_t unused_bytes() const = 0;
 
+    /**
+     * Mark or unmark a record. What a mark means is up to whoever keeps the records (HeapTable marks the stub
+     * left behind by a row that has moved to another block, and the row where it moved to). A mark stays with
+     * its record through put, and goes away with del.
+     * @param record_id  which record
+     * @param marked     true to mark it, false to unmark it
+     * @throws           DbBlockError if the block can't keep marks, or the record has been deleted
+     */
+    virtual void set_marked(RecordID record_id, bool marked);
+
+    /**
+     * Check if a record is marked (see set_marked).
+     * @param record_id  which record
+     * @returns          true if it is there and marked (never, for a block that can't keep marks)
+     */
+    virtual bool is_marked(RecordID record_id) const { return false; }
+
     /**
      * Access the whole block's memory as a BerkeleyDB Dbt pointer.
      * @returns  Dbt used by this block
@@ -122,19 +166,63 @@ public:
      */
     virtual void *get_data() { return block.get_data(); }
 
+    /**
+     * Get the size of this block (which is the block size of its DbFile).
+     * @returns  number of bytes in the block
+     */
+    virtual uint get_block_size() const { return block.get_size(); }
+
     /**
      * Get this block's BlockID within its DbFile.
      * @returns this block's id
      */
     virtual BlockID get_block_id() { return block_id; }
 
+    /**
+     * Note that this block's memory is a pinned buffer pool frame, to be unpinned when the block is deleted.
+     * @param pool   the buffer pool
+     * @param frame  frame number within the pool
+     */
+    virtual void set_frame(BufferPool *pool, uint frame) {
+        this->pool = pool;
+        this->frame = frame;
+    }
+
+    /**
+     * Get the buffer pool this block's memory is in.
+     * @returns  the pool, or nullptr if the block isn't in one
+     */
+    virtual BufferPool *get_pool() const { return pool; }
+
+    /**
+     * Get the buffer pool frame this block's memory is in.
+     * @returns  frame number (only meaningful if get_pool() isn't null)
+     */
+    virtual uint get_frame() const { return frame; }
+
 protected:
     Dbt block;
     BlockID block_id;
+    BufferPool *pool;
+    uint frame;
 };
 
 // convenience type alias
-typedef std::vector<BlockID> BlockIDs;  // FIXME: will need to turn this into an iterator at some point
+typedef std::vector<BlockID> BlockIDs;  // for scans, DbBlockScan doesn't have to hold them all at once
+
+/**
+ * @class DbBlockScan - forward iterator over the blocks of a DbFile, in order (see DbFile::scan_blocks)
+ */
+class DbBlockScan {
+public:
+    virtual ~DbBlockScan() {}
+
+    /**
+     * Get the next block.
+     * @returns  the block (freed by caller), or nullptr if there are no more
+     */
+    virtual DbBlock *next() = 0;
+};
 
 /**
  * @class DbFile - abstract base class which represents a disk-based collection of DbBlocks
@@ -146,6 +234,7 @@ typedef std::vector<BlockID> BlockIDs;  // FIXME: will need to turn this into an
  *	get(block_id)
  *	put(block)
  *	block_ids()
+ *	scan_blocks()
  */
 class DbFile {
 public:
@@ -195,11 +284,17 @@ public:
 
     /**
      * Get a list of all the valid BlockID's in the file
-     * FIXME - not a good long-term approach, but we'll do this until we put in iterators
+     * (To go through the blocks, use scan_blocks, which doesn't have to make the whole list.)
      * @returns  a pointer to vector of BlockIDs (freed by caller)
      */
     virtual BlockIDs *block_ids() const = 0;
 
+    /**
+     * Start reading all the blocks of the file in order.
+     * @returns  the scan (freed by caller, and only good while the file is open)
+     */
+    virtual DbBlockScan *scan_blocks() = 0;
+
 protected:
     std::string name;  // filename (or part of it)
 };
@@ -220,7 +315,7 @@ public:
 
     virtual ~ColumnAttribute() {}
 
-    virtual DataType get_data_type() { return data_type; }
+    virtual DataType get_data_type() const { return data_type; }
 
     virtual void set_data_type(DataType data_type) { this->data_type = data_type; }
 
@@ -258,11 +353,28 @@ typedef std::string Identifier;
 typedef std::vector<Identifier> ColumnNames;
 typedef std::vector<ColumnAttribute> ColumnAttributes;
 typedef std::pair<BlockID, RecordID> Handle;
-typedef std::vector<Handle> Handles;  // FIXME: will need to turn this into an iterator at some point
+typedef std::vector<Handle> Handles;  // for scans, DbHandleIterator doesn't have to hold them all at once
 typedef std::map<Identifier, Value> ValueDict;
 typedef std::vector<ValueDict *> ValueDicts;
 
 
+/**
+ * @class DbHandleIterator - forward iterator over the rows of a DbRelation, one handle at a time
+ * (see DbRelation::scan)
+ */
+class DbHandleIterator {
+public:
+    virtual ~DbHandleIterator() {}
+
+    /**
+     * Move on to the next row.
+     * @param handle  set to the next row's handle
+     * @returns       false if there are no more rows
+     */
+    virtual bool next(Handle &handle) = 0;
+};
+
+
 /**
  * @class DbRelationError - generic exception class for DbRelation
  */
@@ -288,6 +400,7 @@ public:
  *	del(handle)
  *	select()
  *	select(where)
+ *	scan(where)
  *	project(handle)
  *	project(handle, column_names)
  */
@@ -328,6 +441,12 @@ public:
      */
     virtual void close() = 0;
 
+    /**
+     * Write out whatever the relation has been keeping in memory of its changes since the last checkpoint
+     * (SQLExec does one after every statement). Closing it does this, too.
+     */
+    virtual void checkpoint() {}
+
     /**
      * Execute: INSERT INTO <table_name> ( <row_keys> ) VALUES ( <row_values> )
      * @param row  a dictionary keyed by column names
@@ -335,6 +454,14 @@ public:
      */
     virtual Handle insert(const ValueDict *row) = 0;
 
+    /**
+     * Execute: INSERT INTO <table_name> ( <row_keys> ) VALUES ( <row_values> ), ( <row_values> ), ...
+     * By default just an insert of each row; a relation can do better by filling each block in one go.
+     * @param rows  dictionaries keyed by column names
+     * @returns     handles to the new rows, in the same order (freed by caller)
+     */
+    virtual Handles *insert_batch(const ValueDicts &rows);
+
     /**
      * Conceptually, execute: UPDATE INTO <table_name> SET <new_values> WHERE <handle>
      * where handle is sufficient to identify one specific record (e.g., returned
@@ -374,6 +501,24 @@ public:
      */
     virtual Handles *select(Handles *current_selection, const ValueDict *where) = 0;
 
+    /**
+     * Conceptually, execute: SELECT <handle> FROM <table_name> WHERE <where>, a row at a time.
+     * Unlike select, the handles are not collected, so a scan doesn't need more memory for a bigger table.
+     * (This version collects them with select; relations that can do better override it.)
+     * @param where  where-clause predicates, or nullptr for every row (must last as long as the iterator)
+     * @returns      a pointer to an iterator over the handles of qualifying rows (freed by caller)
+     */
+    virtual DbHandleIterator *scan(const ValueDict *where = nullptr);
+
+    /**
+     * Conceptually, execute: SELECT <handle> FROM <table_name> WHERE <where>, a row at a time.
+     * This version does a restricted selection based on current_selection.
+     * @param current_selection  restrict selection to be from these rows (freed along with the returned iterator)
+     * @param where              where-clause predicates (must last as long as the iterator)
+     * @returns                  a pointer to an iterator over the handles of qualifying rows (freed by caller)
+     */
+    virtual DbHandleIterator *scan(DbHandleIterator *current_selection, const ValueDict *where);
+
     /**
      * Return a sequence of all values for handle (SELECT *).
      * @param handle  row to get values from
@@ -512,6 +657,21 @@ public:
      */
     virtual void del(Handle record) = 0;
 
+    /**
+     * Point the index entry for a record that has moved (with the same values) at where it is now.
+     * @param from  handle the record had
+     * @param to    handle (into relation) the record has now
+     */
+    virtual void move(Handle from, Handle to) {
+        throw DbRelationError("index can't move records");
+    }
+
+    /**
+     * Get the columns the index is keyed on.
+     * @returns  the key's column names, in order
+     */
+    virtual const ColumnNames &get_key_columns() const { return key_columns; }
+
 protected:
     DbRelation &relation;
     Identifier name;